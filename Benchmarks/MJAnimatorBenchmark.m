@@ -0,0 +1,167 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+/**
+ * Measures what delayed animations that have not started yet cost the
+ * animator per frame. They wait in a min-heap keyed on their start time,
+ * so a frame only looks at the top of the heap and the cost should not
+ * grow with the number of delayed animations. For comparison, the same
+ * number of delays are counted down one by one every frame, which is what
+ * the animator did before, and the same number of tweens are run.
+ *
+ * Build and run from the root of the repository on OS X:
+ *
+ *   clang -fobjc-arc -O2 -framework Foundation -framework GLKit \
+ *       -IMJGL/Infrastructure \
+ *       Benchmarks/MJAnimatorBenchmark.m MJGL/Infrastructure/MJAnimator.m \
+ *       MJGL/Infrastructure/MJTweenKernels.m MJGL/Infrastructure/MJRadixSort.m \
+ *       -o animator-benchmark
+ *   ./animator-benchmark
+ */
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import <Foundation/Foundation.h>
+#import <GLKit/GLKit.h>
+#include <mach/mach_time.h>
+#import "MJAnimator.h"
+
+#define kMJBenchmarkFrameCount 1000
+#define kMJBenchmarkFrameTime (1.0 / 60.0)
+#define kMJBenchmarkLongDelay 1e6
+#define kMJBenchmarkLongDuration 1e6
+
+/** A delay counted down every frame, as animations used to be. */
+@interface MJBenchmarkScannedDelay : NSObject
+@property (nonatomic, assign) NSTimeInterval remainingDelay;
+- (void)updateWithElapsedTime:(NSTimeInterval)elapsedTime;
+@end
+
+@implementation MJBenchmarkScannedDelay
+
+- (void)updateWithElapsedTime:(NSTimeInterval)elapsedTime
+{
+    if (_remainingDelay > 0.0) {
+        _remainingDelay -= elapsedTime;
+    }
+}
+
+@end
+
+static double MJBenchmarkSecondsPerTick(void)
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    return 1e-9 * timebase.numer / timebase.denom;
+}
+
+/** Microseconds per frame of updating an animator. */
+static double MJBenchmarkUpdateAnimator(MJAnimator *animator, double secondsPerTick)
+{
+    uint64_t start = mach_absolute_time();
+    for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+        [animator updateWithElapsedTime:kMJBenchmarkFrameTime];
+    }
+    return (mach_absolute_time() - start) * secondsPerTick * 1e6 / kMJBenchmarkFrameCount;
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        double secondsPerTick = MJBenchmarkSecondsPerTick();
+        const NSUInteger counts[] = {0, 1000, 10000, 100000};
+        const NSUInteger countCount = sizeof(counts) / sizeof(counts[0]);
+        
+        printf("%d frames of %.1f ms, times in us/frame\n\n",
+               kMJBenchmarkFrameCount, kMJBenchmarkFrameTime * 1e3);
+        printf("%10s %16s %16s %16s %16s\n",
+               "Count", "Delayed blocks", "Delayed tweens", "Scanned delays", "Running tweens");
+        
+        for (NSUInteger c = 0; c < countCount; c++) {
+            NSUInteger count = counts[c];
+            float *values = calloc(MAX(count, 1), sizeof(float));
+            
+            MJAnimator *delayedBlocks = [[MJAnimator alloc] init];
+            for (NSUInteger i = 0; i < count; i++) {
+                [delayedBlocks animateWithDuration:1.0
+                                             delay:kMJBenchmarkLongDelay
+                                         animation:^(double t) {}];
+            }
+            
+            MJAnimator *delayedTweens = [[MJAnimator alloc] init];
+            for (NSUInteger i = 0; i < count; i++) {
+                [delayedTweens tweenFloat:&values[i]
+                                     from:0.0f
+                                       to:1.0f
+                                 duration:1.0
+                                    delay:kMJBenchmarkLongDelay
+                                    curve:MJTweenCurveLinear
+                               completion:nil];
+            }
+            
+            NSMutableArray *scannedDelays = [NSMutableArray arrayWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                MJBenchmarkScannedDelay *delay = [[MJBenchmarkScannedDelay alloc] init];
+                delay.remainingDelay = kMJBenchmarkLongDelay;
+                [scannedDelays addObject:delay];
+            }
+            
+            MJAnimator *runningTweens = [[MJAnimator alloc] init];
+            for (NSUInteger i = 0; i < count; i++) {
+                [runningTweens tweenFloat:&values[i]
+                                     from:0.0f
+                                       to:1.0f
+                                 duration:kMJBenchmarkLongDuration
+                                    delay:0.0
+                                    curve:MJTweenCurveLinear
+                               completion:nil];
+            }
+            
+            double delayedBlocksTime = MJBenchmarkUpdateAnimator(delayedBlocks, secondsPerTick);
+            double delayedTweensTime = MJBenchmarkUpdateAnimator(delayedTweens, secondsPerTick);
+            
+            uint64_t start = mach_absolute_time();
+            for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+                for (MJBenchmarkScannedDelay *delay in scannedDelays) {
+                    [delay updateWithElapsedTime:kMJBenchmarkFrameTime];
+                }
+            }
+            double scannedDelaysTime = (mach_absolute_time() - start) * secondsPerTick * 1e6 / kMJBenchmarkFrameCount;
+            
+            double runningTweensTime = MJBenchmarkUpdateAnimator(runningTweens, secondsPerTick);
+            
+            printf("%10lu %16.2f %16.2f %16.2f %16.2f\n", (unsigned long)count,
+                   delayedBlocksTime, delayedTweensTime, scannedDelaysTime, runningTweensTime);
+            
+            // The tweens write to the values until their animators are gone.
+            delayedTweens = nil;
+            runningTweens = nil;
+            free(values);
+        }
+    }
+    return 0;
+}
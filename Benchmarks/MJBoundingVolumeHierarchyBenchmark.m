@@ -0,0 +1,270 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+/**
+ * Compares frustum queries on a bounding volume hierarchy with culling
+ * every object, one at a time and four at a time with SIMD, for a camera
+ * that turns around in a scene of boxes. The dynamic case moves a share of
+ * the objects a little every frame before the query, with and without a
+ * margin around the leaves of the hierarchy.
+ *
+ * Build and run from the root of the repository on OS X:
+ *
+ *   clang -fobjc-arc -O2 -framework Foundation -framework GLKit \
+ *       -framework OpenGL -IMJGL -IMJGL/Camera -IMJGL/Scene \
+ *       -IMJGL/Infrastructure -IMJGL/Rendering \
+ *       Benchmarks/MJBoundingVolumeHierarchyBenchmark.m \
+ *       MJGL/Scene/MJBoundingVolumeHierarchy.m MJGL/Camera/MJFrustum.m \
+ *       -o bvh-benchmark
+ *   ./bvh-benchmark [object count] [moving percentage]
+ */
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import <Foundation/Foundation.h>
+#import <GLKit/GLKit.h>
+#include <mach/mach_time.h>
+#import "MJBoundingVolumeHierarchy.h"
+#import "MJFrustum.h"
+
+#define kMJBenchmarkDefaultObjectCount 20000
+#define kMJBenchmarkDefaultMovingPercentage 5
+#define kMJBenchmarkFrameCount 500
+#define kMJBenchmarkWorldSize 1000.0f
+#define kMJBenchmarkMaxObjectSize 4.0f
+#define kMJBenchmarkFarDistance 250.0f
+#define kMJBenchmarkMoveStep 0.25f
+#define kMJBenchmarkMargin 1.0f
+
+typedef struct MJBenchmarkScene {
+    NSUInteger count;
+    MJBoundingBox *initialBoxes;
+    float *minX, *minY, *minZ;
+    float *maxX, *maxY, *maxZ;
+    uint32_t *visibility;
+    uint32_t *results;
+} MJBenchmarkScene;
+
+static double MJBenchmarkSecondsPerTick(void)
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    return 1e-9 * timebase.numer / timebase.denom;
+}
+
+static float MJBenchmarkRandom(float range)
+{
+    return (float)arc4random_uniform(1 << 24) / (1 << 24) * range;
+}
+
+static MJBoundingBox MJBenchmarkRandomBox(void)
+{
+    GLKVector3 min = GLKVector3Make(MJBenchmarkRandom(kMJBenchmarkWorldSize),
+                                    MJBenchmarkRandom(kMJBenchmarkMaxObjectSize),
+                                    MJBenchmarkRandom(kMJBenchmarkWorldSize));
+    GLKVector3 size = GLKVector3Make(MJBenchmarkRandom(kMJBenchmarkMaxObjectSize),
+                                     MJBenchmarkRandom(kMJBenchmarkMaxObjectSize),
+                                     MJBenchmarkRandom(kMJBenchmarkMaxObjectSize));
+    return MJBoundingBoxMake(min, GLKVector3Add(min, size));
+}
+
+static void MJBenchmarkSetBox(MJBenchmarkScene *scene, NSUInteger i, MJBoundingBox box)
+{
+    scene->minX[i] = box.min.x;
+    scene->minY[i] = box.min.y;
+    scene->minZ[i] = box.min.z;
+    scene->maxX[i] = box.max.x;
+    scene->maxY[i] = box.max.y;
+    scene->maxZ[i] = box.max.z;
+}
+
+/** The frustum of a camera in the middle of the world, turned by an angle. */
+static MJFrustum MJBenchmarkFrustum(NSUInteger frame)
+{
+    float angle = 2.0f * M_PI * frame / kMJBenchmarkFrameCount;
+    GLKVector3 eye = GLKVector3Make(kMJBenchmarkWorldSize * 0.5f, 10.0f, kMJBenchmarkWorldSize * 0.5f);
+    GLKVector3 target = GLKVector3Add(eye, GLKVector3Make(cosf(angle), -0.1f, sinf(angle)));
+    GLKMatrix4 view = GLKMatrix4MakeLookAt(eye.x, eye.y, eye.z, target.x, target.y, target.z, 0.0f, 1.0f, 0.0f);
+    GLKMatrix4 projection = GLKMatrix4MakePerspective(GLKMathDegreesToRadians(60.0f), 16.0f / 9.0f, 0.1f, kMJBenchmarkFarDistance);
+    return MJFrustumMakeWithMatrix(GLKMatrix4Multiply(projection, view));
+}
+
+static NSUInteger MJBenchmarkCullScalar(MJBenchmarkScene *scene, const MJFrustum *frustum)
+{
+    NSUInteger visible = 0;
+    for (NSUInteger i = 0; i < scene->count; i++) {
+        GLKVector3 min = GLKVector3Make(scene->minX[i], scene->minY[i], scene->minZ[i]);
+        GLKVector3 max = GLKVector3Make(scene->maxX[i], scene->maxY[i], scene->maxZ[i]);
+        if (MJFrustumIntersectsBox(frustum, min, max)) {
+            scene->results[visible++] = (uint32_t)i;
+        }
+    }
+    return visible;
+}
+
+static NSUInteger MJBenchmarkCullSIMD(MJBenchmarkScene *scene, const MJFrustum *frustum)
+{
+    MJBoundingBoxes boxes = {
+        scene->minX, scene->minY, scene->minZ,
+        scene->maxX, scene->maxY, scene->maxZ
+    };
+    return MJFrustumCullBoxes(frustum, boxes, scene->count, scene->visibility);
+}
+
+/** Put the objects back where they started and build a hierarchy of them. */
+static MJBoundingVolumeHierarchy *MJBenchmarkResetScene(MJBenchmarkScene *scene, float margin)
+{
+    MJBoundingVolumeHierarchy *hierarchy = [[MJBoundingVolumeHierarchy alloc] init];
+    hierarchy.margin = margin;
+    for (NSUInteger i = 0; i < scene->count; i++) {
+        MJBenchmarkSetBox(scene, i, scene->initialBoxes[i]);
+        [hierarchy addObjectWithBounds:scene->initialBoxes[i]];
+    }
+    [hierarchy rebuild];
+    return hierarchy;
+}
+
+/**
+ * Move a share of the objects a step along the x axis, the same ones in
+ * the same way every run.
+ */
+static void MJBenchmarkMoveObjects(MJBenchmarkScene *scene,
+                                   MJBoundingVolumeHierarchy *hierarchy,
+                                   NSUInteger frame,
+                                   NSUInteger movingCount)
+{
+    for (NSUInteger n = 0; n < movingCount; n++) {
+        NSUInteger i = (n * 7919 + frame * movingCount) % scene->count;
+        MJBoundingBox box = MJBoundingBoxMake(GLKVector3Make(scene->minX[i] + kMJBenchmarkMoveStep, scene->minY[i], scene->minZ[i]),
+                                              GLKVector3Make(scene->maxX[i] + kMJBenchmarkMoveStep, scene->maxY[i], scene->maxZ[i]));
+        MJBenchmarkSetBox(scene, i, box);
+        [hierarchy setBounds:box forObject:i];
+    }
+}
+
+static void MJBenchmarkReport(const char *name, uint64_t ticks, NSUInteger visible, double secondsPerTick)
+{
+    double microseconds = ticks * secondsPerTick * 1e6 / kMJBenchmarkFrameCount;
+    printf("%-28s %10.1f us/frame %10.1f visible/frame\n",
+           name, microseconds, (double)visible / kMJBenchmarkFrameCount);
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        NSUInteger count = argc > 1 ? (NSUInteger)atol(argv[1]) : kMJBenchmarkDefaultObjectCount;
+        NSUInteger movingPercentage = argc > 2 ? (NSUInteger)atol(argv[2]) : kMJBenchmarkDefaultMovingPercentage;
+        NSUInteger movingCount = count * MIN(movingPercentage, 100) / 100;
+        double secondsPerTick = MJBenchmarkSecondsPerTick();
+        
+        MJBenchmarkScene scene;
+        scene.count = count;
+        scene.initialBoxes = malloc(count * sizeof(MJBoundingBox));
+        scene.minX = malloc(count * sizeof(float));
+        scene.minY = malloc(count * sizeof(float));
+        scene.minZ = malloc(count * sizeof(float));
+        scene.maxX = malloc(count * sizeof(float));
+        scene.maxY = malloc(count * sizeof(float));
+        scene.maxZ = malloc(count * sizeof(float));
+        scene.visibility = malloc(MJFrustumVisibilityWordCount(count) * sizeof(uint32_t));
+        scene.results = malloc(count * sizeof(uint32_t));
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            scene.initialBoxes[i] = MJBenchmarkRandomBox();
+        }
+        
+        uint64_t start = mach_absolute_time();
+        MJBoundingVolumeHierarchy *hierarchy = MJBenchmarkResetScene(&scene, 0.0f);
+        printf("%lu objects, %lu moving per frame, %d frames\n",
+               (unsigned long)count, (unsigned long)movingCount, kMJBenchmarkFrameCount);
+        printf("%-28s %10.1f ms\n\n", "Insert and build", (mach_absolute_time() - start) * secondsPerTick * 1e3);
+        
+        printf("Static scene\n");
+        NSUInteger visible = 0;
+        start = mach_absolute_time();
+        for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+            MJFrustum frustum = MJBenchmarkFrustum(frame);
+            visible += MJBenchmarkCullScalar(&scene, &frustum);
+        }
+        MJBenchmarkReport("Brute force", mach_absolute_time() - start, visible, secondsPerTick);
+        
+        visible = 0;
+        start = mach_absolute_time();
+        for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+            MJFrustum frustum = MJBenchmarkFrustum(frame);
+            visible += MJBenchmarkCullSIMD(&scene, &frustum);
+        }
+        MJBenchmarkReport("Brute force SIMD", mach_absolute_time() - start, visible, secondsPerTick);
+        
+        visible = 0;
+        start = mach_absolute_time();
+        for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+            MJFrustum frustum = MJBenchmarkFrustum(frame);
+            visible += [hierarchy queryFrustum:&frustum results:scene.results capacity:count];
+        }
+        MJBenchmarkReport("Hierarchy", mach_absolute_time() - start, visible, secondsPerTick);
+        
+        // The brute force cost does not depend on how the objects move, so
+        // the scalar version is left out of the dynamic scene.
+        printf("\nDynamic scene\n");
+        MJBenchmarkResetScene(&scene, 0.0f);
+        visible = 0;
+        start = mach_absolute_time();
+        for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+            MJBenchmarkMoveObjects(&scene, nil, frame, movingCount);
+            MJFrustum frustum = MJBenchmarkFrustum(frame);
+            visible += MJBenchmarkCullSIMD(&scene, &frustum);
+        }
+        MJBenchmarkReport("Brute force SIMD", mach_absolute_time() - start, visible, secondsPerTick);
+        
+        const float margins[] = {0.0f, kMJBenchmarkMargin};
+        for (NSUInteger m = 0; m < sizeof(margins) / sizeof(margins[0]); m++) {
+            hierarchy = MJBenchmarkResetScene(&scene, margins[m]);
+            visible = 0;
+            start = mach_absolute_time();
+            for (NSUInteger frame = 0; frame < kMJBenchmarkFrameCount; frame++) {
+                MJBenchmarkMoveObjects(&scene, hierarchy, frame, movingCount);
+                MJFrustum frustum = MJBenchmarkFrustum(frame);
+                visible += [hierarchy queryFrustum:&frustum results:scene.results capacity:count];
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "Hierarchy, margin %.2f", margins[m]);
+            MJBenchmarkReport(name, mach_absolute_time() - start, visible, secondsPerTick);
+        }
+        
+        free(scene.initialBoxes);
+        free(scene.minX);
+        free(scene.minY);
+        free(scene.minZ);
+        free(scene.maxX);
+        free(scene.maxY);
+        free(scene.maxZ);
+        free(scene.visibility);
+        free(scene.results);
+    }
+    return 0;
+}
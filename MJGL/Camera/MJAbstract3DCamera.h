@@ -24,6 +24,7 @@
 
 #import <Foundation/Foundation.h>
 #import "MJCamera.h"
+#import "MJFrustum.h"
 
 /**
  * Abstract base class for 3D cameras. DO NOT INSTANTIATE DIRECTLY!
@@ -32,6 +33,9 @@
 @protected
 	BOOL _dirtyProjection;
 	GLKMatrix4 _projectionMatrix;
+	BOOL _dirtyView;
+	BOOL _dirtyFrustum;
+	NSUInteger _generation;
 }
 
 /** Camera field of view angle in radians. */
@@ -46,6 +50,13 @@
 /** Distance to the far plane of the camera frustum from the view point. */
 @property(nonatomic, assign) float far;
 
+/**
+ * The view frustum of the camera in world space, extracted from the
+ * combined view and projection matrices. It is cached until either of
+ * them changes.
+ */
+@property(nonatomic, readonly) MJFrustum frustum;
+
 /**
  * Sets parameters that are used for calculating the projection matrix.
  *
@@ -59,4 +70,32 @@
           near:(float)near
            far:(float)far;
 
+/**
+ * Cull an array of bounding spheres against the view frustum.
+ *
+ * @param spheres The spheres in world space.
+ * @param count The number of spheres.
+ * @param visibility Set to the visibility mask of the spheres, which must
+ *                   have room for MJFrustumVisibilityWordCount(count) words.
+ *
+ * @return The number of visible spheres.
+ */
+- (NSUInteger)cullSpheres:(MJBoundingSpheres)spheres
+                    count:(NSUInteger)count
+               visibility:(uint32_t *)visibility;
+
+/**
+ * Cull an array of axis aligned bounding boxes against the view frustum.
+ *
+ * @param boxes The boxes in world space.
+ * @param count The number of boxes.
+ * @param visibility Set to the visibility mask of the boxes, which must
+ *                   have room for MJFrustumVisibilityWordCount(count) words.
+ *
+ * @return The number of visible boxes.
+ */
+- (NSUInteger)cullBoxes:(MJBoundingBoxes)boxes
+                  count:(NSUInteger)count
+             visibility:(uint32_t *)visibility;
+
 @end
@@ -24,7 +24,9 @@
 
 #import "MJAbstract3DCamera.h"
 
-@implementation MJAbstract3DCamera
+@implementation MJAbstract3DCamera {
+	MJFrustum _frustum;
+}
 
 - (id)init
 {
@@ -33,6 +35,8 @@
 	{
         _projectionMatrix = GLKMatrix4Identity;
 		_dirtyProjection = NO;
+		_dirtyView = NO;
+		_dirtyFrustum = YES;
 	}
 		
 	return self;
@@ -93,6 +97,8 @@
 {
     _projectionMatrix = GLKMatrix4MakePerspective(_fov, _aspectRatio, _near, _far);
 	_dirtyProjection = NO;
+	_dirtyFrustum = YES;
+	_generation++;
 }
 
 - (GLKMatrix4)projectionMatrix
@@ -110,4 +116,44 @@
 	return GLKMatrix4Identity;
 }
 
+- (NSUInteger)generation
+{
+	// Bring the matrices up to date, subclasses step the generation when
+	// they update the view matrix.
+	[self viewMatrix];
+	[self projectionMatrix];
+	return _generation;
+}
+
+- (MJFrustum)frustum
+{
+	// Bring the matrices up to date first, subclasses mark the frustum as
+	// dirty when they update the view matrix.
+	GLKMatrix4 viewMatrix = self.viewMatrix;
+	GLKMatrix4 projectionMatrix = self.projectionMatrix;
+	
+	if (_dirtyFrustum)
+	{
+		_frustum = MJFrustumMakeWithMatrix(GLKMatrix4Multiply(projectionMatrix, viewMatrix));
+		_dirtyFrustum = NO;
+	}
+	return _frustum;
+}
+
+- (NSUInteger)cullSpheres:(MJBoundingSpheres)spheres
+                    count:(NSUInteger)count
+               visibility:(uint32_t *)visibility
+{
+	MJFrustum frustum = self.frustum;
+	return MJFrustumCullSpheres(&frustum, spheres, count, visibility);
+}
+
+- (NSUInteger)cullBoxes:(MJBoundingBoxes)boxes
+                  count:(NSUInteger)count
+             visibility:(uint32_t *)visibility
+{
+	MJFrustum frustum = self.frustum;
+	return MJFrustumCullBoxes(&frustum, boxes, count, visibility);
+}
+
 @end
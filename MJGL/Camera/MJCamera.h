@@ -40,4 +40,13 @@
 /** The current projection matrix of the camera. */
 @property(nonatomic, readonly) GLKMatrix4 projectionMatrix;
 
+@optional
+
+/**
+ * A stamp that changes every time the view or projection matrix of the
+ * camera changes, so that state derived from the matrices only has to be
+ * recomputed when the stamp differs from the one it was derived at.
+ */
+@property(nonatomic, readonly) NSUInteger generation;
+
 @end
@@ -31,6 +31,7 @@
     BOOL _dirtyProjectionMatrix;
     GLKMatrix4 _projectionMatrix;
     BOOL _dirtyViewMatrix;
+    NSUInteger _generation;
 }
 
 @synthesize viewMatrix = _viewMatrix;
@@ -62,6 +63,7 @@
                                           _position.x, _position.y, 0.0f);
         if (_yAxisPositiveUp) _viewMatrix.m22 = -_viewMatrix.m22;
         _dirtyViewMatrix = NO;
+        _generation++;
     }
 	
     return _viewMatrix;
@@ -75,11 +77,20 @@
                                                 -_extents.height * 0.5f,
                                                 _extents.height * 0.5f,
                                                 -1.0f, 1.0f);
+        _dirtyProjectionMatrix = NO;
+        _generation++;
 	}
     
 	return _projectionMatrix;
 }
 
+- (NSUInteger)generation
+{
+    [self viewMatrix];
+    [self projectionMatrix];
+    return _generation;
+}
+
 - (void)setPosition:(GLKVector2)newPosition
 {
 	if (!GLKVector2AllEqualToVector2(_position, newPosition)) {
@@ -0,0 +1,91 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJCamera.h"
+
+/**
+ * The contents of the camera uniform block, laid out by the std140 rules,
+ * under which each mat4 is four aligned vec4 columns just like GLKMatrix4.
+ */
+typedef struct MJCameraUniforms {
+    GLKMatrix4 viewMatrix;
+    GLKMatrix4 projectionMatrix;
+    GLKMatrix4 viewProjectionMatrix;
+    GLKMatrix4 inverseViewMatrix;
+    GLKMatrix4 inverseProjectionMatrix;
+    GLKMatrix4 inverseViewProjectionMatrix;
+} MJCameraUniforms;
+
+/**
+ * GLSL declaration of the camera uniform block, to paste into shaders
+ * that use it, e.g. by appending the rest of the shader to it.
+ */
+extern NSString * const MJCameraUniformBlockSource;
+
+/**
+ * The MJCameraUniformBlock object publishes the matrices of the active
+ * camera in a uniform buffer, bound to kMJCameraUniformBlockBinding, that
+ * all shader programs share. Shader programs bind their camera block to
+ * that binding point when they are linked, so the matrices are uploaded
+ * once per frame instead of once per program.
+ *
+ * The camera generation is compared to the one the buffer was written
+ * at, so a camera that has not changed costs no upload.
+ *
+ * NOTE: OpenGL ES 2 on iOS has no uniform buffers, so there the block only
+ * computes the uniforms, which can still be set on each program.
+ */
+@interface MJCameraUniformBlock : NSObject
+
+/** The camera to publish the matrices of. */
+@property (nonatomic, strong) id<MJCamera> camera;
+
+/** The current contents of the uniform block. */
+@property (nonatomic, readonly) const MJCameraUniforms *uniforms;
+
+/** The name of the uniform buffer, or 0 on iOS. */
+@property (nonatomic, readonly) GLuint buffer;
+
+/** The number of times the uniform block has been rewritten. */
+@property (nonatomic, readonly) NSUInteger uploadCount;
+
+/**
+ * Initialize the uniform block. Expects a current OpenGL context.
+ *
+ * @param camera The camera to publish the matrices of.
+ */
+- (id)initWithCamera:(id<MJCamera>)camera;
+
+/**
+ * Rewrite the uniform block if the camera has changed since the last
+ * update, and bind the buffer to the camera block binding point. Call
+ * once per frame, before drawing.
+ *
+ * @return YES if the uniform block was rewritten.
+ */
+- (BOOL)update;
+
+@end
@@ -0,0 +1,142 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJCameraUniformBlock.h"
+#import "MJGLStateCache.h"
+#import "MJShaderProgram.h"
+
+NSString * const MJCameraUniformBlockSource =
+    @"layout(std140) uniform MJCamera {\n"
+    @"    mat4 viewMatrix;\n"
+    @"    mat4 projectionMatrix;\n"
+    @"    mat4 viewProjectionMatrix;\n"
+    @"    mat4 inverseViewMatrix;\n"
+    @"    mat4 inverseProjectionMatrix;\n"
+    @"    mat4 inverseViewProjectionMatrix;\n"
+    @"};\n";
+
+@implementation MJCameraUniformBlock {
+    MJCameraUniforms _uniforms;
+    BOOL _written;
+    NSUInteger _writtenGeneration;
+}
+
+- (id)initWithCamera:(id<MJCamera>)camera
+{
+    self = [super init];
+    if (self) {
+        _camera = camera;
+        
+        GLKMatrix4 identity = GLKMatrix4Identity;
+        _uniforms.viewMatrix = identity;
+        _uniforms.projectionMatrix = identity;
+        _uniforms.viewProjectionMatrix = identity;
+        _uniforms.inverseViewMatrix = identity;
+        _uniforms.inverseProjectionMatrix = identity;
+        _uniforms.inverseViewProjectionMatrix = identity;
+        
+#if !TARGET_OS_IPHONE
+        glGenBuffers(1, &_buffer);
+        [[MJGLStateCache currentStateCache] bindBuffer:_buffer target:GL_UNIFORM_BUFFER];
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(MJCameraUniforms), &_uniforms, GL_DYNAMIC_DRAW);
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+#if !TARGET_OS_IPHONE
+    glDeleteBuffers(1, &_buffer);
+    [[MJGLStateCache currentStateCache] didDeleteBuffer:_buffer];
+#endif
+}
+
+- (const MJCameraUniforms *)uniforms
+{
+    return &_uniforms;
+}
+
+- (void)setCamera:(id<MJCamera>)camera
+{
+    if (camera != _camera) {
+        _camera = camera;
+        _written = NO;
+    }
+}
+
+- (BOOL)update
+{
+    BOOL changed = [self updateUniforms];
+    
+#if !TARGET_OS_IPHONE
+    if (changed) {
+        [[MJGLStateCache currentStateCache] bindBuffer:_buffer target:GL_UNIFORM_BUFFER];
+        // Respecifying the whole buffer lets the driver orphan the storage
+        // that the previous frame may still be reading from.
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(MJCameraUniforms), &_uniforms, GL_DYNAMIC_DRAW);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, kMJCameraUniformBlockBinding, _buffer);
+#endif
+    
+    return changed;
+}
+
+- (BOOL)updateUniforms
+{
+    id<MJCamera> camera = self.camera;
+    if (camera == nil) {
+        return NO;
+    }
+    
+    // Cameras without generation stamps are rewritten every time.
+    BOOL stamped = [camera respondsToSelector:@selector(generation)];
+    NSUInteger generation = stamped ? camera.generation : 0;
+    if (stamped && _written && generation == _writtenGeneration) {
+        return NO;
+    }
+    
+    GLKMatrix4 viewMatrix = camera.viewMatrix;
+    GLKMatrix4 projectionMatrix = camera.projectionMatrix;
+    GLKMatrix4 viewProjectionMatrix = GLKMatrix4Multiply(projectionMatrix, viewMatrix);
+    
+    _uniforms.viewMatrix = viewMatrix;
+    _uniforms.projectionMatrix = projectionMatrix;
+    _uniforms.viewProjectionMatrix = viewProjectionMatrix;
+    _uniforms.inverseViewMatrix = GLKMatrix4Invert(viewMatrix, NULL);
+    _uniforms.inverseProjectionMatrix = GLKMatrix4Invert(projectionMatrix, NULL);
+    _uniforms.inverseViewProjectionMatrix = GLKMatrix4Invert(viewProjectionMatrix, NULL);
+    
+    _written = YES;
+    _writtenGeneration = generation;
+    _uploadCount++;
+    return YES;
+}
+
+@end
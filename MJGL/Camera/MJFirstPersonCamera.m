@@ -28,7 +28,6 @@ static const GLKVector3 referenceVector = {0.0, 0.0, 1.0f};
 static const GLKVector3 up = {0.0, 1.0f, 0.0};
 
 @implementation MJFirstPersonCamera {
-	BOOL _dirtyView;
 	GLKMatrix4 _rotationMatrix;
 	GLKMatrix4 _viewMatrix;
 }
@@ -83,6 +82,8 @@ static const GLKVector3 up = {0.0, 1.0f, 0.0};
                                        up.x, up.y, up.z);
 		
 	_dirtyView = NO;
+	_dirtyFrustum = YES;
+	_generation++;
 }
 
 - (GLKMatrix4)viewMatrix
@@ -0,0 +1,142 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import <GLKit/GLKit.h>
+
+/** Indices of the planes of a frustum. */
+typedef enum MJFrustumPlane {
+    MJFrustumPlaneLeft = 0,
+    MJFrustumPlaneRight,
+    MJFrustumPlaneBottom,
+    MJFrustumPlaneTop,
+    MJFrustumPlaneNear,
+    MJFrustumPlaneFar,
+    MJFrustumPlaneCount
+} MJFrustumPlane;
+
+/**
+ * A view frustum as six planes in world space. Each plane is stored as
+ * (a, b, c, d) with a unit normal (a, b, c) that points into the frustum,
+ * so a point p is inside the plane if a * p.x + b * p.y + c * p.z + d >= 0.
+ */
+typedef struct MJFrustum {
+    GLKVector4 planes[MJFrustumPlaneCount];
+} MJFrustum;
+
+/**
+ * Bounding spheres stored as a structure of arrays, so that the culling
+ * kernels can test four spheres with each instruction.
+ */
+typedef struct MJBoundingSpheres {
+    const float *centerX;
+    const float *centerY;
+    const float *centerZ;
+    const float *radius;
+} MJBoundingSpheres;
+
+/** Axis aligned bounding boxes stored as a structure of arrays. */
+typedef struct MJBoundingBoxes {
+    const float *minX;
+    const float *minY;
+    const float *minZ;
+    const float *maxX;
+    const float *maxY;
+    const float *maxZ;
+} MJBoundingBoxes;
+
+/**
+ * Get the number of 32-bit words in the visibility mask of a number of
+ * bounds. Bound i is visible if bit (i % 32) of word (i / 32) is set.
+ */
+#define MJFrustumVisibilityWordCount(count) (((count) + 31) / 32)
+
+/**
+ * Extract the frustum planes from a combined view projection matrix,
+ * i.e. the projection matrix multiplied by the view matrix.
+ *
+ * @param viewProjectionMatrix The view projection matrix.
+ *
+ * @return The frustum in world space.
+ */
+MJFrustum MJFrustumMakeWithMatrix(GLKMatrix4 viewProjectionMatrix);
+
+/**
+ * Check if a sphere is at least partly inside a frustum.
+ *
+ * @param frustum The frustum.
+ * @param center The center of the sphere.
+ * @param radius The radius of the sphere.
+ *
+ * @return NO if the sphere is entirely outside the frustum.
+ */
+BOOL MJFrustumIntersectsSphere(const MJFrustum *frustum, GLKVector3 center, float radius);
+
+/**
+ * Check if an axis aligned box is at least partly inside a frustum. The
+ * test is conservative, so a box close to a corner of the frustum may be
+ * reported as visible even though it is just outside.
+ *
+ * @param frustum The frustum.
+ * @param min The minimum corner of the box.
+ * @param max The maximum corner of the box.
+ *
+ * @return NO if the box is entirely outside the frustum.
+ */
+BOOL MJFrustumIntersectsBox(const MJFrustum *frustum, GLKVector3 min, GLKVector3 max);
+
+/**
+ * Cull an array of bounding spheres against a frustum, four at a time with
+ * SSE or NEON.
+ *
+ * @param frustum The frustum.
+ * @param spheres The spheres.
+ * @param count The number of spheres.
+ * @param visibility Set to the visibility mask of the spheres, which must
+ *                   have room for MJFrustumVisibilityWordCount(count) words.
+ *
+ * @return The number of visible spheres.
+ */
+size_t MJFrustumCullSpheres(const MJFrustum *frustum,
+                            MJBoundingSpheres spheres,
+                            size_t count,
+                            uint32_t *visibility);
+
+/**
+ * Cull an array of axis aligned bounding boxes against a frustum, four at
+ * a time with SSE or NEON.
+ *
+ * @param frustum The frustum.
+ * @param boxes The boxes.
+ * @param count The number of boxes.
+ * @param visibility Set to the visibility mask of the boxes, which must
+ *                   have room for MJFrustumVisibilityWordCount(count) words.
+ *
+ * @return The number of visible boxes.
+ */
+size_t MJFrustumCullBoxes(const MJFrustum *frustum,
+                          MJBoundingBoxes boxes,
+                          size_t count,
+                          uint32_t *visibility);
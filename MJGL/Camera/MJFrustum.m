@@ -0,0 +1,286 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import "MJFrustum.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MJ_FRUSTUM_SIMD 1
+typedef __m128 MJFrustumFloat4;
+typedef __m128 MJFrustumMask4;
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MJ_FRUSTUM_SIMD 1
+typedef float32x4_t MJFrustumFloat4;
+typedef uint32x4_t MJFrustumMask4;
+#endif
+
+#pragma mark - Plane extraction
+
+MJFrustum MJFrustumMakeWithMatrix(GLKMatrix4 viewProjectionMatrix)
+{
+    // Gribb and Hartmann: a clip space point is inside if -w <= x, y, z <= w,
+    // so each plane is the fourth row of the matrix plus or minus another.
+    const float *m = viewProjectionMatrix.m;
+    GLKVector4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = GLKVector4Make(m[i], m[4 + i], m[8 + i], m[12 + i]);
+    }
+    
+    MJFrustum frustum;
+    frustum.planes[MJFrustumPlaneLeft] = GLKVector4Add(rows[3], rows[0]);
+    frustum.planes[MJFrustumPlaneRight] = GLKVector4Subtract(rows[3], rows[0]);
+    frustum.planes[MJFrustumPlaneBottom] = GLKVector4Add(rows[3], rows[1]);
+    frustum.planes[MJFrustumPlaneTop] = GLKVector4Subtract(rows[3], rows[1]);
+    frustum.planes[MJFrustumPlaneNear] = GLKVector4Add(rows[3], rows[2]);
+    frustum.planes[MJFrustumPlaneFar] = GLKVector4Subtract(rows[3], rows[2]);
+    
+    // Normalize, so that the plane equations give distances and can be
+    // compared to sphere radii.
+    for (int i = 0; i < MJFrustumPlaneCount; i++) {
+        GLKVector4 plane = frustum.planes[i];
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f) {
+            frustum.planes[i] = GLKVector4DivideScalar(plane, length);
+        }
+    }
+    
+    return frustum;
+}
+
+#pragma mark - Single bounds
+
+BOOL MJFrustumIntersectsSphere(const MJFrustum *frustum, GLKVector3 center, float radius)
+{
+    for (int i = 0; i < MJFrustumPlaneCount; i++) {
+        GLKVector4 plane = frustum->planes[i];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        if (distance < -radius) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+BOOL MJFrustumIntersectsBox(const MJFrustum *frustum, GLKVector3 min, GLKVector3 max)
+{
+    // Test the corner of the box furthest along the normal of each plane,
+    // expressed with the center and half extents of the box.
+    float cx = (min.x + max.x) * 0.5f, ex = (max.x - min.x) * 0.5f;
+    float cy = (min.y + max.y) * 0.5f, ey = (max.y - min.y) * 0.5f;
+    float cz = (min.z + max.z) * 0.5f, ez = (max.z - min.z) * 0.5f;
+    
+    for (int i = 0; i < MJFrustumPlaneCount; i++) {
+        GLKVector4 plane = frustum->planes[i];
+        float distance = plane.x * cx + plane.y * cy + plane.z * cz + plane.w;
+        float extent = fabsf(plane.x) * ex + fabsf(plane.y) * ey + fabsf(plane.z) * ez;
+        if (distance + extent < 0.0f) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+#pragma mark - SIMD helpers
+
+#if MJ_FRUSTUM_SIMD
+
+/** The frustum planes with each coefficient splatted across a vector. */
+typedef struct MJFrustumPlanes4 {
+    MJFrustumFloat4 a[MJFrustumPlaneCount];
+    MJFrustumFloat4 b[MJFrustumPlaneCount];
+    MJFrustumFloat4 c[MJFrustumPlaneCount];
+    MJFrustumFloat4 d[MJFrustumPlaneCount];
+} MJFrustumPlanes4;
+
+#if defined(__SSE2__)
+#define MJFrustumSplat(x) _mm_set1_ps(x)
+#define MJFrustumLoad(p) _mm_loadu_ps(p)
+#define MJFrustumAdd(x, y) _mm_add_ps(x, y)
+#define MJFrustumSub(x, y) _mm_sub_ps(x, y)
+#define MJFrustumMul(x, y) _mm_mul_ps(x, y)
+#define MJFrustumGreaterEqual(x, y) _mm_cmpge_ps(x, y)
+#define MJFrustumAnd(x, y) _mm_and_ps(x, y)
+#define MJFrustumAllTrue() _mm_castsi128_ps(_mm_set1_epi32(-1))
+
+static inline uint32_t MJFrustumMaskBits(MJFrustumMask4 mask)
+{
+    return (uint32_t)_mm_movemask_ps(mask);
+}
+#else
+#define MJFrustumSplat(x) vdupq_n_f32(x)
+#define MJFrustumLoad(p) vld1q_f32(p)
+#define MJFrustumAdd(x, y) vaddq_f32(x, y)
+#define MJFrustumSub(x, y) vsubq_f32(x, y)
+#define MJFrustumMul(x, y) vmulq_f32(x, y)
+#define MJFrustumGreaterEqual(x, y) vcgeq_f32(x, y)
+#define MJFrustumAnd(x, y) vandq_u32(x, y)
+#define MJFrustumAllTrue() vdupq_n_u32(0xffffffff)
+
+static inline uint32_t MJFrustumMaskBits(MJFrustumMask4 mask)
+{
+    // NEON has no movemask, so weight the lanes by their bits and add them.
+    static const uint32_t weights[4] = {1, 2, 4, 8};
+    uint32x4_t bits = vandq_u32(mask, vld1q_u32(weights));
+    uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return vget_lane_u32(vpadd_u32(sum, sum), 0);
+}
+#endif
+
+static MJFrustumPlanes4 MJFrustumPlanes4Make(const MJFrustum *frustum, BOOL absoluteNormals)
+{
+    MJFrustumPlanes4 planes;
+    for (int i = 0; i < MJFrustumPlaneCount; i++) {
+        GLKVector4 plane = frustum->planes[i];
+        planes.a[i] = MJFrustumSplat(absoluteNormals ? fabsf(plane.x) : plane.x);
+        planes.b[i] = MJFrustumSplat(absoluteNormals ? fabsf(plane.y) : plane.y);
+        planes.c[i] = MJFrustumSplat(absoluteNormals ? fabsf(plane.z) : plane.z);
+        planes.d[i] = MJFrustumSplat(plane.w);
+    }
+    return planes;
+}
+
+static inline MJFrustumFloat4 MJFrustumDistance4(const MJFrustumPlanes4 *planes, int i,
+                                                 MJFrustumFloat4 x,
+                                                 MJFrustumFloat4 y,
+                                                 MJFrustumFloat4 z)
+{
+    MJFrustumFloat4 distance = MJFrustumAdd(MJFrustumMul(planes->a[i], x), planes->d[i]);
+    distance = MJFrustumAdd(distance, MJFrustumMul(planes->b[i], y));
+    return MJFrustumAdd(distance, MJFrustumMul(planes->c[i], z));
+}
+
+#endif
+
+#pragma mark - Batch culling
+
+size_t MJFrustumCullSpheres(const MJFrustum *frustum,
+                            MJBoundingSpheres spheres,
+                            size_t count,
+                            uint32_t *visibility)
+{
+#if MJ_FRUSTUM_SIMD
+    MJFrustumPlanes4 planes = MJFrustumPlanes4Make(frustum, NO);
+    MJFrustumFloat4 zero = MJFrustumSplat(0.0f);
+#endif
+    size_t visibleCount = 0;
+    
+    for (size_t base = 0; base < count; base += 32) {
+        size_t n = MIN(count - base, 32);
+        uint32_t bits = 0;
+        size_t j = 0;
+        
+#if MJ_FRUSTUM_SIMD
+        for (; j + 4 <= n; j += 4) {
+            size_t i = base + j;
+            MJFrustumFloat4 x = MJFrustumLoad(spheres.centerX + i);
+            MJFrustumFloat4 y = MJFrustumLoad(spheres.centerY + i);
+            MJFrustumFloat4 z = MJFrustumLoad(spheres.centerZ + i);
+            MJFrustumFloat4 r = MJFrustumLoad(spheres.radius + i);
+            
+            MJFrustumMask4 inside = MJFrustumAllTrue();
+            for (int p = 0; p < MJFrustumPlaneCount; p++) {
+                MJFrustumFloat4 distance = MJFrustumAdd(MJFrustumDistance4(&planes, p, x, y, z), r);
+                inside = MJFrustumAnd(inside, MJFrustumGreaterEqual(distance, zero));
+            }
+            bits |= MJFrustumMaskBits(inside) << j;
+        }
+#endif
+        for (; j < n; j++) {
+            size_t i = base + j;
+            GLKVector3 center = GLKVector3Make(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+            if (MJFrustumIntersectsSphere(frustum, center, spheres.radius[i])) {
+                bits |= 1u << j;
+            }
+        }
+        
+        visibility[base / 32] = bits;
+        visibleCount += __builtin_popcount(bits);
+    }
+    
+    return visibleCount;
+}
+
+size_t MJFrustumCullBoxes(const MJFrustum *frustum,
+                          MJBoundingBoxes boxes,
+                          size_t count,
+                          uint32_t *visibility)
+{
+#if MJ_FRUSTUM_SIMD
+    MJFrustumPlanes4 planes = MJFrustumPlanes4Make(frustum, NO);
+    MJFrustumPlanes4 absolutePlanes = MJFrustumPlanes4Make(frustum, YES);
+    MJFrustumFloat4 half = MJFrustumSplat(0.5f);
+    MJFrustumFloat4 zero = MJFrustumSplat(0.0f);
+#endif
+    size_t visibleCount = 0;
+    
+    for (size_t base = 0; base < count; base += 32) {
+        size_t n = MIN(count - base, 32);
+        uint32_t bits = 0;
+        size_t j = 0;
+        
+#if MJ_FRUSTUM_SIMD
+        for (; j + 4 <= n; j += 4) {
+            size_t i = base + j;
+            MJFrustumFloat4 minX = MJFrustumLoad(boxes.minX + i);
+            MJFrustumFloat4 minY = MJFrustumLoad(boxes.minY + i);
+            MJFrustumFloat4 minZ = MJFrustumLoad(boxes.minZ + i);
+            MJFrustumFloat4 maxX = MJFrustumLoad(boxes.maxX + i);
+            MJFrustumFloat4 maxY = MJFrustumLoad(boxes.maxY + i);
+            MJFrustumFloat4 maxZ = MJFrustumLoad(boxes.maxZ + i);
+            
+            MJFrustumFloat4 cx = MJFrustumMul(MJFrustumAdd(minX, maxX), half);
+            MJFrustumFloat4 cy = MJFrustumMul(MJFrustumAdd(minY, maxY), half);
+            MJFrustumFloat4 cz = MJFrustumMul(MJFrustumAdd(minZ, maxZ), half);
+            MJFrustumFloat4 ex = MJFrustumMul(MJFrustumSub(maxX, minX), half);
+            MJFrustumFloat4 ey = MJFrustumMul(MJFrustumSub(maxY, minY), half);
+            MJFrustumFloat4 ez = MJFrustumMul(MJFrustumSub(maxZ, minZ), half);
+            
+            MJFrustumMask4 inside = MJFrustumAllTrue();
+            for (int p = 0; p < MJFrustumPlaneCount; p++) {
+                MJFrustumFloat4 distance = MJFrustumDistance4(&planes, p, cx, cy, cz);
+                MJFrustumFloat4 extent = MJFrustumMul(absolutePlanes.a[p], ex);
+                extent = MJFrustumAdd(extent, MJFrustumMul(absolutePlanes.b[p], ey));
+                extent = MJFrustumAdd(extent, MJFrustumMul(absolutePlanes.c[p], ez));
+                inside = MJFrustumAnd(inside, MJFrustumGreaterEqual(MJFrustumAdd(distance, extent), zero));
+            }
+            bits |= MJFrustumMaskBits(inside) << j;
+        }
+#endif
+        for (; j < n; j++) {
+            size_t i = base + j;
+            GLKVector3 min = GLKVector3Make(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+            GLKVector3 max = GLKVector3Make(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+            if (MJFrustumIntersectsBox(frustum, min, max)) {
+                bits |= 1u << j;
+            }
+        }
+        
+        visibility[base / 32] = bits;
+        visibleCount += __builtin_popcount(bits);
+    }
+    
+    return visibleCount;
+}
@@ -26,7 +26,6 @@
 
 @implementation MJThirdPersonCamera {
 	GLKMatrix4 _viewMatrix;
-	BOOL _dirtyView;
 }
 
 @synthesize target = _target;
@@ -54,6 +53,8 @@
                                            _target.x, _target.y, _target.z,
                                            _up.x, _up.y, _up.z);
         _dirtyView = NO;
+        _dirtyFrustum = YES;
+        _generation++;
 	}
 	return _viewMatrix;
 }
@@ -23,7 +23,14 @@
 //
 
 #import <Foundation/Foundation.h>
-
+#import <GLKit/GLKit.h>
+
+/**
+ * Identifies an animation. Ids of finished animations are never mistaken
+ * for other animations, and 0 is never a valid id. An animator hands out
+ * about four billion ids over its lifetime, after which it fails to add
+ * animations.
+ */
 typedef uint32_t MJAnimationId;
 
 double (^MJAnimationCurveLinear)(double t);
@@ -31,6 +38,17 @@ double (^MJAnimationCurveEaseIn)(double t);
 double (^MJAnimationCurveEaseOut)(double t);
 double (^MJAnimationCurveEaseInOut)(double t);
 
+/**
+ * The easing curves of typed tweens, which match the MJAnimationCurve
+ * blocks of the same names.
+ */
+typedef enum MJTweenCurve {
+    MJTweenCurveLinear,
+    MJTweenCurveEaseIn,
+    MJTweenCurveEaseOut,
+    MJTweenCurveEaseInOut
+} MJTweenCurve;
+
 
 @protocol MJAnimator <NSObject>
 
@@ -86,6 +104,69 @@ double (^MJAnimationCurveEaseInOut)(double t);
 
 - (MJAnimationId)animateIndefinitelyWithAnimation:(BOOL (^)(double elapsedTime))animation;
 
+/**
+ * Tweens a value from a start value to an end value without calling any
+ * blocks per frame. Typed tweens are stored as structures of arrays and
+ * their curves are evaluated with SIMD, which makes them much cheaper
+ * than block based animations when there are many of them.
+ *
+ * The value is owned by the caller and must stay at the same address until
+ * the tween has finished or been invalidated. It is not written to while
+ * the tween is delayed.
+ *
+ * @param value The value to animate.
+ * @param from The start value.
+ * @param to The end value.
+ * @param duration Duration of the tween in seconds.
+ * @param delay Delay before the tween starts in seconds.
+ * @param curve The easing curve.
+ * @param completion Block called when the tween has finished. May be nil.
+ * @return Id of the tween, shared with the block based animations.
+ */
+- (MJAnimationId)tweenFloat:(float *)value
+                       from:(float)from
+                         to:(float)to
+                   duration:(NSTimeInterval)duration
+                      delay:(NSTimeInterval)delay
+                      curve:(MJTweenCurve)curve
+                 completion:(void (^)())completion;
+
+- (MJAnimationId)tweenVector2:(GLKVector2 *)value
+                         from:(GLKVector2)from
+                           to:(GLKVector2)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion;
+
+- (MJAnimationId)tweenVector3:(GLKVector3 *)value
+                         from:(GLKVector3)from
+                           to:(GLKVector3)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion;
+
+- (MJAnimationId)tweenVector4:(GLKVector4 *)value
+                         from:(GLKVector4)from
+                           to:(GLKVector4)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion;
+
+/**
+ * Tweens a rotation along the shortest arc, using normalized linear
+ * interpolation of the quaternions.
+ */
+- (MJAnimationId)tweenQuaternion:(GLKQuaternion *)value
+                            from:(GLKQuaternion)from
+                              to:(GLKQuaternion)to
+                        duration:(NSTimeInterval)duration
+                           delay:(NSTimeInterval)delay
+                           curve:(MJTweenCurve)curve
+                      completion:(void (^)())completion;
+
 - (void)invalidateAnimationWithId:(MJAnimationId)animationId;
 
 - (void)updateWithElapsedTime:(NSTimeInterval)elapsedTime;
@@ -95,4 +176,26 @@ double (^MJAnimationCurveEaseInOut)(double t);
 
 @interface MJAnimator : NSObject <MJAnimator>
 
+/**
+ * Update the animations on all cores when there are enough of them to
+ * make it worthwhile. Off by default.
+ *
+ * When enabled, animation blocks may be called concurrently and must not
+ * call the animator. Blocks that share state that is not thread safe
+ * should be put in the same isolation group. Completion blocks are always
+ * called on the thread calling updateWithElapsedTime:, in the same order
+ * as in a serial update.
+ */
+@property (nonatomic, assign, getter = isParallelUpdateEnabled) BOOL parallelUpdateEnabled;
+
+/**
+ * Put a block based animation in an isolation group. The animations in a
+ * group are updated serially, in order, by a parallel update. Typed tweens
+ * only write to their own values and never need a group.
+ *
+ * @param group The isolation group, or 0 for no group.
+ * @param animationId The animation.
+ */
+- (void)setIsolationGroup:(uint32_t)group forAnimationWithId:(MJAnimationId)animationId;
+
 @end
@@ -23,8 +23,34 @@
 //
 
 #import "MJAnimator.h"
-
-static MJAnimationId currentAnimationId = 0;
+#import "MJTweenKernels.h"
+#import "MJRadixSort.h"
+
+// An animation id holds the index of the animation's slot in the low bits
+// and the generation of the slot in the high bits. The generation is
+// bumped every time the slot is freed, so stale ids never match, and it
+// is never zero, so neither is an id. Freed slots are reused first in,
+// first out, so that each slot goes through its generations as slowly as
+// possible, and a slot whose generation would wrap is retired instead of
+// reused, so that no id is ever given out twice.
+#define kMJAnimationSlotIndexBits 20
+#define kMJAnimationSlotIndexMask ((1u << kMJAnimationSlotIndexBits) - 1)
+#define kMJAnimationSlotGenerationMask 0xfffu
+#define kMJAnimationSlotMaxCount (1u << kMJAnimationSlotIndexBits)
+#define kMJAnimationSlotNone UINT32_MAX
+
+// What kind of animation a slot refers to, i.e. which dense arrays.
+#define kMJAnimationKindNone 0
+#define kMJAnimationKindInstance 1
+#define kMJAnimationKindTween 2
+
+#define kMJTweenFlagQuaternion 0x01
+#define kMJTweenFlagRemoved 0x02
+
+// Parallel updates split the animations into chunks of these sizes, and
+// are only used when there are at least two chunks of work.
+#define kMJAnimatorInstanceChunkSize 256
+#define kMJAnimatorTweenChunkSize 4096
 
 double (^MJAnimationCurveLinear)(double t) = ^(double t) {
     return t;
@@ -169,13 +195,205 @@ double (^MJAnimationCurveEaseInOut)(double t) = ^(double t) {
 @end
 
 
-@interface MJAnimator ()
+/** A slot of the animator's slot map. */
+typedef struct MJAnimationSlot
+{
+    /** Index of the animation in the dense arrays, or the next free slot. */
+    uint32_t index;
+    
+    /** Index in the heap of delayed animations, or kMJAnimationSlotNone. */
+    uint32_t heapIndex;
+    
+    uint16_t generation;
+    uint8_t kind;
+} MJAnimationSlot;
 
-@property (nonatomic, strong) NSMutableDictionary *animations;
+/** A run of animations updated serially by one worker of a parallel update. */
+typedef struct MJAnimatorTask
+{
+    const uint32_t *indices;
+    NSUInteger count;
+} MJAnimatorTask;
 
-@end
+/** An entry in the min-heap of delayed animations. */
+typedef struct MJDelayedAnimation
+{
+    /** The animator clock time at which the animation starts. */
+    NSTimeInterval startTime;
+    uint32_t slotIndex;
+} MJDelayedAnimation;
+
+/**
+ * The typed tweens of the animator, as a structure of arrays so that
+ * their curves can be evaluated by the SIMD kernel in MJTweenAdvance.
+ */
+typedef struct MJTweenArrays
+{
+    float *phases;
+    float *rates;
+    float *linear;
+    float *quadratic;
+    float *sine;
+    float *progress;
+    
+    /** Start and end values, four floats per tween. */
+    float *from;
+    float *to;
+    
+    /** The caller owned values being animated. */
+    float **targets;
+    uint8_t *componentCounts;
+    uint8_t *flags;
+    MJAnimationId *ids;
+    
+    NSUInteger count;
+    NSUInteger capacity;
+} MJTweenArrays;
+
+static void MJTweenArraysReserve(MJTweenArrays *tweens, NSUInteger capacity)
+{
+    if (capacity <= tweens->capacity) {
+        return;
+    }
+    capacity = MAX(capacity, tweens->capacity * 2);
+    tweens->phases = realloc(tweens->phases, capacity * sizeof(float));
+    tweens->rates = realloc(tweens->rates, capacity * sizeof(float));
+    tweens->linear = realloc(tweens->linear, capacity * sizeof(float));
+    tweens->quadratic = realloc(tweens->quadratic, capacity * sizeof(float));
+    tweens->sine = realloc(tweens->sine, capacity * sizeof(float));
+    tweens->progress = realloc(tweens->progress, capacity * sizeof(float));
+    tweens->from = realloc(tweens->from, capacity * 4 * sizeof(float));
+    tweens->to = realloc(tweens->to, capacity * 4 * sizeof(float));
+    tweens->targets = realloc(tweens->targets, capacity * sizeof(float *));
+    tweens->componentCounts = realloc(tweens->componentCounts, capacity * sizeof(uint8_t));
+    tweens->flags = realloc(tweens->flags, capacity * sizeof(uint8_t));
+    tweens->ids = realloc(tweens->ids, capacity * sizeof(MJAnimationId));
+    tweens->capacity = capacity;
+}
+
+static void MJTweenArraysMove(MJTweenArrays *tweens, NSUInteger to, NSUInteger from)
+{
+    tweens->phases[to] = tweens->phases[from];
+    tweens->rates[to] = tweens->rates[from];
+    tweens->linear[to] = tweens->linear[from];
+    tweens->quadratic[to] = tweens->quadratic[from];
+    tweens->sine[to] = tweens->sine[from];
+    memcpy(&tweens->from[to * 4], &tweens->from[from * 4], 4 * sizeof(float));
+    memcpy(&tweens->to[to * 4], &tweens->to[from * 4], 4 * sizeof(float));
+    tweens->targets[to] = tweens->targets[from];
+    tweens->componentCounts[to] = tweens->componentCounts[from];
+    tweens->flags[to] = tweens->flags[from];
+    tweens->ids[to] = tweens->ids[from];
+}
+
+static void MJTweenArraysSwap(MJTweenArrays *tweens, NSUInteger a, NSUInteger b)
+{
+    // The element past the last tween is always reserved as scratch space.
+    NSUInteger scratch = tweens->count;
+    MJTweenArraysMove(tweens, scratch, a);
+    MJTweenArraysMove(tweens, a, b);
+    MJTweenArraysMove(tweens, b, scratch);
+}
 
-@implementation MJAnimator
+static void MJTweenArraysFree(MJTweenArrays *tweens)
+{
+    free(tweens->phases);
+    free(tweens->rates);
+    free(tweens->linear);
+    free(tweens->quadratic);
+    free(tweens->sine);
+    free(tweens->progress);
+    free(tweens->from);
+    free(tweens->to);
+    free(tweens->targets);
+    free(tweens->componentCounts);
+    free(tweens->flags);
+    free(tweens->ids);
+}
+
+/** Writes the value of a tween for a curve value to its target. */
+static inline void MJTweenApply(const MJTweenArrays *tweens, NSUInteger i, float progress)
+{
+    const float *from = &tweens->from[i * 4];
+    const float *to = &tweens->to[i * 4];
+    float *target = tweens->targets[i];
+    float inverse = 1.0f - progress;
+    
+    if (tweens->flags[i] & kMJTweenFlagQuaternion) {
+        // Normalized lerp, the end was flipped to the same hemisphere as the
+        // start when the tween was created.
+        float q[4];
+        float lengthSquared = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            q[k] = from[k] * inverse + to[k] * progress;
+            lengthSquared += q[k] * q[k];
+        }
+        float scale = (lengthSquared > 0.0f) ? 1.0f / sqrtf(lengthSquared) : 0.0f;
+        for (int k = 0; k < 4; k++) {
+            target[k] = q[k] * scale;
+        }
+        return;
+    }
+    
+    for (int k = 0; k < tweens->componentCounts[i]; k++) {
+        target[k] = from[k] * inverse + to[k] * progress;
+    }
+}
+
+/** Advances a range of started tweens and writes their values to their targets. */
+static void MJTweenUpdateRange(MJTweenArrays *tweens, NSUInteger start, NSUInteger end, float elapsedTime)
+{
+    MJTweenAdvance(tweens->phases + start, tweens->rates + start, tweens->linear + start,
+                   tweens->quadratic + start, tweens->sine + start, elapsedTime,
+                   tweens->progress + start, end - start);
+    for (NSUInteger i = start; i < end; i++) {
+        if (!(tweens->flags[i] & kMJTweenFlagRemoved)) {
+            MJTweenApply(tweens, i, tweens->progress[i]);
+        }
+    }
+}
+
+@implementation MJAnimator {
+    // The animations, stored densely so that updates walk contiguous arrays.
+    // Animations that have started come first, followed by those waiting
+    // for their delay to pass, which are not visited by updates.
+    NSMutableArray *_instances;
+    MJAnimationId *_instanceIds;
+    uint32_t *_instanceGroups;
+    NSUInteger _instanceCapacity;
+    NSUInteger _activeInstanceCount;
+    
+    MJTweenArrays _tweens;
+    NSMutableArray *_tweenCompletions;
+    NSUInteger _activeTweenCount;
+    
+    // Min-heap of delayed animations, ordered by start time.
+    MJDelayedAnimation *_delayed;
+    NSUInteger _delayedCount;
+    NSUInteger _delayedCapacity;
+    NSTimeInterval _clock;
+    
+    // Maps the index part of an animation id to the dense arrays.
+    MJAnimationSlot *_slots;
+    uint32_t _slotCount;
+    uint32_t _slotCapacity;
+    uint32_t _freeSlot;
+    uint32_t _lastFreeSlot;
+    
+    // Reused from frame to frame to avoid allocating during updates.
+    NSUInteger *_removals;
+    NSUInteger _removalCapacity;
+    NSMutableArray *_completions;
+    
+    // Scratch memory of parallel updates, also reused between frames.
+    uint32_t *_ungrouped;
+    uint64_t *_groupKeys;
+    uint32_t *_groupIndices;
+    uint64_t *_scratchKeys;
+    uint32_t *_scratchIndices;
+    MJAnimatorTask *_tasks;
+    NSUInteger _scratchCapacity;
+}
 
 + (instancetype)sharedInstance
 {
@@ -191,21 +409,431 @@ double (^MJAnimationCurveEaseInOut)(double t) = ^(double t) {
 {
     self = [super init];
     if (self) {
-        _animations = [NSMutableDictionary dictionary];
+        _instances = [NSMutableArray array];
+        _tweenCompletions = [NSMutableArray array];
+        _completions = [NSMutableArray array];
+        _freeSlot = kMJAnimationSlotNone;
+        _lastFreeSlot = kMJAnimationSlotNone;
     }
     return self;
 }
 
+- (void)dealloc
+{
+    free(_instanceIds);
+    free(_instanceGroups);
+    MJTweenArraysFree(&_tweens);
+    free(_slots);
+    free(_delayed);
+    free(_removals);
+    free(_ungrouped);
+    free(_groupKeys);
+    free(_groupIndices);
+    free(_scratchKeys);
+    free(_scratchIndices);
+    free(_tasks);
+}
+
 - (BOOL)isIdle
 {
-    return _animations.count == 0;
+    return _instances.count == 0 && _tweens.count == 0;
 }
 
 - (NSUInteger)currentAnimationCount
 {
-    return _animations.count;
+    return _instances.count + _tweens.count;
+}
+
+#pragma mark - Slot map
+
+/** Returns the id of a new slot pointing at an index in the dense arrays of a kind. */
+- (MJAnimationId)allocateSlotForKind:(uint8_t)kind index:(NSUInteger)denseIndex
+{
+    uint32_t slotIndex = _freeSlot;
+    if (slotIndex != kMJAnimationSlotNone) {
+        _freeSlot = _slots[slotIndex].index;
+        if (_freeSlot == kMJAnimationSlotNone) {
+            _lastFreeSlot = kMJAnimationSlotNone;
+        }
+    } else {
+        if (_slotCount == kMJAnimationSlotMaxCount) {
+            NSLog(@"ERROR: Too many animations.");
+            return 0;
+        }
+        if (_slotCount == _slotCapacity) {
+            _slotCapacity = MAX(_slotCapacity * 2, 64);
+            _slots = realloc(_slots, _slotCapacity * sizeof(MJAnimationSlot));
+        }
+        slotIndex = _slotCount++;
+        _slots[slotIndex].generation = 1;
+    }
+    
+    MJAnimationSlot *slot = &_slots[slotIndex];
+    slot->index = (uint32_t)denseIndex;
+    slot->heapIndex = kMJAnimationSlotNone;
+    slot->kind = kind;
+    return ((MJAnimationId)slot->generation << kMJAnimationSlotIndexBits) | slotIndex;
+}
+
+/**
+ * Frees the slot of an animation and bumps its generation. The slot is
+ * put at the back of the free list, or retired if it has used up its
+ * generations.
+ */
+- (void)freeSlotOfAnimationWithId:(MJAnimationId)animationId
+{
+    uint32_t slotIndex = animationId & kMJAnimationSlotIndexMask;
+    MJAnimationSlot *slot = &_slots[slotIndex];
+    slot->kind = kMJAnimationKindNone;
+    if (slot->generation == kMJAnimationSlotGenerationMask) {
+        return;
+    }
+    slot->generation++;
+    slot->index = kMJAnimationSlotNone;
+    if (_lastFreeSlot == kMJAnimationSlotNone) {
+        _freeSlot = slotIndex;
+    } else {
+        _slots[_lastFreeSlot].index = slotIndex;
+    }
+    _lastFreeSlot = slotIndex;
+}
+
+/**
+ * Returns the dense index of an animation, or NSNotFound if the id is stale.
+ * The kind of the animation is returned through the kind parameter.
+ */
+- (NSUInteger)indexOfAnimationWithId:(MJAnimationId)animationId kind:(uint8_t *)kind
+{
+    uint32_t slotIndex = animationId & kMJAnimationSlotIndexMask;
+    uint32_t generation = animationId >> kMJAnimationSlotIndexBits;
+    if (slotIndex >= _slotCount) {
+        return NSNotFound;
+    }
+    MJAnimationSlot *slot = &_slots[slotIndex];
+    if (slot->kind == kMJAnimationKindNone || slot->generation != generation) {
+        return NSNotFound;
+    }
+    *kind = slot->kind;
+    return slot->index;
+}
+
+- (MJAnimationId)addAnimationInstance:(id<MJAnimationInstance>)animationInstance
+                                delay:(NSTimeInterval)delay
+{
+    NSUInteger denseIndex = _instances.count;
+    MJAnimationId animationId = [self allocateSlotForKind:kMJAnimationKindInstance index:denseIndex];
+    if (animationId == 0) {
+        return 0;
+    }
+    
+    if (denseIndex == _instanceCapacity) {
+        _instanceCapacity = MAX(_instanceCapacity * 2, 64);
+        _instanceIds = realloc(_instanceIds, _instanceCapacity * sizeof(MJAnimationId));
+        _instanceGroups = realloc(_instanceGroups, _instanceCapacity * sizeof(uint32_t));
+    }
+    [_instances addObject:animationInstance];
+    _instanceIds[denseIndex] = animationId;
+    _instanceGroups[denseIndex] = 0;
+    
+    if (delay > 0.0) {
+        [self scheduleAnimationWithId:animationId startTime:_clock + delay];
+    } else {
+        [self swapInstanceAtIndex:denseIndex withIndex:_activeInstanceCount];
+        _activeInstanceCount++;
+    }
+    return animationId;
+}
+
+- (void)swapInstanceAtIndex:(NSUInteger)a withIndex:(NSUInteger)b
+{
+    if (a == b) {
+        return;
+    }
+    MJAnimationId idA = _instanceIds[a];
+    MJAnimationId idB = _instanceIds[b];
+    uint32_t groupA = _instanceGroups[a];
+    [_instances exchangeObjectAtIndex:a withObjectAtIndex:b];
+    _instanceIds[a] = idB;
+    _instanceIds[b] = idA;
+    _instanceGroups[a] = _instanceGroups[b];
+    _instanceGroups[b] = groupA;
+    _slots[idA & kMJAnimationSlotIndexMask].index = (uint32_t)b;
+    _slots[idB & kMJAnimationSlotIndexMask].index = (uint32_t)a;
+}
+
+/**
+ * Removes a started animation by moving the last started animation into
+ * its place, and the last delayed animation into the place of that one.
+ */
+- (void)removeAnimationAtIndex:(NSUInteger)denseIndex
+{
+    MJAnimationId animationId = _instanceIds[denseIndex];
+    [self swapInstanceAtIndex:denseIndex withIndex:_activeInstanceCount - 1];
+    [self swapInstanceAtIndex:_activeInstanceCount - 1 withIndex:_instances.count - 1];
+    [_instances removeLastObject];
+    _activeInstanceCount--;
+    [self freeSlotOfAnimationWithId:animationId];
+}
+
+- (void)swapTweenAtIndex:(NSUInteger)a withIndex:(NSUInteger)b
+{
+    if (a == b) {
+        return;
+    }
+    MJTweenArraysSwap(&_tweens, a, b);
+    [_tweenCompletions exchangeObjectAtIndex:a withObjectAtIndex:b];
+    _slots[_tweens.ids[a] & kMJAnimationSlotIndexMask].index = (uint32_t)a;
+    _slots[_tweens.ids[b] & kMJAnimationSlotIndexMask].index = (uint32_t)b;
+}
+
+/** Removes a started tween, like removeAnimationAtIndex:. */
+- (void)removeTweenAtIndex:(NSUInteger)denseIndex
+{
+    MJAnimationId animationId = _tweens.ids[denseIndex];
+    [self swapTweenAtIndex:denseIndex withIndex:_activeTweenCount - 1];
+    [self swapTweenAtIndex:_activeTweenCount - 1 withIndex:_tweens.count - 1];
+    [_tweenCompletions removeLastObject];
+    _tweens.count--;
+    _activeTweenCount--;
+    [self freeSlotOfAnimationWithId:animationId];
+}
+
+#pragma mark - Delayed animations
+
+- (void)setDelayedAnimation:(MJDelayedAnimation)entry atIndex:(NSUInteger)heapIndex
+{
+    _delayed[heapIndex] = entry;
+    _slots[entry.slotIndex].heapIndex = (uint32_t)heapIndex;
+}
+
+- (void)siftDelayedAnimationUpFromIndex:(NSUInteger)heapIndex
+{
+    MJDelayedAnimation entry = _delayed[heapIndex];
+    while (heapIndex > 0) {
+        NSUInteger parent = (heapIndex - 1) / 2;
+        if (_delayed[parent].startTime <= entry.startTime) {
+            break;
+        }
+        [self setDelayedAnimation:_delayed[parent] atIndex:heapIndex];
+        heapIndex = parent;
+    }
+    [self setDelayedAnimation:entry atIndex:heapIndex];
+}
+
+- (void)siftDelayedAnimationDownFromIndex:(NSUInteger)heapIndex
+{
+    MJDelayedAnimation entry = _delayed[heapIndex];
+    for (;;) {
+        NSUInteger child = heapIndex * 2 + 1;
+        if (child >= _delayedCount) {
+            break;
+        }
+        if (child + 1 < _delayedCount && _delayed[child + 1].startTime < _delayed[child].startTime) {
+            child++;
+        }
+        if (entry.startTime <= _delayed[child].startTime) {
+            break;
+        }
+        [self setDelayedAnimation:_delayed[child] atIndex:heapIndex];
+        heapIndex = child;
+    }
+    [self setDelayedAnimation:entry atIndex:heapIndex];
+}
+
+- (void)scheduleAnimationWithId:(MJAnimationId)animationId startTime:(NSTimeInterval)startTime
+{
+    if (_delayedCount == _delayedCapacity) {
+        _delayedCapacity = MAX(_delayedCapacity * 2, 64);
+        _delayed = realloc(_delayed, _delayedCapacity * sizeof(MJDelayedAnimation));
+    }
+    MJDelayedAnimation entry = { startTime, animationId & kMJAnimationSlotIndexMask };
+    [self setDelayedAnimation:entry atIndex:_delayedCount++];
+    [self siftDelayedAnimationUpFromIndex:_delayedCount - 1];
 }
 
+/** Removes an animation from the heap, wherever it is in it. */
+- (void)unscheduleDelayedAnimationAtIndex:(NSUInteger)heapIndex
+{
+    _slots[_delayed[heapIndex].slotIndex].heapIndex = kMJAnimationSlotNone;
+    _delayedCount--;
+    if (heapIndex == _delayedCount) {
+        return;
+    }
+    [self setDelayedAnimation:_delayed[_delayedCount] atIndex:heapIndex];
+    if (heapIndex > 0 && _delayed[heapIndex].startTime < _delayed[(heapIndex - 1) / 2].startTime) {
+        [self siftDelayedAnimationUpFromIndex:heapIndex];
+    } else {
+        [self siftDelayedAnimationDownFromIndex:heapIndex];
+    }
+}
+
+/**
+ * Moves a delayed animation into the started animations. The time it has
+ * been running at the end of the coming update is given by runningTime.
+ */
+- (void)startDelayedAnimationInSlot:(uint32_t)slotIndex
+                        runningTime:(NSTimeInterval)runningTime
+                        elapsedTime:(NSTimeInterval)elapsedTime
+{
+    MJAnimationSlot *slot = &_slots[slotIndex];
+    NSUInteger index = slot->index;
+    
+    // The coming update advances the animation by elapsedTime, so set it
+    // back by the part of the frame that passed before it started.
+    if (slot->kind == kMJAnimationKindTween) {
+        _tweens.phases[index] = (float)(runningTime - elapsedTime) * _tweens.rates[index];
+        [self swapTweenAtIndex:index withIndex:_activeTweenCount];
+        _activeTweenCount++;
+    } else {
+        id<MJAnimationInstance> animation = _instances[index];
+        animation.animationTime = runningTime - elapsedTime;
+        [self swapInstanceAtIndex:index withIndex:_activeInstanceCount];
+        _activeInstanceCount++;
+    }
+}
+
+- (void)startDueAnimationsWithElapsedTime:(NSTimeInterval)elapsedTime
+{
+    while (_delayedCount > 0 && _delayed[0].startTime <= _clock) {
+        MJDelayedAnimation entry = _delayed[0];
+        [self unscheduleDelayedAnimationAtIndex:0];
+        [self startDelayedAnimationInSlot:entry.slotIndex
+                              runningTime:MIN(_clock - entry.startTime, elapsedTime)
+                              elapsedTime:elapsedTime];
+    }
+}
+
+#pragma mark - Typed tweens
+
+- (MJAnimationId)tweenComponents:(float *)value
+                           count:(uint8_t)componentCount
+                      quaternion:(BOOL)quaternion
+                            from:(const float *)from
+                              to:(const float *)to
+                        duration:(NSTimeInterval)duration
+                           delay:(NSTimeInterval)delay
+                           curve:(MJTweenCurve)curve
+                      completion:(void (^)())completion
+{
+    NSUInteger i = _tweens.count;
+    MJAnimationId animationId = [self allocateSlotForKind:kMJAnimationKindTween index:i];
+    if (animationId == 0) {
+        return 0;
+    }
+    MJTweenArraysReserve(&_tweens, MAX(i + 2, 64));
+    _tweens.count++;
+    
+    // A zero duration finishes on the next update.
+    _tweens.rates[i] = (float)(1.0 / MAX(duration, 1e-6));
+    _tweens.phases[i] = 0.0f;
+    
+    static const float coefficients[4][3] = {
+        [MJTweenCurveLinear] = { 1.0f, 0.0f, 0.0f },
+        [MJTweenCurveEaseIn] = { 0.0f, 1.0f, 0.0f },
+        [MJTweenCurveEaseOut] = { 2.0f, -1.0f, 0.0f },
+        [MJTweenCurveEaseInOut] = { 0.0f, 0.0f, 1.0f },
+    };
+    _tweens.linear[i] = coefficients[curve][0];
+    _tweens.quadratic[i] = coefficients[curve][1];
+    _tweens.sine[i] = coefficients[curve][2];
+    
+    float *tweenFrom = &_tweens.from[i * 4];
+    float *tweenTo = &_tweens.to[i * 4];
+    memset(tweenFrom, 0, 4 * sizeof(float));
+    memset(tweenTo, 0, 4 * sizeof(float));
+    memcpy(tweenFrom, from, componentCount * sizeof(float));
+    memcpy(tweenTo, to, componentCount * sizeof(float));
+    
+    if (quaternion) {
+        // Take the shortest way around.
+        float dot = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            dot += tweenFrom[k] * tweenTo[k];
+        }
+        if (dot < 0.0f) {
+            for (int k = 0; k < 4; k++) {
+                tweenTo[k] = -tweenTo[k];
+            }
+        }
+    }
+    
+    _tweens.targets[i] = value;
+    _tweens.componentCounts[i] = componentCount;
+    _tweens.flags[i] = quaternion ? kMJTweenFlagQuaternion : 0;
+    _tweens.ids[i] = animationId;
+    [_tweenCompletions addObject:completion ? [completion copy] : [NSNull null]];
+    
+    if (delay > 0.0) {
+        [self scheduleAnimationWithId:animationId startTime:_clock + delay];
+    } else {
+        [self swapTweenAtIndex:i withIndex:_activeTweenCount];
+        _activeTweenCount++;
+    }
+    return animationId;
+}
+
+- (MJAnimationId)tweenFloat:(float *)value
+                       from:(float)from
+                         to:(float)to
+                   duration:(NSTimeInterval)duration
+                      delay:(NSTimeInterval)delay
+                      curve:(MJTweenCurve)curve
+                 completion:(void (^)())completion
+{
+    return [self tweenComponents:value count:1 quaternion:NO from:&from to:&to
+                        duration:duration delay:delay curve:curve completion:completion];
+}
+
+- (MJAnimationId)tweenVector2:(GLKVector2 *)value
+                         from:(GLKVector2)from
+                           to:(GLKVector2)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion
+{
+    return [self tweenComponents:value->v count:2 quaternion:NO from:from.v to:to.v
+                        duration:duration delay:delay curve:curve completion:completion];
+}
+
+- (MJAnimationId)tweenVector3:(GLKVector3 *)value
+                         from:(GLKVector3)from
+                           to:(GLKVector3)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion
+{
+    return [self tweenComponents:value->v count:3 quaternion:NO from:from.v to:to.v
+                        duration:duration delay:delay curve:curve completion:completion];
+}
+
+- (MJAnimationId)tweenVector4:(GLKVector4 *)value
+                         from:(GLKVector4)from
+                           to:(GLKVector4)to
+                     duration:(NSTimeInterval)duration
+                        delay:(NSTimeInterval)delay
+                        curve:(MJTweenCurve)curve
+                   completion:(void (^)())completion
+{
+    return [self tweenComponents:value->v count:4 quaternion:NO from:from.v to:to.v
+                        duration:duration delay:delay curve:curve completion:completion];
+}
+
+- (MJAnimationId)tweenQuaternion:(GLKQuaternion *)value
+                            from:(GLKQuaternion)from
+                              to:(GLKQuaternion)to
+                        duration:(NSTimeInterval)duration
+                           delay:(NSTimeInterval)delay
+                           curve:(MJTweenCurve)curve
+                      completion:(void (^)())completion
+{
+    return [self tweenComponents:value->q count:4 quaternion:YES from:from.q to:to.q
+                        duration:duration delay:delay curve:curve completion:completion];
+}
+
+#pragma mark - Block animations
+
 - (MJAnimationId)animateWithDuration:(NSTimeInterval)duration
                                delay:(NSTimeInterval)delay
                               repeat:(BOOL)repeat
@@ -213,19 +841,16 @@ double (^MJAnimationCurveEaseInOut)(double t) = ^(double t) {
                            animation:(void (^)(double t))animation
                           completion:(void (^)())completion
 {
-    MJAnimationId animationId = ++currentAnimationId;
-    
+    // The delay is handled by the animator, so that delayed animations
+    // are not visited until they start.
     MJAnimationInstance *animationInstance = [[MJAnimationInstance alloc] initWithDuration:duration
-                                                                                     delay:delay
+                                                                                     delay:0.0
                                                                                     repeat:repeat
                                                                                      curve:curve
                                                                                  animation:animation
                                                                                 completion:completion];
-
-    
-    self.animations[@(animationId)] = animationInstance;
     
-    return animationId;
+    return [self addAnimationInstance:animationInstance delay:delay];
 }
 
 - (MJAnimationId)animateWithDuration:(NSTimeInterval)duration
@@ -373,48 +998,209 @@ double (^MJAnimationCurveEaseInOut)(double t) = ^(double t) {
 
 - (MJAnimationId)animateIndefinitelyWithAnimation:(BOOL (^)(double elapsedTime))animation
 {
-    MJAnimationId animationId = ++currentAnimationId;
-    
     MJIndefiniteAnimationInstance *animationInstance = [[MJIndefiniteAnimationInstance alloc] initWithAnimation:animation];
     
-    self.animations[@(animationId)] = animationInstance;
-    
-    return animationId;
+    return [self addAnimationInstance:animationInstance delay:0.0];
 }
 
 
 - (void)invalidateAnimationWithId:(MJAnimationId)animationId
 {
-    MJAnimationInstance *animationInstance = [self.animations objectForKey:@(animationId)];
-    if (animationInstance) {
+    uint8_t kind = kMJAnimationKindNone;
+    NSUInteger index = [self indexOfAnimationWithId:animationId kind:&kind];
+    if (index == NSNotFound) {
+        return;
+    }
+    
+    // Start a delayed animation right away, so that it is removed and its
+    // completion called by the next update like any other animation.
+    uint32_t heapIndex = _slots[animationId & kMJAnimationSlotIndexMask].heapIndex;
+    if (heapIndex != kMJAnimationSlotNone) {
+        [self unscheduleDelayedAnimationAtIndex:heapIndex];
+        [self startDelayedAnimationInSlot:animationId & kMJAnimationSlotIndexMask
+                              runningTime:0.0
+                              elapsedTime:0.0];
+        index = _slots[animationId & kMJAnimationSlotIndexMask].index;
+    }
+    
+    if (kind == kMJAnimationKindTween) {
+        _tweens.flags[index] |= kMJTweenFlagRemoved;
+    } else {
+        id<MJAnimationInstance> animationInstance = _instances[index];
         animationInstance.markedForRemoval = YES;
     }
 }
 
+- (void)setIsolationGroup:(uint32_t)group forAnimationWithId:(MJAnimationId)animationId
+{
+    uint8_t kind = kMJAnimationKindNone;
+    NSUInteger index = [self indexOfAnimationWithId:animationId kind:&kind];
+    if (index != NSNotFound && kind == kMJAnimationKindInstance) {
+        _instanceGroups[index] = group;
+    }
+}
+
+- (void)reserveRemovals:(NSUInteger)count
+{
+    if (count > _removalCapacity) {
+        _removalCapacity = MAX(count, _removalCapacity * 2);
+        _removals = realloc(_removals, _removalCapacity * sizeof(NSUInteger));
+    }
+}
+
+- (void)reserveScratch:(NSUInteger)count
+{
+    if (count > _scratchCapacity) {
+        _scratchCapacity = MAX(count, _scratchCapacity * 2);
+        _ungrouped = realloc(_ungrouped, _scratchCapacity * sizeof(uint32_t));
+        _groupKeys = realloc(_groupKeys, _scratchCapacity * sizeof(uint64_t));
+        _groupIndices = realloc(_groupIndices, _scratchCapacity * sizeof(uint32_t));
+        _scratchKeys = realloc(_scratchKeys, _scratchCapacity * sizeof(uint64_t));
+        _scratchIndices = realloc(_scratchIndices, _scratchCapacity * sizeof(uint32_t));
+        _tasks = realloc(_tasks, _scratchCapacity * sizeof(MJAnimatorTask));
+    }
+}
+
 - (void)updateWithElapsedTime:(NSTimeInterval)elapsedTime
 {
-    NSMutableDictionary *removals = [NSMutableDictionary dictionary];
+    _clock += elapsedTime;
+    [self startDueAnimationsWithElapsedTime:elapsedTime];
     
-    for (id animationId in self.animations) {
-        id<MJAnimationInstance> animation = self.animations[animationId];
-        if (animation.markedForRemoval) {
-            [removals setObject:animation forKey:animationId];
-            continue;
+    [self updateInstancesWithElapsedTime:elapsedTime];
+    [self updateTweensWithElapsedTime:elapsedTime];
+    
+    NSUInteger completionCount = _completions.count;
+    for (NSUInteger i = 0; i < completionCount; i++) {
+        void (^completion)() = _completions[i];
+        completion();
+    }
+    [_completions removeObjectsInRange:NSMakeRange(0, completionCount)];
+}
+
+- (void)updateInstancesWithElapsedTime:(NSTimeInterval)elapsedTime
+{
+    // Animations added by animation blocks are first updated next frame.
+    NSUInteger count = _activeInstanceCount;
+    
+    if (_parallelUpdateEnabled && count >= 2 * kMJAnimatorInstanceChunkSize) {
+        [self updateInstancesInParallelWithElapsedTime:elapsedTime count:count];
+    } else {
+        for (NSUInteger i = 0; i < count; i++) {
+            id<MJAnimationInstance> animation = _instances[i];
+            if (!animation.markedForRemoval) {
+                [animation updateWithElapsedTime:elapsedTime];
+            }
         }
-        
-        [animation updateWithElapsedTime:elapsedTime];
-        
+    }
+    
+    // Collect the removals in index order, so that completion blocks are
+    // called in the same order whether the update ran in parallel or not.
+    NSUInteger removalCount = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        id<MJAnimationInstance> animation = _instances[i];
         if (animation.markedForRemoval) {
-            [removals setObject:animation forKey:animationId];
+            [self reserveRemovals:removalCount + 1];
+            _removals[removalCount++] = i;
         }
     }
     
-    [self.animations removeObjectsForKeys:removals.allKeys];
-    for (id animationId in removals) {
-        id<MJAnimationInstance> animation = removals[animationId];
+    for (NSUInteger i = 0; i < removalCount; i++) {
+        id<MJAnimationInstance> animation = _instances[_removals[i]];
         if (animation.completion) {
-            animation.completion();
+            [_completions addObject:animation.completion];
+        }
+    }
+    
+    // Removing from the back keeps the indices of the remaining removals
+    // valid, since only animations that stay are moved.
+    for (NSUInteger i = removalCount; i > 0; i--) {
+        [self removeAnimationAtIndex:_removals[i - 1]];
+    }
+}
+
+/**
+ * Updates the started animations on all cores. Animations without an
+ * isolation group are split into fixed size chunks, and each isolation
+ * group is updated serially by a single worker, in index order.
+ */
+- (void)updateInstancesInParallelWithElapsedTime:(NSTimeInterval)elapsedTime
+                                           count:(NSUInteger)count
+{
+    [self reserveScratch:count];
+    
+    NSUInteger ungroupedCount = 0;
+    NSUInteger groupedCount = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        uint32_t group = _instanceGroups[i];
+        if (group == 0) {
+            _ungrouped[ungroupedCount++] = (uint32_t)i;
+        } else {
+            _groupKeys[groupedCount] = ((uint64_t)group << 32) | i;
+            _groupIndices[groupedCount++] = (uint32_t)i;
+        }
+    }
+    MJRadixSort64(_groupKeys, _groupIndices, _scratchKeys, _scratchIndices, groupedCount);
+    
+    NSUInteger taskCount = 0;
+    for (NSUInteger i = 0; i < ungroupedCount; i += kMJAnimatorInstanceChunkSize) {
+        _tasks[taskCount++] = (MJAnimatorTask){ &_ungrouped[i], MIN(kMJAnimatorInstanceChunkSize, ungroupedCount - i) };
+    }
+    for (NSUInteger i = 0; i < groupedCount; ) {
+        NSUInteger end = i + 1;
+        while (end < groupedCount && (_groupKeys[end] >> 32) == (_groupKeys[i] >> 32)) {
+            end++;
+        }
+        _tasks[taskCount++] = (MJAnimatorTask){ &_groupIndices[i], end - i };
+        i = end;
+    }
+    
+    // GCD balances the tasks over a pool of worker threads, one per core.
+    NSArray *instances = _instances;
+    const MJAnimatorTask *tasks = _tasks;
+    dispatch_apply(taskCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t t) {
+        MJAnimatorTask task = tasks[t];
+        for (NSUInteger i = 0; i < task.count; i++) {
+            id<MJAnimationInstance> animation = instances[task.indices[i]];
+            if (!animation.markedForRemoval) {
+                [animation updateWithElapsedTime:elapsedTime];
+            }
         }
+    });
+}
+
+- (void)updateTweensWithElapsedTime:(NSTimeInterval)elapsedTime
+{
+    NSUInteger count = _activeTweenCount;
+    NSUInteger removalCount = 0;
+    
+    if (_parallelUpdateEnabled && count >= 2 * kMJAnimatorTweenChunkSize) {
+        // Tweens only write to their own targets, so any split will do.
+        MJTweenArrays *tweens = &_tweens;
+        size_t chunkCount = (count + kMJAnimatorTweenChunkSize - 1) / kMJAnimatorTweenChunkSize;
+        dispatch_apply(chunkCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t chunk) {
+            NSUInteger start = chunk * kMJAnimatorTweenChunkSize;
+            MJTweenUpdateRange(tweens, start, MIN(start + kMJAnimatorTweenChunkSize, count), (float)elapsedTime);
+        });
+    } else {
+        MJTweenUpdateRange(&_tweens, 0, count, (float)elapsedTime);
+    }
+    
+    [self reserveRemovals:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        if ((_tweens.flags[i] & kMJTweenFlagRemoved) || _tweens.phases[i] >= 1.0f) {
+            _removals[removalCount++] = i;
+        }
+    }
+    
+    for (NSUInteger i = 0; i < removalCount; i++) {
+        id completion = _tweenCompletions[_removals[i]];
+        if (completion != [NSNull null]) {
+            [_completions addObject:completion];
+        }
+    }
+    
+    for (NSUInteger i = removalCount; i > 0; i--) {
+        [self removeTweenAtIndex:_removals[i - 1]];
     }
 }
 
@@ -0,0 +1,85 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+
+extern NSString * const MJCompressedTextureErrorDomain;
+
+/**
+ * A texture loaded from a KTX or KTX2 container holding block compressed
+ * data, such as ETC2, ASTC or S3TC (BC1-BC3).
+ *
+ * The container is memory mapped and each mip level is passed directly to
+ * glCompressedTexImage2D, so the texture data is never copied or decoded
+ * on the CPU and stays compressed in GPU memory.
+ *
+ * Like GLKTextureInfo, the object does not delete the texture when it
+ * is deallocated.
+ */
+@interface MJCompressedTexture : NSObject
+
+/** The OpenGL name of the texture. */
+@property (nonatomic, assign, readonly) GLuint name;
+
+/** GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP. */
+@property (nonatomic, assign, readonly) GLenum target;
+
+/** The compressed internal format of the texture. */
+@property (nonatomic, assign, readonly) GLenum internalFormat;
+
+/** Width of the base level in pixels. */
+@property (nonatomic, assign, readonly) GLuint width;
+
+/** Height of the base level in pixels. */
+@property (nonatomic, assign, readonly) GLuint height;
+
+/** Number of mip levels uploaded. */
+@property (nonatomic, assign, readonly) GLuint mipLevelCount;
+
+/** Size of the compressed texture data in bytes, all levels and faces included. */
+@property (nonatomic, assign, readonly) NSUInteger byteSize;
+
+/**
+ * Loads a compressed texture from a KTX (.ktx) or KTX2 (.ktx2) file. The
+ * texture is left bound to texture unit 0.
+ *
+ * @param url URL of the file.
+ * @param error Error object if the texture could not be loaded.
+ * @return The texture, or nil if the file could not be loaded or its format
+ *         is not supported by the current context.
+ */
++ (MJCompressedTexture *)textureWithContentsOfURL:(NSURL *)url
+                                            error:(NSError **)error;
+
+/**
+ * Checks whether the current context can sample a compressed format.
+ *
+ * @param internalFormat A compressed internal format, e.g.
+ *                       GL_COMPRESSED_RGBA8_ETC2_EAC.
+ */
++ (BOOL)supportsInternalFormat:(GLenum)internalFormat;
+
+@end
@@ -0,0 +1,358 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJCompressedTexture.h"
+#import "MJGLStateCache.h"
+
+NSString * const MJCompressedTextureErrorDomain = @"MJCompressedTextureErrorDomain";
+
+#define kMJCompressedTextureMaxLevels 16
+#define kMJCompressedTextureMaxFaces 6
+
+#define kMJKTXHeaderSize 64
+#define kMJKTX2HeaderSize 80
+#define kMJKTX2LevelIndexEntrySize 24
+#define kMJKTXEndianness 0x04030201
+
+static const uint8_t kMJKTXIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+static const uint8_t kMJKTX2Identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+/** The mip levels and faces of a compressed texture within a container. */
+typedef struct MJCompressedImageLayout
+{
+    GLenum internalFormat;
+    GLuint width;
+    GLuint height;
+    GLuint faceCount;
+    GLuint levelCount;
+    GLsizei levelSize[kMJCompressedTextureMaxLevels];
+    const uint8_t *levelData[kMJCompressedTextureMaxLevels][kMJCompressedTextureMaxFaces];
+} MJCompressedImageLayout;
+
+static uint32_t MJReadUInt32(const uint8_t *bytes, size_t offset)
+{
+    uint32_t value;
+    memcpy(&value, bytes + offset, sizeof(value));
+    return value;
+}
+
+static uint64_t MJReadUInt64(const uint8_t *bytes, size_t offset)
+{
+    uint64_t value;
+    memcpy(&value, bytes + offset, sizeof(value));
+    return value;
+}
+
+/**
+ * Maps the Vulkan formats used by KTX2 to OpenGL compressed formats.
+ * Returns 0 for formats that are not block compressed formats we support.
+ */
+static GLenum MJInternalFormatFromVkFormat(uint32_t vkFormat)
+{
+    switch (vkFormat) {
+        case 131: return 0x83F0; // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        case 132: return 0x8C4C; // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+        case 133: return 0x83F1; // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+        case 134: return 0x8C4D; // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+        case 135: return 0x83F2; // VK_FORMAT_BC2_UNORM_BLOCK
+        case 136: return 0x8C4E; // VK_FORMAT_BC2_SRGB_BLOCK
+        case 137: return 0x83F3; // VK_FORMAT_BC3_UNORM_BLOCK
+        case 138: return 0x8C4F; // VK_FORMAT_BC3_SRGB_BLOCK
+        case 147: return 0x9274; // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+        case 148: return 0x9275; // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK
+        case 149: return 0x9276; // VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK
+        case 150: return 0x9277; // VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK
+        case 151: return 0x9278; // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK
+        case 152: return 0x9279; // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+        default:
+            break;
+    }
+    
+    // VK_FORMAT_ASTC_4x4_UNORM_BLOCK through VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+    // alternate between UNORM and SRGB in the same block size order as the
+    // GL_COMPRESSED_RGBA_ASTC_*_KHR and GL_COMPRESSED_SRGB8_ALPHA8_ASTC_*_KHR
+    // ranges.
+    if (vkFormat >= 157 && vkFormat <= 184) {
+        uint32_t blockSize = (vkFormat - 157) / 2;
+        return ((vkFormat - 157) % 2 == 0) ? 0x93B0 + blockSize : 0x93D0 + blockSize;
+    }
+    return 0;
+}
+
+/**
+ * Finds the mip levels of a KTX file. Returns NULL on success, or
+ * a description of the problem.
+ */
+static const char *MJParseKTX(const uint8_t *bytes, size_t length, MJCompressedImageLayout *layout)
+{
+    if (length < kMJKTXHeaderSize) {
+        return "The file is truncated.";
+    }
+    if (MJReadUInt32(bytes, 12) != kMJKTXEndianness) {
+        return "Files with foreign endianness are not supported.";
+    }
+    
+    uint32_t glType = MJReadUInt32(bytes, 16);
+    uint32_t glFormat = MJReadUInt32(bytes, 24);
+    uint32_t pixelDepth = MJReadUInt32(bytes, 44);
+    uint32_t arrayElementCount = MJReadUInt32(bytes, 48);
+    uint32_t keyValueDataSize = MJReadUInt32(bytes, 60);
+    
+    if (glType != 0 || glFormat != 0) {
+        return "The texture is not compressed.";
+    }
+    if (pixelDepth > 1 || arrayElementCount > 0) {
+        return "Only 2D and cube map textures are supported.";
+    }
+    
+    layout->internalFormat = MJReadUInt32(bytes, 28);
+    layout->width = MJReadUInt32(bytes, 36);
+    layout->height = MAX(MJReadUInt32(bytes, 40), 1);
+    layout->faceCount = MJReadUInt32(bytes, 52);
+    layout->levelCount = MAX(MJReadUInt32(bytes, 56), 1);
+    
+    if (layout->faceCount != 1 && layout->faceCount != 6) {
+        return "Unexpected number of faces.";
+    }
+    if (layout->levelCount > kMJCompressedTextureMaxLevels) {
+        return "Too many mip levels.";
+    }
+    
+    size_t offset = (size_t)kMJKTXHeaderSize + keyValueDataSize;
+    for (GLuint level = 0; level < layout->levelCount; level++) {
+        if (offset > length || length - offset < 4) {
+            return "The file is truncated.";
+        }
+        uint32_t imageSize = MJReadUInt32(bytes, offset);
+        offset += 4;
+        
+        // For cube maps the size is given per face, and each face is
+        // padded to four bytes.
+        size_t paddedSize = ((size_t)imageSize + 3) & ~(size_t)3;
+        for (GLuint face = 0; face < layout->faceCount; face++) {
+            if (offset > length || length - offset < imageSize) {
+                return "The file is truncated.";
+            }
+            layout->levelData[level][face] = bytes + offset;
+            offset += paddedSize;
+        }
+        layout->levelSize[level] = (GLsizei)imageSize;
+    }
+    return NULL;
+}
+
+/**
+ * Finds the mip levels of a KTX2 file. Returns NULL on success, or
+ * a description of the problem.
+ */
+static const char *MJParseKTX2(const uint8_t *bytes, size_t length, MJCompressedImageLayout *layout)
+{
+    if (length < kMJKTX2HeaderSize) {
+        return "The file is truncated.";
+    }
+    
+    uint32_t vkFormat = MJReadUInt32(bytes, 12);
+    uint32_t pixelDepth = MJReadUInt32(bytes, 28);
+    uint32_t layerCount = MJReadUInt32(bytes, 32);
+    uint32_t supercompressionScheme = MJReadUInt32(bytes, 44);
+    
+    if (supercompressionScheme != 0) {
+        return "Supercompressed files are not supported.";
+    }
+    if (pixelDepth > 1 || layerCount > 0) {
+        return "Only 2D and cube map textures are supported.";
+    }
+    
+    layout->internalFormat = MJInternalFormatFromVkFormat(vkFormat);
+    layout->width = MJReadUInt32(bytes, 20);
+    layout->height = MAX(MJReadUInt32(bytes, 24), 1);
+    layout->faceCount = MJReadUInt32(bytes, 36);
+    layout->levelCount = MAX(MJReadUInt32(bytes, 40), 1);
+    
+    if (layout->internalFormat == 0) {
+        return "The texture format is not a supported compressed format.";
+    }
+    if (layout->faceCount != 1 && layout->faceCount != 6) {
+        return "Unexpected number of faces.";
+    }
+    if (layout->levelCount > kMJCompressedTextureMaxLevels) {
+        return "Too many mip levels.";
+    }
+    if (length - kMJKTX2HeaderSize < (size_t)layout->levelCount * kMJKTX2LevelIndexEntrySize) {
+        return "The file is truncated.";
+    }
+    
+    // The level index lists the base level first, and the faces of each
+    // level are stored back to back.
+    for (GLuint level = 0; level < layout->levelCount; level++) {
+        size_t entry = kMJKTX2HeaderSize + (size_t)level * kMJKTX2LevelIndexEntrySize;
+        uint64_t levelOffset = MJReadUInt64(bytes, entry);
+        uint64_t levelLength = MJReadUInt64(bytes, entry + 8);
+        if (levelOffset > length || length - levelOffset < levelLength) {
+            return "The file is truncated.";
+        }
+        uint64_t faceSize = levelLength / layout->faceCount;
+        for (GLuint face = 0; face < layout->faceCount; face++) {
+            layout->levelData[level][face] = bytes + levelOffset + face * faceSize;
+        }
+        layout->levelSize[level] = (GLsizei)faceSize;
+    }
+    return NULL;
+}
+
+@implementation MJCompressedTexture
+
+#pragma mark - Loading textures
+
++ (MJCompressedTexture *)textureWithContentsOfURL:(NSURL *)url
+                                            error:(NSError *__autoreleasing *)error
+{
+    // Mapping the file lets glCompressedTexImage2D read the texture data
+    // straight from the page cache.
+    NSError *readError = nil;
+    NSData *data = [NSData dataWithContentsOfURL:url
+                                         options:NSDataReadingMappedAlways
+                                           error:&readError];
+    if (data == nil) {
+        if (error) {
+            *error = readError;
+        }
+        return nil;
+    }
+    
+    const uint8_t *bytes = data.bytes;
+    size_t length = data.length;
+    MJCompressedImageLayout layout;
+    memset(&layout, 0, sizeof(layout));
+    
+    const char *problem = NULL;
+    if (length >= sizeof(kMJKTXIdentifier) && memcmp(bytes, kMJKTXIdentifier, sizeof(kMJKTXIdentifier)) == 0) {
+        problem = MJParseKTX(bytes, length, &layout);
+    } else if (length >= sizeof(kMJKTX2Identifier) && memcmp(bytes, kMJKTX2Identifier, sizeof(kMJKTX2Identifier)) == 0) {
+        problem = MJParseKTX2(bytes, length, &layout);
+    } else {
+        problem = "The file is not a KTX or KTX2 file.";
+    }
+    
+    if (problem == NULL && ![self supportsInternalFormat:layout.internalFormat]) {
+        problem = "The texture format is not supported by the OpenGL context.";
+    }
+    
+    if (problem) {
+        if (error) {
+            NSString *description = [NSString stringWithFormat:@"%@: %s", url.lastPathComponent, problem];
+            *error = [NSError errorWithDomain:(NSString *)MJCompressedTextureErrorDomain
+                                         code:0
+                                     userInfo:@{NSLocalizedDescriptionKey: description}];
+        }
+        return nil;
+    }
+    
+    MJCompressedTexture *texture = [[MJCompressedTexture alloc] init];
+    if (![texture uploadLayout:&layout error:error]) {
+        return nil;
+    }
+    return texture;
+}
+
+- (BOOL)uploadLayout:(const MJCompressedImageLayout *)layout
+               error:(NSError *__autoreleasing *)error
+{
+    _target = (layout->faceCount == 6) ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    _internalFormat = layout->internalFormat;
+    _width = layout->width;
+    _height = layout->height;
+    _mipLevelCount = layout->levelCount;
+    
+    glGenTextures(1, &_name);
+    [[MJGLStateCache currentStateCache] bindTexture:_name target:_target unit:0];
+    
+    GLsizei width = _width;
+    GLsizei height = _height;
+    for (GLuint level = 0; level < layout->levelCount; level++) {
+        for (GLuint face = 0; face < layout->faceCount; face++) {
+            GLenum faceTarget = (_target == GL_TEXTURE_CUBE_MAP) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+            glCompressedTexImage2D(faceTarget, level, _internalFormat, width, height, 0,
+                                   layout->levelSize[level], layout->levelData[level][face]);
+            _byteSize += layout->levelSize[level];
+        }
+        width = MAX(width / 2, 1);
+        height = MAX(height / 2, 1);
+    }
+    
+    glTexParameteri(_target, GL_TEXTURE_MIN_FILTER, (_mipLevelCount > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(_target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(_target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(_target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    // Files do not always contain the full mip chain.
+    glTexParameteri(_target, GL_TEXTURE_MAX_LEVEL, _mipLevelCount - 1);
+    
+    GLenum glError = glGetError();
+    if (glError != GL_NO_ERROR) {
+        NSLog(@"GL ERROR: %d", glError);
+        glDeleteTextures(1, &_name);
+        [[MJGLStateCache currentStateCache] didDeleteTexture:_name];
+        _name = 0;
+        if (error) {
+            *error = [NSError errorWithDomain:(NSString *)MJCompressedTextureErrorDomain
+                                         code:glError
+                                     userInfo:@{NSLocalizedDescriptionKey: @"Could not upload the compressed texture."}];
+        }
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Querying formats
+
++ (BOOL)supportsInternalFormat:(GLenum)internalFormat
+{
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatCount);
+    if (formatCount <= 0) {
+        return NO;
+    }
+    
+    GLint formats[formatCount];
+    glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+    for (GLint i = 0; i < formatCount; i++) {
+        if ((GLenum)formats[i] == internalFormat) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+@end
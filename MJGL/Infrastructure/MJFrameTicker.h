@@ -25,10 +25,21 @@
 #import <Foundation/Foundation.h>
 
 @protocol MJFrameTickerDelegate;
+@class MJRenderThread;
+@class MJRenderCommandList;
+
+/** Number of buckets in the frame time histogram, one per millisecond. */
+#define kMJFrameTickerHistogramBucketCount 64
 
 /**
  * The frame ticker calls a delegate method everytime a new frame
  * is about to be rendered.
+ *
+ * By default the delegate is told the time elapsed since the last frame.
+ * With a fixed time step, the simulation is instead advanced in steps of
+ * the same length, as many as fit in the elapsed time, and the delegate is
+ * asked to render with the fraction of a step that is left over, so that
+ * it can interpolate between the last two simulation states.
  */
 @protocol MJFrameTicker <NSObject>
 
@@ -65,6 +76,58 @@
  */
 @interface MJFrameTicker : NSObject <MJFrameTicker>
 
+/**
+ * The length of a simulation step in seconds, or 0 to report the elapsed
+ * time of each frame as is. Defaults to 0.
+ */
+@property (nonatomic, assign) NSTimeInterval fixedTimeStep;
+
+/**
+ * The maximum number of simulation steps per frame with a fixed time step.
+ * If the simulation falls further behind than that, e.g. because each step
+ * takes longer than the step itself, the remaining time is dropped rather
+ * than making the next frame even later. Defaults to 5.
+ */
+@property (nonatomic, assign) NSUInteger maxStepsPerFrame;
+
+/**
+ * The longest elapsed time reported for a frame, so that a long stall,
+ * such as a breakpoint, does not make the simulation jump. Defaults to
+ * 0.25 seconds.
+ */
+@property (nonatomic, assign) NSTimeInterval maxElapsedTime;
+
+/**
+ * A render thread to pipeline the frames with, or nil to render them on
+ * the thread of the frame ticker. When set, the delegate records each
+ * frame into a command list instead of rendering it, and the render thread
+ * replays the list while the next frame is simulated. Defaults to nil.
+ */
+@property (nonatomic, strong) MJRenderThread *renderThread;
+
+/** Simulation time dropped so far by the limits above. */
+@property (nonatomic, assign, readonly) NSTimeInterval droppedTime;
+
+/**
+ * Get the number of frames whose measured time fell into a bucket of the
+ * frame time histogram. Bucket n counts frames of at least n but less
+ * than n + 1 milliseconds, and the last bucket also counts longer frames.
+ *
+ * @param bucket Index of the bucket, less than kMJFrameTickerHistogramBucketCount.
+ */
+- (NSUInteger)frameCountInHistogramBucket:(NSUInteger)bucket;
+
+/**
+ * Get the frame time that a percentage of the frames in the histogram
+ * were shorter than, at millisecond resolution.
+ *
+ * @param percentile Percentage of frames, e.g. 99.
+ */
+- (NSTimeInterval)frameTimeAtPercentile:(double)percentile;
+
+/** Clear the frame time histogram. */
+- (void)resetFrameTimeHistogram;
+
 #if !TARGET_OS_IPHONE
 /**
  * Initialize the frame ticker with the OS X OpenGL view to track frames for.
@@ -86,6 +149,8 @@
  */
 @protocol MJFrameTickerDelegate <NSObject>
 
+@optional
+
 /**
  * Called when the next frame is about to be rendered.
  *
@@ -94,5 +159,36 @@
  */
 - (void)frameTicker:(MJFrameTicker *)frameTicker nextFrameWithElapsedTime:(NSTimeInterval)elapsedTime;
 
+/**
+ * Called with a fixed time step, once per simulation step that is due.
+ *
+ * @param frameTicker The frame ticker object that called the method.
+ * @param timeStep The fixed time step.
+ */
+- (void)frameTicker:(MJFrameTicker *)frameTicker simulateStep:(NSTimeInterval)timeStep;
+
+/**
+ * Called with a fixed time step when the next frame is about to be
+ * rendered, after the simulation steps of the frame.
+ *
+ * @param frameTicker The frame ticker object that called the method.
+ * @param alpha The fraction of a step, in [0, 1), that has elapsed since
+ *              the last simulation step. Render the state interpolated
+ *              this far from the previous step towards the last one.
+ */
+- (void)frameTicker:(MJFrameTicker *)frameTicker renderWithAlpha:(double)alpha;
+
+/**
+ * Called with a render thread when the next frame is about to be rendered,
+ * after the frame has been simulated. Record the render work of the frame
+ * into the command list, without making any OpenGL calls directly.
+ *
+ * @param frameTicker The frame ticker object that called the method.
+ * @param commandList The command list to record the frame into.
+ * @param alpha The fraction of a step that has elapsed since the last
+ *              simulation step with a fixed time step, otherwise 0.
+ */
+- (void)frameTicker:(MJFrameTicker *)frameTicker recordFrame:(MJRenderCommandList *)commandList alpha:(double)alpha;
+
 @end
 
@@ -23,21 +23,18 @@
 //
 
 #import "MJFrameTicker.h"
+#import "MJRenderThread.h"
 
 #if !TARGET_OS_IPHONE
 #import <CoreVideo/CoreVideo.h>
-#include <sys/time.h>
+#import <OpenGL/OpenGL.h>
 #else
 #import <QuartzCore/QuartzCore.h>
 #endif
+#include <mach/mach_time.h>
 
-@interface MJFrameTicker ()
-
-#if !TARGET_OS_IPHONE
-@property (nonatomic, assign) struct timeval previousTime;
-#endif
-
-@end
+#define kMJFrameTickerDefaultMaxStepsPerFrame 5
+#define kMJFrameTickerDefaultMaxElapsedTime 0.25
 
 @implementation MJFrameTicker {
 #if !TARGET_OS_IPHONE
@@ -47,14 +44,33 @@
     CADisplayLink *_displayLink;
 #endif
     BOOL _running;
+    
+    uint64_t _previousTime;
+    double _secondsPerTick;
+    NSTimeInterval _accumulator;
+    NSUInteger _histogram[kMJFrameTickerHistogramBucketCount];
 }
 
 @synthesize delegate;
 
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _maxStepsPerFrame = kMJFrameTickerDefaultMaxStepsPerFrame;
+        _maxElapsedTime = kMJFrameTickerDefaultMaxElapsedTime;
+        
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        _secondsPerTick = 1e-9 * timebase.numer / timebase.denom;
+    }
+    return self;
+}
+
 #if !TARGET_OS_IPHONE
 - (id)initWithView:(NSOpenGLView *)view
 {
-    self = [super init];
+    self = [self init];
     if (self) {
         _view = view;
     }
@@ -82,11 +98,15 @@
         CGLPixelFormatObj cglPixelFormat = [_view.pixelFormat CGLPixelFormatObj];
         CVDisplayLinkSetCurrentCGDisplayFromOpenGLContext(_displayLink, cglContext, cglPixelFormat);
         
-        gettimeofday(&_previousTime, NULL);
+        _previousTime = mach_absolute_time();
+        _accumulator = 0.0;
         
         // Activate the display link
         CVDisplayLinkStart(_displayLink);
 #else
+        _previousTime = mach_absolute_time();
+        _accumulator = 0.0;
+        
 		_displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(tick:)];
 		[_displayLink setFrameInterval:1];
 		[_displayLink addToRunLoop:[NSRunLoop currentRunLoop] forMode:NSDefaultRunLoopMode];
@@ -112,7 +132,95 @@
 	}
 }
 
+#pragma mark - Ticking
+
+- (void)tick
+{
+    uint64_t now = mach_absolute_time();
+    NSTimeInterval elapsedTime = (now - _previousTime) * _secondsPerTick;
+    _previousTime = now;
+    
+    NSUInteger bucket = MIN((NSUInteger)(elapsedTime * 1000.0), kMJFrameTickerHistogramBucketCount - 1);
+    _histogram[bucket]++;
+    
+    if (elapsedTime > _maxElapsedTime) {
+        _droppedTime += elapsedTime - _maxElapsedTime;
+        elapsedTime = _maxElapsedTime;
+    }
+    
+    id<MJFrameTickerDelegate> frameDelegate = self.delegate;
+    
+    if (_fixedTimeStep <= 0.0) {
+        if ([frameDelegate respondsToSelector:@selector(frameTicker:nextFrameWithElapsedTime:)]) {
+            [frameDelegate frameTicker:self nextFrameWithElapsedTime:elapsedTime];
+        }
+        [self recordFrameWithAlpha:0.0];
+        return;
+    }
+    
+    BOOL simulates = [frameDelegate respondsToSelector:@selector(frameTicker:simulateStep:)];
+    _accumulator += elapsedTime;
+    NSUInteger steps = 0;
+    while (_accumulator >= _fixedTimeStep && steps < _maxStepsPerFrame) {
+        if (simulates) {
+            [frameDelegate frameTicker:self simulateStep:_fixedTimeStep];
+        }
+        _accumulator -= _fixedTimeStep;
+        steps++;
+    }
+    
+    // Spiral of death guard: if the steps could not catch up, drop the
+    // backlog instead of carrying it over to an even longer next frame.
+    if (_accumulator >= _fixedTimeStep) {
+        NSTimeInterval backlog = _accumulator - fmod(_accumulator, _fixedTimeStep);
+        _droppedTime += backlog;
+        _accumulator -= backlog;
+    }
+    
+    double alpha = _accumulator / _fixedTimeStep;
+    if ([frameDelegate respondsToSelector:@selector(frameTicker:renderWithAlpha:)]) {
+        [frameDelegate frameTicker:self renderWithAlpha:alpha];
+    }
+    [self recordFrameWithAlpha:alpha];
+}
+
+- (void)recordFrameWithAlpha:(double)alpha
+{
+    MJRenderThread *renderThread = _renderThread;
+    id<MJFrameTickerDelegate> frameDelegate = self.delegate;
+    if (!renderThread.running
+        || ![frameDelegate respondsToSelector:@selector(frameTicker:recordFrame:alpha:)]) {
+        return;
+    }
+    
+    // Blocks while the render thread is the maximum number of frames behind.
+    MJRenderCommandList *commandList = [renderThread beginFrame];
+    if (commandList == nil) {
+        // The render thread was stopped while we waited.
+        return;
+    }
+    [frameDelegate frameTicker:self recordFrame:commandList alpha:alpha];
+    [renderThread commitFrame:commandList];
+}
+
 #if !TARGET_OS_IPHONE
+/**
+ * The display link calls back on a thread of its own, while the main
+ * thread may use the context of the view at the same time, e.g. to update
+ * it when the view is resized. Lock the context while the frame is ticked.
+ */
+- (void)tickLockingContext
+{
+    CGLContextObj cglContext = [_view.openGLContext CGLContextObj];
+    if (cglContext) {
+        CGLLockContext(cglContext);
+    }
+    [self tick];
+    if (cglContext) {
+        CGLUnlockContext(cglContext);
+    }
+}
+
 // This is the renderer output callback function
 static CVReturn MJDisplayLinkCallback(CVDisplayLinkRef displayLink,
                                       const CVTimeStamp *now,
@@ -122,29 +230,8 @@ static CVReturn MJDisplayLinkCallback(CVDisplayLinkRef displayLink,
                                       void *displayLinkContext)
 {
     @autoreleasepool {
-        struct timeval now;
-        gettimeofday(&now, NULL);
-        
         MJFrameTicker *frameTicker = (__bridge MJFrameTicker *)displayLinkContext;
-        
-        double elapsedSeconds = now.tv_sec - frameTicker.previousTime.tv_sec;
-        double elapsedMicroSeconds = now.tv_usec - frameTicker.previousTime.tv_usec;
-        NSTimeInterval elapsedTime = elapsedSeconds + elapsedMicroSeconds * 0.000001;
-        
-        // Set some thresholds to get reasonable values no matter what.
-        if (elapsedTime < (1.0 / 512.0)) {
-            elapsedTime = 1 / 60.0;
-        } else if (elapsedTime > (1.0 / 4.0)) {
-            elapsedTime = 1 / 60.0;
-        }
-        
-        frameTicker.previousTime = now;
-        
-        
-        if (frameTicker.delegate && [frameTicker.delegate respondsToSelector:@selector(frameTicker:nextFrameWithElapsedTime:)]) {
-            [frameTicker.delegate frameTicker:frameTicker nextFrameWithElapsedTime:elapsedTime];
-        }
-        
+        [frameTicker tickLockingContext];
         return kCVReturnSuccess;
     }
 }
@@ -152,12 +239,45 @@ static CVReturn MJDisplayLinkCallback(CVDisplayLinkRef displayLink,
 - (void)tick:(CADisplayLink *)displayLink
 {
     @autoreleasepool {
-        NSTimeInterval elapsedTime = displayLink.duration;
-        if (self.delegate && [self.delegate respondsToSelector:@selector(frameTicker:nextFrameWithElapsedTime:)]) {
-            [self.delegate frameTicker:self nextFrameWithElapsedTime:elapsedTime];
-        }
+        [self tick];
     }
 }
 #endif
 
+#pragma mark - Frame time histogram
+
+- (NSUInteger)frameCountInHistogramBucket:(NSUInteger)bucket
+{
+    if (bucket >= kMJFrameTickerHistogramBucketCount) {
+        return 0;
+    }
+    return _histogram[bucket];
+}
+
+- (NSTimeInterval)frameTimeAtPercentile:(double)percentile
+{
+    NSUInteger total = 0;
+    for (NSUInteger i = 0; i < kMJFrameTickerHistogramBucketCount; i++) {
+        total += _histogram[i];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    
+    NSUInteger target = (NSUInteger)ceil(total * MIN(MAX(percentile, 0.0), 100.0) / 100.0);
+    NSUInteger count = 0;
+    for (NSUInteger i = 0; i < kMJFrameTickerHistogramBucketCount; i++) {
+        count += _histogram[i];
+        if (count >= target && count > 0) {
+            return (i + 1) * 0.001;
+        }
+    }
+    return kMJFrameTickerHistogramBucketCount * 0.001;
+}
+
+- (void)resetFrameTimeHistogram
+{
+    memset(_histogram, 0, sizeof(_histogram));
+}
+
 @end
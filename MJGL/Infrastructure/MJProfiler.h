@@ -0,0 +1,168 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+
+/**
+ * Profiling markers are only compiled in when MJ_PROFILING is defined,
+ * e.g. in the preprocessor macros of debug builds. Otherwise the macros
+ * below expand to nothing.
+ */
+#ifdef MJ_PROFILING
+
+#define MJ_PROFILE_CONCAT_(a, b) a##b
+#define MJ_PROFILE_CONCAT(a, b) MJ_PROFILE_CONCAT_(a, b)
+
+/**
+ * Profile the rest of the enclosing scope on the CPU and the GPU under a
+ * name, which must be a string literal.
+ */
+#define MJProfileScope(name) \
+    __attribute__((cleanup(MJProfilerEndScope), unused)) \
+    MJProfilerScopeToken MJ_PROFILE_CONCAT(mjProfileScope, __COUNTER__) = MJProfilerBeginScope(name)
+
+/** Mark the start of a frame of the shared profiler. */
+#define MJProfileBeginFrame() [[MJProfiler sharedProfiler] beginFrame]
+
+/** Mark the end of a frame of the shared profiler. */
+#define MJProfileEndFrame() [[MJProfiler sharedProfiler] endFrame]
+
+#else
+
+#define MJProfileScope(name)
+#define MJProfileBeginFrame()
+#define MJProfileEndFrame()
+
+#endif
+
+/**
+ * Identifies a profiled scope between its begin and end, by the frame it
+ * was begun in and its entry in that frame.
+ */
+typedef struct MJProfilerScopeToken
+{
+    NSUInteger frame;
+    NSInteger entry;
+} MJProfilerScopeToken;
+
+/**
+ * Rolling statistics of a profiled scope over the last frames it was used
+ * in. Times are in milliseconds, summed over all uses of the scope within
+ * a frame.
+ */
+typedef struct MJProfilerStatistics
+{
+    double cpuMin;
+    double cpuAverage;
+    double cpuP99;
+    NSUInteger cpuSampleCount;
+    
+    double gpuMin;
+    double gpuAverage;
+    double gpuP99;
+    NSUInteger gpuSampleCount;
+} MJProfilerStatistics;
+
+/** Begin a scope of the shared profiler. Used by MJProfileScope. */
+MJProfilerScopeToken MJProfilerBeginScope(const char *name);
+
+/** End a scope of the shared profiler. Used by MJProfileScope. */
+void MJProfilerEndScope(MJProfilerScopeToken *token);
+
+/**
+ * The MJProfiler object measures the CPU and GPU time of named scopes.
+ *
+ * GPU time is measured with GL_TIMESTAMP queries written at the start and
+ * end of each scope. The queries of a frame are only read back when their
+ * slot in a ring of frames comes up for reuse a few frames later, and are
+ * dropped if the GPU still has not finished them, so the profiler never
+ * waits for the GPU. Contexts without timestamp queries, such as OpenGL ES
+ * on iOS, only get CPU times.
+ *
+ * All methods must be called on the thread of the OpenGL context.
+ */
+@interface MJProfiler : NSObject
+
+/** YES if the current context supports timestamp queries. */
+@property (nonatomic, assign, readonly, getter = isGPUTimingSupported) BOOL gpuTimingSupported;
+
+/** Number of frames whose GPU times were not ready when their slot was reused. */
+@property (nonatomic, assign, readonly) NSUInteger droppedFrameCount;
+
+/**
+ * Number of scopes that were dropped because they were still open when
+ * their frame ended. A scope must begin and end within the same frame.
+ */
+@property (nonatomic, assign, readonly) NSUInteger droppedScopeCount;
+
+/** The names of the scopes profiled so far. */
+@property (nonatomic, strong, readonly) NSArray *scopeNames;
+
+/** The profiler used by the profiling macros. */
++ (MJProfiler *)sharedProfiler;
+
+/** Mark the start of a frame. Scopes outside of frames are ignored. */
+- (void)beginFrame;
+
+/** Mark the end of a frame. */
+- (void)endFrame;
+
+/**
+ * Begin a profiled scope. Scopes may be nested.
+ *
+ * @param name Name of the scope, which must stay valid, e.g. a string literal.
+ * @return Token to end the scope with.
+ */
+- (MJProfilerScopeToken)beginScope:(const char *)name;
+
+/**
+ * End a profiled scope. Scopes that were begun in an earlier frame are
+ * ignored, since they have already been dropped.
+ *
+ * @param token The token returned when the scope was begun.
+ */
+- (void)endScope:(MJProfilerScopeToken)token;
+
+/**
+ * Get the rolling statistics of a scope.
+ *
+ * @param name Name of the scope.
+ * @param statistics Set to the statistics of the scope.
+ * @return NO if no scope with the name has been profiled.
+ */
+- (BOOL)statisticsForScope:(NSString *)name
+                statistics:(MJProfilerStatistics *)statistics;
+
+/**
+ * Create a trace of the most recent scopes in the Chrome trace event
+ * format, which can be opened in chrome://tracing. CPU scopes are on
+ * thread 1 and GPU scopes on thread 2.
+ *
+ * @return The trace as UTF-8 encoded JSON.
+ */
+- (NSData *)chromeTraceData;
+
+@end
@@ -0,0 +1,465 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJProfiler.h"
+#include <mach/mach_time.h>
+
+#define kMJProfilerFrameLatency 4
+#define kMJProfilerMaxEntriesPerFrame 256
+#define kMJProfilerMaxScopes 64
+#define kMJProfilerSampleCount 128
+#define kMJProfilerTraceCapacity 16384
+
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+/** A use of a scope within a frame. */
+typedef struct MJProfilerEntry
+{
+    uint16_t scope;
+    BOOL ended;
+    uint64_t cpuBegin;
+    uint64_t cpuEnd;
+} MJProfilerEntry;
+
+/** A frame in the ring of frames waiting for their GPU times. */
+typedef struct MJProfilerFrame
+{
+    MJProfilerEntry entries[kMJProfilerMaxEntriesPerFrame];
+    NSUInteger entryCount;
+    uint64_t cpuBegin;
+    BOOL waitingForGPU;
+} MJProfilerFrame;
+
+/** Rolling samples of a scope, in milliseconds. */
+typedef struct MJProfilerScope
+{
+    const char *name;
+    float cpuSamples[kMJProfilerSampleCount];
+    float gpuSamples[kMJProfilerSampleCount];
+    NSUInteger cpuSampleCount;
+    NSUInteger gpuSampleCount;
+    NSUInteger cpuNextSample;
+    NSUInteger gpuNextSample;
+    double cpuFrameTime;
+    double gpuFrameTime;
+    BOOL usedInFrame;
+} MJProfilerScope;
+
+/** A scope in the trace, in nanoseconds since the profiler was created. */
+typedef struct MJProfilerTraceEvent
+{
+    uint16_t scope;
+    BOOL gpu;
+    uint64_t begin;
+    uint64_t duration;
+} MJProfilerTraceEvent;
+
+static void MJProfilerAddSample(float *samples, NSUInteger *count, NSUInteger *next, float sample)
+{
+    samples[*next] = sample;
+    *next = (*next + 1) % kMJProfilerSampleCount;
+    *count = MIN(*count + 1, kMJProfilerSampleCount);
+}
+
+static int MJProfilerCompareSamples(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static void MJProfilerComputeStatistics(const float *samples, NSUInteger count,
+                                        double *min, double *average, double *p99)
+{
+    *min = *average = *p99 = 0.0;
+    if (count == 0) {
+        return;
+    }
+    float sorted[kMJProfilerSampleCount];
+    memcpy(sorted, samples, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), MJProfilerCompareSamples);
+    
+    double sum = 0.0;
+    for (NSUInteger i = 0; i < count; i++) {
+        sum += sorted[i];
+    }
+    *min = sorted[0];
+    *average = sum / count;
+    *p99 = sorted[(NSUInteger)ceil(0.99 * count) - 1];
+}
+
+@implementation MJProfiler {
+    MJProfilerFrame *_frames;
+    NSUInteger _frameIndex;
+    BOOL _inFrame;
+    BOOL _initializedQueries;
+    
+    // Two timestamp queries, begin and end, per entry of each frame.
+    GLuint *_queries;
+    
+    MJProfilerScope *_scopes;
+    NSUInteger _scopeCount;
+    
+    MJProfilerTraceEvent *_trace;
+    NSUInteger _traceCount;
+    NSUInteger _traceNext;
+    
+    uint64_t _startTime;
+    mach_timebase_info_data_t _timebase;
+}
+
++ (MJProfiler *)sharedProfiler
+{
+    static dispatch_once_t pred;
+    static MJProfiler *instance = nil;
+    dispatch_once(&pred, ^{
+        instance = [[MJProfiler alloc] init];
+    });
+    return instance;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _frames = calloc(kMJProfilerFrameLatency, sizeof(MJProfilerFrame));
+        _scopes = calloc(kMJProfilerMaxScopes, sizeof(MJProfilerScope));
+        _trace = calloc(kMJProfilerTraceCapacity, sizeof(MJProfilerTraceEvent));
+        mach_timebase_info(&_timebase);
+        _startTime = mach_absolute_time();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+#if !TARGET_OS_IPHONE
+    if (_queries) {
+        glDeleteQueries(kMJProfilerFrameLatency * kMJProfilerMaxEntriesPerFrame * 2, _queries);
+    }
+#endif
+    free(_queries);
+    free(_frames);
+    free(_scopes);
+    free(_trace);
+}
+
+- (NSArray *)scopeNames
+{
+    NSMutableArray *names = [NSMutableArray arrayWithCapacity:_scopeCount];
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        [names addObject:@(_scopes[i].name)];
+    }
+    return names;
+}
+
+/** Nanoseconds since the profiler was created. */
+- (uint64_t)now
+{
+    return (mach_absolute_time() - _startTime) * _timebase.numer / _timebase.denom;
+}
+
+#pragma mark - Frames
+
+- (void)initializeQueries
+{
+    _initializedQueries = YES;
+    
+#if TARGET_OS_IPHONE
+    _gpuTimingSupported = NO;
+#else
+    // Software renderers may not implement the timestamp counter. Clear
+    // errors left by earlier calls first, so they are not blamed on it.
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    GLint counterBits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+    _gpuTimingSupported = (glGetError() == GL_NO_ERROR && counterBits > 0);
+    if (_gpuTimingSupported) {
+        GLsizei queryCount = kMJProfilerFrameLatency * kMJProfilerMaxEntriesPerFrame * 2;
+        _queries = malloc(queryCount * sizeof(GLuint));
+        glGenQueries(queryCount, _queries);
+    }
+#endif
+}
+
+- (void)beginFrame
+{
+    if (!_initializedQueries) {
+        [self initializeQueries];
+    }
+    
+    MJProfilerFrame *frame = &_frames[_frameIndex % kMJProfilerFrameLatency];
+    if (frame->waitingForGPU) {
+        [self resolveGPUTimesOfFrame:frame
+                             queries:[self queriesOfFrameAtIndex:_frameIndex]];
+    }
+    frame->entryCount = 0;
+    frame->cpuBegin = [self now];
+    _inFrame = YES;
+}
+
+- (void)endFrame
+{
+    if (!_inFrame) {
+        return;
+    }
+    _inFrame = NO;
+    
+    MJProfilerFrame *frame = &_frames[_frameIndex % kMJProfilerFrameLatency];
+    for (NSUInteger i = 0; i < frame->entryCount; i++) {
+        MJProfilerEntry *entry = &frame->entries[i];
+        if (!entry->ended) {
+            // Still open, so it would cross into the next frame.
+            _droppedScopeCount++;
+            continue;
+        }
+        MJProfilerScope *scope = &_scopes[entry->scope];
+        scope->cpuFrameTime += (entry->cpuEnd - entry->cpuBegin) * 1e-6;
+        scope->usedInFrame = YES;
+        [self addTraceEventForScope:entry->scope
+                                gpu:NO
+                              begin:entry->cpuBegin
+                           duration:entry->cpuEnd - entry->cpuBegin];
+    }
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        MJProfilerScope *scope = &_scopes[i];
+        if (scope->usedInFrame) {
+            MJProfilerAddSample(scope->cpuSamples, &scope->cpuSampleCount, &scope->cpuNextSample,
+                                (float)scope->cpuFrameTime);
+            scope->cpuFrameTime = 0.0;
+            scope->usedInFrame = NO;
+        }
+    }
+    
+    frame->waitingForGPU = _gpuTimingSupported && frame->entryCount > 0;
+    _frameIndex++;
+}
+
+- (GLuint *)queriesOfFrameAtIndex:(NSUInteger)frameIndex
+{
+    return _queries + (frameIndex % kMJProfilerFrameLatency) * kMJProfilerMaxEntriesPerFrame * 2;
+}
+
+- (void)resolveGPUTimesOfFrame:(MJProfilerFrame *)frame queries:(GLuint *)queries
+{
+    frame->waitingForGPU = NO;
+    
+#if !TARGET_OS_IPHONE
+    // Never wait for the GPU, rather drop the frame if it is still behind.
+    GLint available = 1;
+    for (NSUInteger i = 0; available && i < frame->entryCount; i++) {
+        if (!frame->entries[i].ended) {
+            continue;
+        }
+        glGetQueryObjectiv(queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (!available) {
+        _droppedFrameCount++;
+        return;
+    }
+    
+    // The begin query of the first entry was written even if the entry
+    // was dropped, so it can still serve as the start of the frame.
+    GLuint64 frameBegin = 0;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &frameBegin);
+    for (NSUInteger i = 0; i < frame->entryCount; i++) {
+        MJProfilerEntry *entry = &frame->entries[i];
+        if (!entry->ended) {
+            continue;
+        }
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        
+        MJProfilerScope *scope = &_scopes[entry->scope];
+        scope->gpuFrameTime += (end - begin) * 1e-6;
+        scope->usedInFrame = YES;
+        
+        // GPU timestamps have their own epoch, so line them up with the
+        // CPU start of the first scope of the frame.
+        [self addTraceEventForScope:entry->scope
+                                gpu:YES
+                              begin:frame->entries[0].cpuBegin + (begin - frameBegin)
+                           duration:end - begin];
+    }
+    
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        MJProfilerScope *scope = &_scopes[i];
+        if (scope->usedInFrame) {
+            MJProfilerAddSample(scope->gpuSamples, &scope->gpuSampleCount, &scope->gpuNextSample,
+                                (float)scope->gpuFrameTime);
+            scope->gpuFrameTime = 0.0;
+            scope->usedInFrame = NO;
+        }
+    }
+#endif
+}
+
+#pragma mark - Scopes
+
+- (uint16_t)indexOfScope:(const char *)name
+{
+    // Names are usually string literals, so compare pointers first.
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        if (_scopes[i].name == name) {
+            return i;
+        }
+    }
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        if (strcmp(_scopes[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (_scopeCount == kMJProfilerMaxScopes) {
+        return UINT16_MAX;
+    }
+    _scopes[_scopeCount].name = name;
+    return _scopeCount++;
+}
+
+- (MJProfilerScopeToken)beginScope:(const char *)name
+{
+    MJProfilerScopeToken token = { _frameIndex, -1 };
+    MJProfilerFrame *frame = &_frames[_frameIndex % kMJProfilerFrameLatency];
+    if (!_inFrame || frame->entryCount == kMJProfilerMaxEntriesPerFrame) {
+        return token;
+    }
+    uint16_t scope = [self indexOfScope:name];
+    if (scope == UINT16_MAX) {
+        return token;
+    }
+    
+    token.entry = frame->entryCount++;
+    MJProfilerEntry *entry = &frame->entries[token.entry];
+    entry->scope = scope;
+    entry->ended = NO;
+    entry->cpuBegin = [self now];
+    entry->cpuEnd = entry->cpuBegin;
+    
+#if !TARGET_OS_IPHONE
+    if (_gpuTimingSupported) {
+        glQueryCounter([self queriesOfFrameAtIndex:_frameIndex][token.entry * 2], GL_TIMESTAMP);
+    }
+#endif
+    return token;
+}
+
+- (void)endScope:(MJProfilerScopeToken)token
+{
+    MJProfilerFrame *frame = &_frames[_frameIndex % kMJProfilerFrameLatency];
+    if (!_inFrame || token.frame != _frameIndex
+        || token.entry < 0 || token.entry >= (NSInteger)frame->entryCount) {
+        return;
+    }
+    MJProfilerEntry *entry = &frame->entries[token.entry];
+    if (entry->ended) {
+        return;
+    }
+    entry->cpuEnd = [self now];
+    entry->ended = YES;
+    
+#if !TARGET_OS_IPHONE
+    if (_gpuTimingSupported) {
+        glQueryCounter([self queriesOfFrameAtIndex:_frameIndex][token.entry * 2 + 1], GL_TIMESTAMP);
+    }
+#endif
+}
+
+#pragma mark - Statistics
+
+- (BOOL)statisticsForScope:(NSString *)name
+                statistics:(MJProfilerStatistics *)statistics
+{
+    const char *scopeName = name.UTF8String;
+    for (NSUInteger i = 0; i < _scopeCount; i++) {
+        MJProfilerScope *scope = &_scopes[i];
+        if (strcmp(scope->name, scopeName) != 0) {
+            continue;
+        }
+        MJProfilerComputeStatistics(scope->cpuSamples, scope->cpuSampleCount,
+                                    &statistics->cpuMin, &statistics->cpuAverage, &statistics->cpuP99);
+        MJProfilerComputeStatistics(scope->gpuSamples, scope->gpuSampleCount,
+                                    &statistics->gpuMin, &statistics->gpuAverage, &statistics->gpuP99);
+        statistics->cpuSampleCount = scope->cpuSampleCount;
+        statistics->gpuSampleCount = scope->gpuSampleCount;
+        return YES;
+    }
+    return NO;
+}
+
+#pragma mark - Tracing
+
+- (void)addTraceEventForScope:(uint16_t)scope
+                          gpu:(BOOL)gpu
+                        begin:(uint64_t)begin
+                     duration:(uint64_t)duration
+{
+    MJProfilerTraceEvent *event = &_trace[_traceNext];
+    event->scope = scope;
+    event->gpu = gpu;
+    event->begin = begin;
+    event->duration = duration;
+    _traceNext = (_traceNext + 1) % kMJProfilerTraceCapacity;
+    _traceCount = MIN(_traceCount + 1, kMJProfilerTraceCapacity);
+}
+
+- (NSData *)chromeTraceData
+{
+    NSMutableString *json = [NSMutableString stringWithString:@"{\"traceEvents\":["];
+    NSUInteger first = (_traceNext + kMJProfilerTraceCapacity - _traceCount) % kMJProfilerTraceCapacity;
+    for (NSUInteger i = 0; i < _traceCount; i++) {
+        MJProfilerTraceEvent *event = &_trace[(first + i) % kMJProfilerTraceCapacity];
+        // Scope names are code identifiers, so they are not escaped.
+        [json appendFormat:@"%@{\"name\":\"%s\",\"cat\":\"%@\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+         (i > 0) ? @"," : @"",
+         _scopes[event->scope].name,
+         event->gpu ? @"gpu" : @"cpu",
+         event->begin * 1e-3,
+         event->duration * 1e-3,
+         event->gpu ? 2 : 1];
+    }
+    [json appendString:@"],\"displayTimeUnit\":\"ms\"}"];
+    return [json dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+@end
+
+MJProfilerScopeToken MJProfilerBeginScope(const char *name)
+{
+    return [[MJProfiler sharedProfiler] beginScope:name];
+}
+
+void MJProfilerEndScope(MJProfilerScopeToken *token)
+{
+    [[MJProfiler sharedProfiler] endScope:*token];
+}
@@ -0,0 +1,47 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Sort 64-bit keys in ascending order and apply the same permutation to
+ * an array of 32-bit values, typically indices of the items the keys
+ * were computed for.
+ *
+ * The sort is a stable LSD radix sort with 8-bit digits. Passes over
+ * digits that are the same for all keys are skipped, so keys that only
+ * use a few of their bits are sorted in a few passes.
+ *
+ * @param keys The keys to sort.
+ * @param values The values to permute along with the keys.
+ * @param scratchKeys Scratch memory with room for count keys.
+ * @param scratchValues Scratch memory with room for count values.
+ * @param count The number of keys and values.
+ */
+void MJRadixSort64(uint64_t *keys,
+                   uint32_t *values,
+                   uint64_t *scratchKeys,
+                   uint32_t *scratchValues,
+                   size_t count);
@@ -0,0 +1,90 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import "MJRadixSort.h"
+
+#define kMJRadixSortDigitCount 8
+#define kMJRadixSortBucketCount 256
+
+void MJRadixSort64(uint64_t *keys,
+                   uint32_t *values,
+                   uint64_t *scratchKeys,
+                   uint32_t *scratchValues,
+                   size_t count)
+{
+    if (count < 2) {
+        return;
+    }
+    
+    // Build the histograms of all digits in a single pass.
+    size_t histograms[kMJRadixSortDigitCount][kMJRadixSortBucketCount];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = keys[i];
+        for (int digit = 0; digit < kMJRadixSortDigitCount; digit++) {
+            histograms[digit][(key >> (digit * 8)) & 0xff]++;
+        }
+    }
+    
+    uint64_t *sourceKeys = keys;
+    uint32_t *sourceValues = values;
+    uint64_t *destinationKeys = scratchKeys;
+    uint32_t *destinationValues = scratchValues;
+    
+    for (int digit = 0; digit < kMJRadixSortDigitCount; digit++) {
+        size_t *histogram = histograms[digit];
+        
+        // All keys have the same digit, nothing would move.
+        if (histogram[(sourceKeys[0] >> (digit * 8)) & 0xff] == count) {
+            continue;
+        }
+        
+        size_t offset = 0;
+        for (int bucket = 0; bucket < kMJRadixSortBucketCount; bucket++) {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            uint64_t key = sourceKeys[i];
+            size_t position = histogram[(key >> (digit * 8)) & 0xff]++;
+            destinationKeys[position] = key;
+            destinationValues[position] = sourceValues[i];
+        }
+        
+        uint64_t *swapKeys = sourceKeys;
+        sourceKeys = destinationKeys;
+        destinationKeys = swapKeys;
+        uint32_t *swapValues = sourceValues;
+        sourceValues = destinationValues;
+        destinationValues = swapValues;
+    }
+    
+    if (sourceKeys != keys) {
+        memcpy(keys, sourceKeys, count * sizeof(uint64_t));
+        memcpy(values, sourceValues, count * sizeof(uint32_t));
+    }
+}
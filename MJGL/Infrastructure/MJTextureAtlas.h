@@ -0,0 +1,123 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import <GLKit/GLKit.h>
+#import "MJGL.h"
+
+/**
+ * The location of an image in a texture atlas.
+ */
+typedef struct MJTextureAtlasRegion
+{
+    /** The name of the page texture that holds the image. */
+    GLuint texture;
+    
+    /** Texture coordinates of the image in the page, as (u0, v0, u1, v1). */
+    GLKVector4 textureRect;
+    
+    /** Width and height of the image in pixels. */
+    GLKVector2 size;
+} MJTextureAtlasRegion;
+
+/**
+ * The MJTextureAtlas object packs many small images into a few large
+ * textures, called pages, so that sprites using different images can be
+ * drawn without changing texture.
+ *
+ * Images are placed with a skyline bottom-left packer and uploaded to
+ * their page with glTexSubImage2D as they are added, so images can be
+ * added at any time. A new page is created when an image does not fit
+ * in any of the existing pages.
+ *
+ * Each image is surrounded by a border of padding filled with copies of
+ * its edge pixels, so that filtering does not bleed neighbouring images
+ * into it. A padding of p pixels keeps the first log2(p) mip levels free
+ * of bleeding.
+ *
+ * The pages hold straight, not premultiplied, alpha like textures loaded
+ * with GLKTextureLoader, so they are blended with GL_SRC_ALPHA and
+ * GL_ONE_MINUS_SRC_ALPHA.
+ */
+@interface MJTextureAtlas : NSObject
+
+/** Width and height of each page in pixels. */
+@property (nonatomic, assign, readonly) GLuint pageSize;
+
+/** The number of pixels of padding around each image. */
+@property (nonatomic, assign, readonly) GLuint padding;
+
+/** YES if the pages have mipmaps. */
+@property (nonatomic, assign, readonly, getter = isMipmapped) BOOL mipmapped;
+
+/** The number of pages created so far. */
+@property (nonatomic, assign, readonly) NSUInteger pageCount;
+
+/** The number of images in the atlas. */
+@property (nonatomic, assign, readonly) NSUInteger imageCount;
+
+/**
+ * Initialize an empty texture atlas.
+ *
+ * @param pageSize Width and height of each page in pixels.
+ * @param padding Pixels of padding around each image.
+ * @param mipmapped YES if the pages should have mipmaps.
+ */
+- (id)initWithPageSize:(GLuint)pageSize
+               padding:(GLuint)padding
+             mipmapped:(BOOL)mipmapped;
+
+/**
+ * Looks up an image in the atlas, loading it from a PNG in the main bundle
+ * and adding it to the atlas if it is not there yet.
+ *
+ * @param region Set to the location of the image.
+ * @param imageName Name of the image in the main bundle.
+ * @return YES if the image was found, NO if it could not be loaded or
+ *         is larger than a page.
+ */
+- (BOOL)getRegion:(MJTextureAtlasRegion *)region
+         forImage:(NSString *)imageName;
+
+/**
+ * Adds an image to the atlas.
+ *
+ * @param image The image to add.
+ * @param imageName The name to look the image up by.
+ * @param region Set to the location of the image. May be NULL.
+ * @return YES if the image was added, NO if it is larger than a page.
+ */
+- (BOOL)addImage:(CGImageRef)image
+        withName:(NSString *)imageName
+          region:(MJTextureAtlasRegion *)region;
+
+/**
+ * Regenerates the mipmaps of the pages that images have been added to
+ * since the last call. Call it before drawing with the atlas. Does nothing
+ * if the atlas is not mipmapped.
+ */
+- (void)updateMipmaps;
+
+@end
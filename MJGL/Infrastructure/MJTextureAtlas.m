@@ -0,0 +1,402 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJTextureAtlas.h"
+#import "MJGLStateCache.h"
+#import <ImageIO/ImageIO.h>
+
+/** A horizontal segment of the skyline, the top edge of the packed images. */
+typedef struct MJSkylineNode
+{
+    GLuint x;
+    GLuint y;
+    GLuint width;
+} MJSkylineNode;
+
+/** A page of the atlas and the skyline of the images packed into it. */
+typedef struct MJAtlasPage
+{
+    GLuint texture;
+    BOOL dirty;
+    MJSkylineNode *nodes;
+    NSUInteger nodeCount;
+} MJAtlasPage;
+
+/**
+ * Returns the lowest y at which a rectangle starting at the left edge of a
+ * node fits on top of the skyline, or UINT32_MAX if it does not fit.
+ */
+static GLuint MJSkylineFit(const MJAtlasPage *page, GLuint pageSize,
+                           NSUInteger index, GLuint width, GLuint height)
+{
+    GLuint x = page->nodes[index].x;
+    if (x + width > pageSize) {
+        return UINT32_MAX;
+    }
+    
+    GLuint y = 0;
+    GLuint widthLeft = width;
+    for (NSUInteger i = index; widthLeft > 0; i++) {
+        y = MAX(y, page->nodes[i].y);
+        if (y + height > pageSize) {
+            return UINT32_MAX;
+        }
+        widthLeft -= MIN(widthLeft, page->nodes[i].width);
+    }
+    return y;
+}
+
+/**
+ * Places a rectangle on the skyline of a page, as low as possible and then
+ * as far to the left as possible. Returns NO if it does not fit.
+ */
+static BOOL MJSkylineInsert(MJAtlasPage *page, GLuint pageSize,
+                            GLuint width, GLuint height, GLuint *outX, GLuint *outY)
+{
+    NSUInteger bestIndex = NSNotFound;
+    GLuint bestBottom = UINT32_MAX;
+    GLuint bestWidth = UINT32_MAX;
+    GLuint bestY = 0;
+    
+    for (NSUInteger i = 0; i < page->nodeCount; i++) {
+        GLuint y = MJSkylineFit(page, pageSize, i, width, height);
+        if (y == UINT32_MAX) {
+            continue;
+        }
+        if (y + height < bestBottom ||
+            (y + height == bestBottom && page->nodes[i].width < bestWidth)) {
+            bestIndex = i;
+            bestBottom = y + height;
+            bestWidth = page->nodes[i].width;
+            bestY = y;
+        }
+    }
+    if (bestIndex == NSNotFound) {
+        return NO;
+    }
+    
+    MJSkylineNode node = { page->nodes[bestIndex].x, bestY + height, width };
+    memmove(&page->nodes[bestIndex + 1], &page->nodes[bestIndex],
+            (page->nodeCount - bestIndex) * sizeof(MJSkylineNode));
+    page->nodes[bestIndex] = node;
+    page->nodeCount++;
+    
+    // Cut away the parts of the following nodes now covered by the new node.
+    NSUInteger i = bestIndex + 1;
+    while (i < page->nodeCount) {
+        MJSkylineNode *previous = &page->nodes[i - 1];
+        MJSkylineNode *current = &page->nodes[i];
+        GLuint previousEnd = previous->x + previous->width;
+        if (current->x >= previousEnd) {
+            break;
+        }
+        GLuint shrink = previousEnd - current->x;
+        if (current->width > shrink) {
+            current->x += shrink;
+            current->width -= shrink;
+            break;
+        }
+        memmove(current, current + 1, (page->nodeCount - i - 1) * sizeof(MJSkylineNode));
+        page->nodeCount--;
+    }
+    
+    // Merge neighbouring nodes at the same height.
+    i = 0;
+    while (i + 1 < page->nodeCount) {
+        if (page->nodes[i].y == page->nodes[i + 1].y) {
+            page->nodes[i].width += page->nodes[i + 1].width;
+            memmove(&page->nodes[i + 1], &page->nodes[i + 2],
+                    (page->nodeCount - i - 2) * sizeof(MJSkylineNode));
+            page->nodeCount--;
+        } else {
+            i++;
+        }
+    }
+    
+    *outX = node.x;
+    *outY = bestY;
+    return YES;
+}
+
+/**
+ * Fills the padding around an image in an RGBA8 buffer with copies of the
+ * edge pixels of the image.
+ */
+static void MJExtrudeEdges(uint32_t *pixels, GLuint width, GLuint height, GLuint padding)
+{
+    GLuint stride = width + 2 * padding;
+    for (GLuint y = padding; y < padding + height; y++) {
+        uint32_t *row = pixels + y * stride;
+        for (GLuint x = 0; x < padding; x++) {
+            row[x] = row[padding];
+            row[padding + width + x] = row[padding + width - 1];
+        }
+    }
+    for (GLuint y = 0; y < padding; y++) {
+        memcpy(pixels + y * stride, pixels + padding * stride, stride * sizeof(uint32_t));
+        memcpy(pixels + (padding + height + y) * stride,
+               pixels + (padding + height - 1) * stride, stride * sizeof(uint32_t));
+    }
+}
+
+/**
+ * Converts an RGBA8 buffer from premultiplied to straight alpha, which is
+ * what textures loaded with GLKTextureLoader use. The division is done in
+ * float and rounded once, so that dark colors at low alpha keep what
+ * precision the premultiplied values have.
+ */
+static void MJUnpremultiplyAlpha(uint32_t *pixels, size_t pixelCount)
+{
+    uint8_t *bytes = (uint8_t *)pixels;
+    for (size_t i = 0; i < pixelCount; i++, bytes += 4) {
+        uint8_t alpha = bytes[3];
+        if (alpha == 0 || alpha == 255) {
+            continue;
+        }
+        float scale = 255.0f / alpha;
+        for (int c = 0; c < 3; c++) {
+            float value = bytes[c] * scale + 0.5f;
+            bytes[c] = (uint8_t)MIN(value, 255.0f);
+        }
+    }
+}
+
+/**
+ * Copies the pixels of an image that already is RGBA8 with straight
+ * alpha, e.g. most PNGs, into the middle of a padded buffer. Drawing such
+ * an image would premultiply it, and the round trip loses most of the
+ * color of pixels with low alpha.
+ *
+ * @return NO if the image is in another format and has to be drawn.
+ */
+static BOOL MJCopyStraightAlphaPixels(CGImageRef image, uint32_t *pixels, GLuint padding)
+{
+    CGBitmapInfo byteOrder = CGImageGetBitmapInfo(image) & kCGBitmapByteOrderMask;
+    if (CGImageGetAlphaInfo(image) != kCGImageAlphaLast ||
+        CGImageGetBitsPerComponent(image) != 8 ||
+        CGImageGetBitsPerPixel(image) != 32 ||
+        (byteOrder != kCGBitmapByteOrderDefault && byteOrder != kCGBitmapByteOrder32Big) ||
+        CGColorSpaceGetModel(CGImageGetColorSpace(image)) != kCGColorSpaceModelRGB) {
+        return NO;
+    }
+    
+    CFDataRef data = CGDataProviderCopyData(CGImageGetDataProvider(image));
+    if (data == NULL) {
+        return NO;
+    }
+    size_t width = CGImageGetWidth(image);
+    size_t height = CGImageGetHeight(image);
+    size_t bytesPerRow = CGImageGetBytesPerRow(image);
+    size_t stride = width + 2 * padding;
+    const uint8_t *source = CFDataGetBytePtr(data);
+    for (size_t y = 0; y < height; y++) {
+        memcpy(pixels + (padding + y) * stride + padding, source + y * bytesPerRow,
+               width * sizeof(uint32_t));
+    }
+    CFRelease(data);
+    return YES;
+}
+
+@implementation MJTextureAtlas {
+    MJAtlasPage *_pages;
+    
+    // Regions as NSValue objects, by image name.
+    NSMutableDictionary *_regions;
+}
+
+- (id)initWithPageSize:(GLuint)pageSize
+               padding:(GLuint)padding
+             mipmapped:(BOOL)mipmapped
+{
+    self = [super init];
+    if (self) {
+        _pageSize = pageSize;
+        _padding = padding;
+        _mipmapped = mipmapped;
+        _regions = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _pageCount; i++) {
+        glDeleteTextures(1, &_pages[i].texture);
+        [[MJGLStateCache currentStateCache] didDeleteTexture:_pages[i].texture];
+        free(_pages[i].nodes);
+    }
+    free(_pages);
+}
+
+- (NSUInteger)imageCount
+{
+    return _regions.count;
+}
+
+#pragma mark - Adding images
+
+- (BOOL)getRegion:(MJTextureAtlasRegion *)region
+         forImage:(NSString *)imageName
+{
+    NSValue *value = _regions[imageName];
+    if (value) {
+        [value getValue:region];
+        return YES;
+    }
+    
+    NSURL *url = [[NSBundle mainBundle] URLForResource:imageName withExtension:@"png"];
+    CGImageSourceRef source = url ? CGImageSourceCreateWithURL((__bridge CFURLRef)url, NULL) : NULL;
+    CGImageRef image = source ? CGImageSourceCreateImageAtIndex(source, 0, NULL) : NULL;
+    if (source) {
+        CFRelease(source);
+    }
+    if (image == NULL) {
+        NSLog(@"ERROR: Could not load image '%@'.", imageName);
+        return NO;
+    }
+    
+    BOOL added = [self addImage:image withName:imageName region:region];
+    CGImageRelease(image);
+    return added;
+}
+
+- (BOOL)addImage:(CGImageRef)image
+        withName:(NSString *)imageName
+          region:(MJTextureAtlasRegion *)region
+{
+    GLuint width = (GLuint)CGImageGetWidth(image);
+    GLuint height = (GLuint)CGImageGetHeight(image);
+    GLuint paddedWidth = width + 2 * _padding;
+    GLuint paddedHeight = height + 2 * _padding;
+    
+    if (paddedWidth > _pageSize || paddedHeight > _pageSize) {
+        NSLog(@"WARNING: Image '%@' is too large for the texture atlas.", imageName);
+        return NO;
+    }
+    
+    GLuint x = 0;
+    GLuint y = 0;
+    NSUInteger pageIndex = 0;
+    while (pageIndex < _pageCount &&
+           !MJSkylineInsert(&_pages[pageIndex], _pageSize, paddedWidth, paddedHeight, &x, &y)) {
+        pageIndex++;
+    }
+    if (pageIndex == _pageCount) {
+        [self addPage];
+        MJSkylineInsert(&_pages[pageIndex], _pageSize, paddedWidth, paddedHeight, &x, &y);
+    }
+    MJAtlasPage *page = &_pages[pageIndex];
+    
+    // Put the image into the middle of a padded RGBA8 buffer, top row first
+    // like GLKTextureLoader, and extrude its edges into the padding. Images
+    // in other formats than straight RGBA8 are drawn, and Core Graphics
+    // only draws into premultiplied contexts, so unless the image has no
+    // alpha, the alpha is unpremultiplied before upload.
+    uint32_t *pixels = calloc((size_t)paddedWidth * paddedHeight, sizeof(uint32_t));
+    if (!MJCopyStraightAlphaPixels(image, pixels, _padding)) {
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGContextRef context = CGBitmapContextCreate(pixels, paddedWidth, paddedHeight, 8,
+                                                     paddedWidth * sizeof(uint32_t), colorSpace,
+                                                     kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+        CGColorSpaceRelease(colorSpace);
+        CGContextSetBlendMode(context, kCGBlendModeCopy);
+        CGContextDrawImage(context, CGRectMake(_padding, _padding, width, height), image);
+        CGContextRelease(context);
+        
+        CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(image);
+        if (alphaInfo != kCGImageAlphaNone &&
+            alphaInfo != kCGImageAlphaNoneSkipLast &&
+            alphaInfo != kCGImageAlphaNoneSkipFirst) {
+            MJUnpremultiplyAlpha(pixels, (size_t)paddedWidth * paddedHeight);
+        }
+    }
+    MJExtrudeEdges(pixels, width, height, _padding);
+    
+    [[MJGLStateCache currentStateCache] bindTexture:page->texture target:GL_TEXTURE_2D unit:0];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, paddedWidth, paddedHeight,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    free(pixels);
+    page->dirty = YES;
+    
+    MJTextureAtlasRegion newRegion;
+    newRegion.texture = page->texture;
+    newRegion.textureRect = GLKVector4Make((float)(x + _padding) / _pageSize,
+                                           (float)(y + _padding) / _pageSize,
+                                           (float)(x + _padding + width) / _pageSize,
+                                           (float)(y + _padding + height) / _pageSize);
+    newRegion.size = GLKVector2Make(width, height);
+    _regions[imageName] = [NSValue valueWithBytes:&newRegion objCType:@encode(MJTextureAtlasRegion)];
+    
+    if (region) {
+        *region = newRegion;
+    }
+    return YES;
+}
+
+- (void)addPage
+{
+    _pages = realloc(_pages, (_pageCount + 1) * sizeof(MJAtlasPage));
+    MJAtlasPage *page = &_pages[_pageCount];
+    _pageCount++;
+    
+    // Every node covers at least one column, so there is never more than
+    // one node per column, plus the one briefly added by an insert.
+    page->nodes = malloc((_pageSize + 1) * sizeof(MJSkylineNode));
+    page->nodes[0] = (MJSkylineNode){ 0, 0, _pageSize };
+    page->nodeCount = 1;
+    page->dirty = NO;
+    
+    glGenTextures(1, &page->texture);
+    [[MJGLStateCache currentStateCache] bindTexture:page->texture target:GL_TEXTURE_2D unit:0];
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _pageSize, _pageSize, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+#pragma mark - Updating mipmaps
+
+- (void)updateMipmaps
+{
+    if (!_mipmapped) {
+        return;
+    }
+    for (NSUInteger i = 0; i < _pageCount; i++) {
+        if (_pages[i].dirty) {
+            [[MJGLStateCache currentStateCache] bindTexture:_pages[i].texture target:GL_TEXTURE_2D unit:0];
+            glGenerateMipmap(GL_TEXTURE_2D);
+            _pages[i].dirty = NO;
+        }
+    }
+}
+
+@end
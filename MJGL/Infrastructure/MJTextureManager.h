@@ -24,6 +24,18 @@
 
 #import <Foundation/Foundation.h>
 #import <GLKit/GLKit.h>
+#import "MJGLContext.h"
+#import "MJCompressedTexture.h"
+
+extern NSString * const MJTextureManagerErrorDomain;
+
+/**
+ * Block called when an asynchronous texture load has finished.
+ *
+ * @param texture The loaded texture, or nil if it could not be loaded.
+ * @param error Error object if the texture could not be loaded.
+ */
+typedef void (^MJTextureLoadCompletion)(GLKTextureInfo *texture, NSError *error);
 
 /**
  * Super simple texture manager. Its only purpose is to cache loaded
@@ -35,12 +47,98 @@
  * Loads a texture from the main bundle or returns a cached
  * texture if the texture has been loaded by this instance of the
  * texture manager before.
+ *
+ * Each load retains the texture, so that it is never evicted while in
+ * use. Balance it with releaseTexture: when the texture is no longer used.
  */
 - (GLKTextureInfo *)loadTexture:(NSString *)textureName;
 
 /**
- * Removes a texture from the cache. Note that the texture object will
- * not be deallocated if other objects strongly refer to it.
+ * Loads a compressed texture from a KTX2 (.ktx2) or KTX (.ktx) file in
+ * the main bundle, or returns a cached texture if the texture has been
+ * loaded by this instance of the texture manager before.
+ *
+ * Like loadTexture:, each load retains the texture. Balance it with
+ * releaseCompressedTexture:.
+ *
+ * @param textureName Name of the texture in the main bundle, without
+ *                    extension.
+ * @return The texture, or nil if it could not be loaded or its format is
+ *         not supported by the current context.
+ */
+- (MJCompressedTexture *)loadCompressedTexture:(NSString *)textureName;
+
+/**
+ * Loads a texture from the main bundle without blocking the calling
+ * thread. If the texture has been loaded before, the completion block
+ * is called immediately with the cached texture and nil is returned.
+ *
+ * The file is read on a pool of worker threads, then decoded and uploaded
+ * on a background context that shares objects with the rendering context.
+ * Concurrent requests for the same texture share a single load.
+ *
+ * The texture is retained for each request whose completion block is
+ * called, like loadTexture: does. Cancelled requests retain nothing.
+ *
+ * @param textureName Name of the texture in the main bundle.
+ * @param completion Block called by dispatchCompletedLoads when the texture
+ *                   has been loaded.
+ * @return Token identifying the request, used to cancel it.
+ */
+- (id)loadTextureAsync:(NSString *)textureName
+            completion:(MJTextureLoadCompletion)completion;
+
+/**
+ * Cancels an asynchronous texture load request, so that its completion
+ * block is never called. The load itself is abandoned if no other
+ * requests are waiting for it.
+ *
+ * @param request The token returned by loadTextureAsync:completion:.
+ */
+- (void)cancelTextureLoad:(id)request;
+
+/**
+ * Calls the completion blocks of asynchronous loads that have finished
+ * and whose textures are ready for use by the rendering context. Call it
+ * once per frame on the rendering thread.
+ */
+- (void)dispatchCompletedLoads;
+
+/**
+ * Retains a cached texture, so that it is not evicted until it has been
+ * released as many times as it has been retained or loaded.
+ */
+- (void)retainTexture:(NSString *)textureName;
+
+/**
+ * Releases a texture retained by loadTexture:, loadTextureAsync:completion:
+ * or retainTexture:. A texture that is no longer retained stays cached,
+ * but may be evicted when the memory budget is exceeded, after which its
+ * OpenGL name must not be used anymore.
+ */
+- (void)releaseTexture:(NSString *)textureName;
+
+/**
+ * Releases a compressed texture retained by loadCompressedTexture:.
+ */
+- (void)releaseCompressedTexture:(NSString *)textureName;
+
+/**
+ * Marks a cached texture as used in the current frame, so that it will
+ * not be evicted before less recently used textures once it is no longer
+ * retained. Loading a texture through the manager also marks it as used.
+ */
+- (void)markTextureAsUsed:(NSString *)textureName;
+
+/**
+ * Ends the current frame and evicts textures if the memory budget
+ * is exceeded. Call it once per frame on the rendering thread.
+ */
+- (void)finishFrame;
+
+/**
+ * Removes a texture, and a compressed texture of the same name, from the
+ * cache and deletes them, whether they are retained or not.
  */
 - (void)removeTextureWithName:(NSString *)textureName;
 
@@ -51,4 +149,50 @@
  */
 @interface MJTextureManager : NSObject <MJTextureManager>
 
+/**
+ * Initialize a texture manager that loads textures asynchronously on a
+ * background context sharing objects with the rendering context.
+ *
+ * @param context The rendering context.
+ */
+- (id)initWithContext:(id<MJGLContext>)context;
+
+/**
+ * The estimated amount of GPU memory, in bytes, that the cached textures
+ * may occupy. When it is exceeded, the least recently used textures that
+ * are no longer retained are evicted. Textures used in the current frame
+ * are never evicted. Zero, the default, means no limit.
+ *
+ * Objects that only hold the OpenGL name of a texture, like MJSpriteBatch,
+ * render packets and texture atlas regions, do not keep it alive, so keep
+ * the texture retained while they draw with it.
+ */
+@property (nonatomic, assign) NSUInteger memoryBudget;
+
+/** The estimated amount of GPU memory, in bytes, used by cached textures. */
+@property (nonatomic, assign, readonly) NSUInteger residentBytes;
+
+/** Number of texture loads that were served from the cache. */
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+
+/** Number of texture loads that had to load the texture. */
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+
+/** Number of textures evicted to stay within the memory budget. */
+@property (nonatomic, assign, readonly) NSUInteger evictionCount;
+
+/**
+ * Estimates the GPU memory occupied by a texture, including its mipmaps.
+ *
+ * @param width Width of the base level in pixels.
+ * @param height Height of the base level in pixels.
+ * @param bytesPerPixel Bytes per pixel of the texture format.
+ * @param mipmapped YES if the texture has a full mipmap chain.
+ * @return Estimated size in bytes.
+ */
++ (NSUInteger)estimatedByteSizeWithWidth:(GLuint)width
+                                  height:(GLuint)height
+                           bytesPerPixel:(GLuint)bytesPerPixel
+                               mipmapped:(BOOL)mipmapped;
+
 @end
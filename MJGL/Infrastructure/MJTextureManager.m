@@ -23,33 +23,499 @@
 //
 
 #import "MJTextureManager.h"
+#import "MJGLStateCache.h"
+#import "MJCompressedTexture.h"
+
+NSString * const MJTextureManagerErrorDomain = @"MJTextureManagerErrorDomain";
+
+@class MJTextureLoad;
+
+/** A request for an asynchronous load, as handed out to the caller. */
+@interface MJTextureLoadRequest : NSObject
+@property (nonatomic, weak) MJTextureLoad *load;
+@property (nonatomic, copy) MJTextureLoadCompletion completion;
+@end
+
+@implementation MJTextureLoadRequest
+@end
+
+/** An asynchronous load, shared by all requests for the same texture. */
+@interface MJTextureLoad : NSObject
+@property (nonatomic, copy) NSString *textureName;
+@property (nonatomic, strong) NSMutableArray *requests;
+@property (atomic, assign, getter = isCancelled) BOOL cancelled;
+@property (nonatomic, strong) GLKTextureInfo *texture;
+@property (nonatomic, strong) NSError *error;
+@property (nonatomic, assign) GLsync fence;
+@end
+
+@implementation MJTextureLoad
+@end
+
+/** A cached texture and its bookkeeping for the memory budget. */
+@interface MJTextureEntry : NSObject
+@property (nonatomic, strong) id texture;
+@property (nonatomic, assign) GLuint glName;
+@property (nonatomic, assign) NSUInteger byteSize;
+@property (nonatomic, assign) NSUInteger lastUsedFrame;
+@property (nonatomic, assign) NSUInteger referenceCount;
+@end
+
+@implementation MJTextureEntry
+@end
 
 @implementation MJTextureManager {
+    // Cached textures as MJTextureEntry objects, by texture name.
     NSMutableDictionary *_textures;
+    NSUInteger _frame;
+    
+    id<MJGLContext> _backgroundContext;
+    dispatch_queue_t _readQueue;
+    dispatch_queue_t _uploadQueue;
+    
+    // Loads in flight, by texture name. Only accessed on the rendering thread.
+    NSMutableDictionary *_loads;
+    
+    // Loads handed over from the upload queue, guarded by @synchronized.
+    NSMutableArray *_completedLoads;
+    
+    // Uploaded loads waiting for their fences. Only accessed on the rendering thread.
+    NSMutableArray *_pendingLoads;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _textures = [NSMutableDictionary dictionary];
+        _loads = [NSMutableDictionary dictionary];
+        _completedLoads = [NSMutableArray array];
+        _pendingLoads = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (id)initWithContext:(id<MJGLContext>)context
+{
+    self = [self init];
+    if (self) {
+        _backgroundContext = [[MJGLContext alloc] initWithSharegroupOfContext:context];
+        if (_backgroundContext) {
+            _readQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+            _uploadQueue = dispatch_queue_create("MJTextureManager.upload", DISPATCH_QUEUE_SERIAL);
+        } else {
+            NSLog(@"WARNING: Could not create a shared context, textures will be loaded synchronously.");
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (MJTextureLoad *load in _pendingLoads) {
+        glDeleteSyncMJ(load.fence);
+    }
+    // Loads that were uploaded but never dispatched own fences as well.
+    @synchronized(_completedLoads) {
+        for (MJTextureLoad *load in _completedLoads) {
+            if (load.fence) {
+                glDeleteSyncMJ(load.fence);
+            }
+        }
+    }
 }
 
 - (GLKTextureInfo *)loadTexture:(NSString *)textureName {
     NSError *error = nil;
-    GLKTextureInfo *texture = _textures[textureName];
+    GLKTextureInfo *texture = [self cachedTextureWithName:textureName];
     if (texture) {
+        [self retainTexture:textureName];
         return texture;
     }
+    _missCount++;
     NSString *path = [[NSBundle mainBundle] pathForResource:textureName ofType:@"png"];
     texture = [GLKTextureLoader textureWithContentsOfFile:path options:@{GLKTextureLoaderGenerateMipmaps: @YES} error:&error];
+    
+    // GLKTextureLoader binds textures behind the back of the state cache.
+    [[MJGLStateCache currentStateCache] invalidate];
     if (error) {
         NSLog(@"ERROR: %@", error.localizedDescription);
     } else {
-        _textures[textureName] = texture;
+        [self cacheTexture:texture withName:textureName];
+        [self retainTexture:textureName];
     }
     return texture;
 }
 
-- (void)removeTextureWithName:(NSString *)textureName {
-    GLKTextureInfo *texture = _textures[textureName];
-    GLuint name = texture.name;
+- (MJCompressedTexture *)loadCompressedTexture:(NSString *)textureName
+{
+    NSString *key = [self keyForCompressedTextureName:textureName];
+    MJCompressedTexture *texture = [self cachedTextureWithName:key];
     if (texture) {
-        glDeleteTextures(1, &name);
+        [self retainTextureForKey:key];
+        return texture;
+    }
+    _missCount++;
+    
+    NSURL *url = [[NSBundle mainBundle] URLForResource:textureName withExtension:@"ktx2"];
+    if (url == nil) {
+        url = [[NSBundle mainBundle] URLForResource:textureName withExtension:@"ktx"];
+    }
+    if (url == nil) {
+        NSLog(@"ERROR: %@", [self errorForTextureName:textureName].localizedDescription);
+        return nil;
+    }
+    
+    NSError *error = nil;
+    texture = [MJCompressedTexture textureWithContentsOfURL:url error:&error];
+    if (error) {
+        NSLog(@"ERROR: %@", error.localizedDescription);
+    } else {
+        [self cacheTexture:texture glName:texture.name byteSize:texture.byteSize forKey:key];
+        [self retainTextureForKey:key];
+    }
+    return texture;
+}
+
+#pragma mark - Asynchronous loading
+
+- (id)loadTextureAsync:(NSString *)textureName
+            completion:(MJTextureLoadCompletion)completion
+{
+    GLKTextureInfo *texture = [self cachedTextureWithName:textureName];
+    if (texture || _backgroundContext == nil) {
+        if (texture) {
+            [self retainTexture:textureName];
+        } else {
+            texture = [self loadTexture:textureName];
+        }
+        if (completion) {
+            completion(texture, texture ? nil : [self errorForTextureName:textureName]);
+        }
+        return nil;
+    }
+    
+    MJTextureLoad *load = _loads[textureName];
+    if (load == nil) {
+        load = [[MJTextureLoad alloc] init];
+        load.textureName = textureName;
+        load.requests = [NSMutableArray array];
+        _loads[textureName] = load;
+        _missCount++;
+        [self startLoad:load];
+    }
+    
+    MJTextureLoadRequest *request = [[MJTextureLoadRequest alloc] init];
+    request.load = load;
+    request.completion = completion;
+    [load.requests addObject:request];
+    return request;
+}
+
+- (void)cancelTextureLoad:(id)request
+{
+    MJTextureLoadRequest *loadRequest = request;
+    MJTextureLoad *load = loadRequest.load;
+    if (load == nil) {
+        return;
+    }
+    loadRequest.load = nil;
+    [load.requests removeObjectIdenticalTo:loadRequest];
+    
+    if (load.requests.count == 0) {
+        // Nobody is waiting for the texture, so the workers may skip
+        // whatever is left of the load.
+        load.cancelled = YES;
+        [_loads removeObjectForKey:load.textureName];
+    }
+}
+
+- (void)dispatchCompletedLoads
+{
+    @synchronized(_completedLoads) {
+        if (_completedLoads.count > 0) {
+            [_pendingLoads addObjectsFromArray:_completedLoads];
+            [_completedLoads removeAllObjects];
+        }
+    }
+    
+    NSUInteger i = 0;
+    while (i < _pendingLoads.count) {
+        MJTextureLoad *load = _pendingLoads[i];
+        
+        if (load.fence) {
+            // Poll only, the texture will be picked up next frame if the
+            // upload has not finished yet.
+            GLenum status = glClientWaitSyncMJ(load.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                i++;
+                continue;
+            }
+            glDeleteSyncMJ(load.fence);
+            load.fence = NULL;
+        }
+        
+        [_pendingLoads removeObjectAtIndex:i];
+        if (_loads[load.textureName] == load) {
+            [_loads removeObjectForKey:load.textureName];
+        }
+        
+        if (load.cancelled) {
+            GLuint name = load.texture.name;
+            if (name) {
+                glDeleteTextures(1, &name);
+                [[MJGLStateCache currentStateCache] didDeleteTexture:name];
+            }
+            continue;
+        }
+        
+        MJTextureEntry *entry = _textures[load.textureName];
+        if (entry && load.texture) {
+            // Loaded synchronously while the load was in flight.
+            GLuint name = load.texture.name;
+            glDeleteTextures(1, &name);
+            [[MJGLStateCache currentStateCache] didDeleteTexture:name];
+            load.texture = entry.texture;
+            entry.lastUsedFrame = _frame;
+        } else if (load.texture) {
+            [self cacheTexture:load.texture withName:load.textureName];
+        } else {
+            NSLog(@"ERROR: %@", load.error.localizedDescription);
+        }
+        
+        for (MJTextureLoadRequest *request in load.requests) {
+            request.load = nil;
+            if (load.texture) {
+                [self retainTexture:load.textureName];
+            }
+            if (request.completion) {
+                request.completion(load.texture, load.error);
+            }
+        }
+        [load.requests removeAllObjects];
+    }
+}
+
+- (void)startLoad:(MJTextureLoad *)load
+{
+    NSURL *url = [[NSBundle mainBundle] URLForResource:load.textureName withExtension:@"png"];
+    
+    // Only the file is read on the workers. GLKTextureLoader decodes the
+    // image itself, so decoding it here too would do the work twice.
+    dispatch_async(_readQueue, ^{
+        NSData *data = nil;
+        if (!load.cancelled && url) {
+            data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:NULL];
+        }
+        
+        dispatch_async(_uploadQueue, ^{
+            if (!load.cancelled) {
+                if (data) {
+                    [self uploadImageData:data forLoad:load];
+                } else {
+                    load.error = [self errorForTextureName:load.textureName];
+                }
+            }
+            
+            @synchronized(_completedLoads) {
+                [_completedLoads addObject:load];
+            }
+        });
+    });
+}
+
+- (void)uploadImageData:(NSData *)data forLoad:(MJTextureLoad *)load
+{
+    [_backgroundContext makeCurrent];
+    
+    NSError *error = nil;
+    load.texture = [GLKTextureLoader textureWithContentsOfData:data
+                                                       options:@{GLKTextureLoaderGenerateMipmaps: @YES}
+                                                         error:&error];
+    load.error = error;
+    [[MJGLStateCache currentStateCache] invalidate];
+    
+    if (load.texture) {
+        // The rendering context must not use the texture before the
+        // upload has been executed by the GPU.
+        load.fence = glFenceSyncMJ(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+    }
+}
+
+- (NSError *)errorForTextureName:(NSString *)textureName
+{
+    NSString *description = [NSString stringWithFormat:@"Could not load texture '%@'.", textureName];
+    return [NSError errorWithDomain:(NSString *)MJTextureManagerErrorDomain
+                               code:0
+                           userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+#pragma mark - Caching textures
+
+- (id)cachedTextureWithName:(NSString *)textureName
+{
+    MJTextureEntry *entry = _textures[textureName];
+    if (entry == nil) {
+        return nil;
+    }
+    entry.lastUsedFrame = _frame;
+    _hitCount++;
+    return entry.texture;
+}
+
+- (void)cacheTexture:(GLKTextureInfo *)texture withName:(NSString *)textureName
+{
+    // GLKTextureLoader uploads RGBA8 for all formats we load through it.
+    NSUInteger byteSize = [MJTextureManager estimatedByteSizeWithWidth:texture.width
+                                                                height:texture.height
+                                                         bytesPerPixel:4
+                                                             mipmapped:texture.containsMipmaps];
+    if (texture.target == GL_TEXTURE_CUBE_MAP) {
+        byteSize *= 6;
+    }
+    [self cacheTexture:texture glName:texture.name byteSize:byteSize forKey:textureName];
+}
+
+- (void)cacheTexture:(id)texture glName:(GLuint)glName byteSize:(NSUInteger)byteSize forKey:(NSString *)key
+{
+    MJTextureEntry *entry = [[MJTextureEntry alloc] init];
+    entry.texture = texture;
+    entry.glName = glName;
+    entry.byteSize = byteSize;
+    entry.lastUsedFrame = _frame;
+    _textures[key] = entry;
+    _residentBytes += byteSize;
+    
+    [self evictTexturesIfNeeded];
+}
+
+/** Compressed textures are cached apart from the PNG textures of the same name. */
+- (NSString *)keyForCompressedTextureName:(NSString *)textureName
+{
+    return [textureName stringByAppendingPathExtension:@"ktx"];
+}
+
+- (void)retainTexture:(NSString *)textureName
+{
+    [self retainTextureForKey:textureName];
+}
+
+- (void)releaseTexture:(NSString *)textureName
+{
+    [self releaseTextureForKey:textureName];
+}
+
+- (void)releaseCompressedTexture:(NSString *)textureName
+{
+    [self releaseTextureForKey:[self keyForCompressedTextureName:textureName]];
+}
+
+- (void)retainTextureForKey:(NSString *)key
+{
+    MJTextureEntry *entry = _textures[key];
+    entry.referenceCount++;
+}
+
+- (void)releaseTextureForKey:(NSString *)key
+{
+    MJTextureEntry *entry = _textures[key];
+    if (entry == nil || entry.referenceCount == 0) {
+        NSLog(@"WARNING: Texture '%@' released more times than it was retained.", key);
+        return;
+    }
+    entry.referenceCount--;
+}
+
+- (void)markTextureAsUsed:(NSString *)textureName
+{
+    MJTextureEntry *entry = _textures[textureName];
+    entry.lastUsedFrame = _frame;
+    
+    MJTextureEntry *compressedEntry = _textures[[self keyForCompressedTextureName:textureName]];
+    compressedEntry.lastUsedFrame = _frame;
+}
+
+- (void)finishFrame
+{
+    [self evictTexturesIfNeeded];
+    _frame++;
+}
+
++ (NSUInteger)estimatedByteSizeWithWidth:(GLuint)width
+                                  height:(GLuint)height
+                           bytesPerPixel:(GLuint)bytesPerPixel
+                               mipmapped:(BOOL)mipmapped
+{
+    NSUInteger size = (NSUInteger)width * height * bytesPerPixel;
+    while (mipmapped && (width > 1 || height > 1)) {
+        width = MAX(width / 2, 1);
+        height = MAX(height / 2, 1);
+        size += (NSUInteger)width * height * bytesPerPixel;
+    }
+    return size;
+}
+
+#pragma mark - Evicting textures
+
+- (void)evictTexturesIfNeeded
+{
+    if (_memoryBudget == 0 || _residentBytes <= _memoryBudget) {
+        return;
+    }
+    
+    NSArray *names = [_textures keysSortedByValueUsingComparator:^NSComparisonResult(MJTextureEntry *a, MJTextureEntry *b) {
+        if (a.lastUsedFrame < b.lastUsedFrame) {
+            return NSOrderedAscending;
+        } else if (a.lastUsedFrame > b.lastUsedFrame) {
+            return NSOrderedDescending;
+        }
+        return NSOrderedSame;
+    }];
+    
+    for (NSString *textureName in names) {
+        if (_residentBytes <= _memoryBudget) {
+            break;
+        }
+        MJTextureEntry *entry = _textures[textureName];
+        if (entry.lastUsedFrame == _frame) {
+            // Everything from here on has been used in this frame.
+            break;
+        }
+        if (entry.referenceCount > 0) {
+            // Still in use, possibly by objects that only hold its name.
+            continue;
+        }
+        [self evictEntry:entry];
         [_textures removeObjectForKey:textureName];
+        _evictionCount++;
+    }
+}
+
+- (void)evictEntry:(MJTextureEntry *)entry
+{
+    GLuint name = entry.glName;
+    glDeleteTextures(1, &name);
+    [[MJGLStateCache currentStateCache] didDeleteTexture:name];
+    _residentBytes -= entry.byteSize;
+}
+
+#pragma mark - Removing textures
+
+- (void)removeTextureWithName:(NSString *)textureName {
+    [self removeTextureForKey:textureName];
+    [self removeTextureForKey:[self keyForCompressedTextureName:textureName]];
+}
+
+- (void)removeTextureForKey:(NSString *)key
+{
+    MJTextureEntry *entry = _textures[key];
+    GLuint name = entry.glName;
+    if (entry) {
+        glDeleteTextures(1, &name);
+        [[MJGLStateCache currentStateCache] didDeleteTexture:name];
+        _residentBytes -= entry.byteSize;
+        [_textures removeObjectForKey:key];
     }
 }
 
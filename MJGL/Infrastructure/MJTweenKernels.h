@@ -0,0 +1,60 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Advance a set of tweens, stored as a structure of arrays, and evaluate
+ * their easing curves.
+ *
+ * The phase of a tween is its animation time divided by its duration, so
+ * it runs from 0 to 1, and is negative while the tween is delayed. The
+ * curve of a tween is expressed by three coefficients,
+ *
+ *     curve(t) = linear * t + quadratic * t^2 + sine * sin^2(pi * t / 2),
+ *
+ * which covers the built-in curves: linear (1, 0, 0), ease in (0, 1, 0),
+ * ease out (2, -1, 0) and ease in-out (0, 0, 1). The sine term is
+ * evaluated with a polynomial, so the whole kernel runs in SSE or NEON
+ * registers, four tweens at a time.
+ *
+ * @param phases The phases of the tweens, advanced in place.
+ * @param rates The reciprocals of the durations of the tweens.
+ * @param linear The linear coefficients of the curves.
+ * @param quadratic The quadratic coefficients of the curves.
+ * @param sine The sine squared coefficients of the curves.
+ * @param elapsedTime Time to advance the tweens by.
+ * @param progress Set to the curve values, clamped to [0, 1] and exactly 1
+ *                 for tweens that have finished.
+ * @param count The number of tweens.
+ */
+void MJTweenAdvance(float *phases,
+                    const float *rates,
+                    const float *linear,
+                    const float *quadratic,
+                    const float *sine,
+                    float elapsedTime,
+                    float *progress,
+                    size_t count);
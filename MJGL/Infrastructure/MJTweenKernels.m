@@ -0,0 +1,123 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import "MJTweenKernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Taylor coefficients of sin(x), accurate to about 1e-6 on [-pi/2, pi/2].
+#define kMJSineC3 (-1.0f / 6.0f)
+#define kMJSineC5 (1.0f / 120.0f)
+#define kMJSineC7 (-1.0f / 5040.0f)
+#define kMJSineC9 (1.0f / 362880.0f)
+
+/** sin^2(pi * t / 2), written as 0.5 + 0.5 * sin(pi * (t - 0.5)). */
+static inline float MJSineSquaredHalfPi(float t)
+{
+    float x = (float)M_PI * (t - 0.5f);
+    float x2 = x * x;
+    float s = x * (1.0f + x2 * (kMJSineC3 + x2 * (kMJSineC5 + x2 * (kMJSineC7 + x2 * kMJSineC9))));
+    return 0.5f + 0.5f * s;
+}
+
+void MJTweenAdvance(float *phases,
+                    const float *rates,
+                    const float *linear,
+                    const float *quadratic,
+                    const float *sine,
+                    float elapsedTime,
+                    float *progress,
+                    size_t count)
+{
+    size_t i = 0;
+    
+#if defined(__SSE2__)
+    const __m128 elapsed = _mm_set1_ps(elapsedTime);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 pi = _mm_set1_ps((float)M_PI);
+    for (; i + 4 <= count; i += 4) {
+        __m128 phase = _mm_add_ps(_mm_loadu_ps(phases + i),
+                                  _mm_mul_ps(elapsed, _mm_loadu_ps(rates + i)));
+        _mm_storeu_ps(phases + i, phase);
+        
+        __m128 t = _mm_min_ps(_mm_max_ps(phase, zero), one);
+        __m128 x = _mm_mul_ps(pi, _mm_sub_ps(t, half));
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 s = _mm_add_ps(_mm_set1_ps(kMJSineC7), _mm_mul_ps(x2, _mm_set1_ps(kMJSineC9)));
+        s = _mm_add_ps(_mm_set1_ps(kMJSineC5), _mm_mul_ps(x2, s));
+        s = _mm_add_ps(_mm_set1_ps(kMJSineC3), _mm_mul_ps(x2, s));
+        s = _mm_mul_ps(x, _mm_add_ps(one, _mm_mul_ps(x2, s)));
+        s = _mm_add_ps(half, _mm_mul_ps(half, s));
+        
+        __m128 value = _mm_mul_ps(t, _mm_add_ps(_mm_loadu_ps(linear + i),
+                                                _mm_mul_ps(_mm_loadu_ps(quadratic + i), t)));
+        value = _mm_add_ps(value, _mm_mul_ps(_mm_loadu_ps(sine + i), s));
+        
+        __m128 finished = _mm_cmpge_ps(phase, one);
+        value = _mm_or_ps(_mm_and_ps(finished, one), _mm_andnot_ps(finished, value));
+        _mm_storeu_ps(progress + i, value);
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t phase = vmlaq_n_f32(vld1q_f32(phases + i), vld1q_f32(rates + i), elapsedTime);
+        vst1q_f32(phases + i, phase);
+        
+        float32x4_t t = vminq_f32(vmaxq_f32(phase, zero), one);
+        float32x4_t x = vmulq_n_f32(vsubq_f32(t, half), (float)M_PI);
+        float32x4_t x2 = vmulq_f32(x, x);
+        float32x4_t s = vmlaq_n_f32(vdupq_n_f32(kMJSineC7), x2, kMJSineC9);
+        s = vmlaq_f32(vdupq_n_f32(kMJSineC5), x2, s);
+        s = vmlaq_f32(vdupq_n_f32(kMJSineC3), x2, s);
+        s = vmulq_f32(x, vmlaq_f32(one, x2, s));
+        s = vmlaq_f32(half, half, s);
+        
+        float32x4_t value = vmulq_f32(t, vmlaq_f32(vld1q_f32(linear + i), vld1q_f32(quadratic + i), t));
+        value = vmlaq_f32(value, vld1q_f32(sine + i), s);
+        
+        uint32x4_t finished = vcgeq_f32(phase, one);
+        vst1q_f32(progress + i, vbslq_f32(finished, one, value));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        float phase = phases[i] + elapsedTime * rates[i];
+        phases[i] = phase;
+        if (phase >= 1.0f) {
+            progress[i] = 1.0f;
+            continue;
+        }
+        float t = (phase < 0.0f) ? 0.0f : phase;
+        progress[i] = t * (linear[i] + quadratic[i] * t) + sine[i] * MJSineSquaredHalfPi(t);
+    }
+}
@@ -0,0 +1,95 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Converters from floats to the packed vertex formats of
+ * MJVertexDeclaration, to shrink vertex buffers when meshes are built.
+ * Each converter runs four values at a time in SSE or NEON registers.
+ *
+ * Signed normalized values are encoded for the conversion rule of OpenGL
+ * 4.2 and OpenGL ES 3.0, where a value c of b bits reads back as
+ * max(c / (2^(b-1) - 1), -1), so -1, 0 and 1 are exact. The most negative
+ * value of each type is never written.
+ */
+
+/**
+ * Convert floats to IEEE half floats, rounding to nearest even. Values
+ * too large for a half float become infinity, and NaNs stay NaNs.
+ *
+ * @param floats The floats to convert.
+ * @param halfFloats Set to the half floats.
+ * @param count The number of floats.
+ */
+void MJConvertFloatsToHalfFloats(const float *floats,
+                                 uint16_t *halfFloats,
+                                 size_t count);
+
+/**
+ * Pack vectors into the signed normalized GL_INT_2_10_10_10_REV format,
+ * with x, y and z in 10 bits each from the least significant bit up and
+ * w in the top 2 bits. Values are clamped to [-1, 1] and rounded to the
+ * nearest of the 1023 steps of x, y and z, while w is rounded to -1, 0
+ * or 1.
+ *
+ * @param vectors The x, y and z of each vector, e.g. an array of GLKVector3.
+ * @param w The w of each vector, e.g. the handedness of a tangent frame,
+ *          or NULL for 0.
+ * @param packed Set to the packed vectors.
+ * @param count The number of vectors.
+ */
+void MJPackVectors1010102(const float *vectors,
+                          const float *w,
+                          uint32_t *packed,
+                          size_t count);
+
+/**
+ * Encode unit normals with the octahedral mapping into two normalized
+ * shorts each, a third of the size of three floats with an error of
+ * well below a hundredth of a degree. On 32-bit ARM the NEON path uses a
+ * reciprocal estimate, so a short may round one step off the scalar
+ * result. Decode in a shader with
+ *
+ *     vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+ *     float t = max(-n.z, 0.0);
+ *     n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+ *     n = normalize(n);
+ *
+ * @param normals The x, y and z of each normal, e.g. an array of GLKVector3.
+ * @param encoded Set to the two shorts of each normal.
+ * @param count The number of normals.
+ */
+void MJEncodeOctahedralNormals(const float *normals,
+                               int16_t *encoded,
+                               size_t count);
+
+/**
+ * Decode an octahedral normal, the inverse of MJEncodeOctahedralNormals.
+ *
+ * @param encoded The two shorts of the normal.
+ * @param normal Set to the x, y and z of the unit normal.
+ */
+void MJDecodeOctahedralNormal(const int16_t *encoded, float *normal);
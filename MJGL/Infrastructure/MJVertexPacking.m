@@ -0,0 +1,370 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import "MJVertexPacking.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Bit patterns for the float to half float conversion, after the sign has
+// been removed. Values from the half float denormal boundary down are
+// rounded by adding a magic number that shifts them into the mantissa.
+#define kMJFloatInfinity 0x7f800000u
+#define kMJHalfOverflow (((127 + 16) << 23))
+#define kMJHalfMinNormal (113u << 23)
+#define kMJHalfDenormMagic (((127 - 15) + (23 - 10) + 1) << 23)
+#define kMJHalfExponentBias 0xc8000fffu  // ((15 - 127) << 23) + 0xfff
+
+#pragma mark - Scalar conversions
+
+static inline uint16_t MJFloatToHalf(float value)
+{
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    
+    uint32_t half;
+    if (f >= kMJHalfOverflow) {
+        half = f > kMJFloatInfinity ? 0x7e00 : 0x7c00;
+    } else if (f < kMJHalfMinNormal) {
+        uint32_t magic = kMJHalfDenormMagic;
+        float a, b;
+        memcpy(&a, &f, sizeof(a));
+        memcpy(&b, &magic, sizeof(b));
+        a += b;
+        memcpy(&half, &a, sizeof(half));
+        half -= magic;
+    } else {
+        // Add a half minus one, plus one if the result would be odd, to
+        // round to nearest even.
+        uint32_t mantissaOdd = (f >> 13) & 1;
+        half = (f + kMJHalfExponentBias + mantissaOdd) >> 13;
+    }
+    return (uint16_t)(half | (sign >> 16));
+}
+
+/** Clamp to [-1, 1], scale and round half away from zero. */
+static inline int32_t MJFloatToSignedNormalized(float value, float scale)
+{
+    value = fminf(fmaxf(value, -1.0f), 1.0f) * scale;
+    return (int32_t)(value + copysignf(0.5f, value));
+}
+
+static inline uint32_t MJPackVector1010102(const float *vector, float w)
+{
+    return (((uint32_t)MJFloatToSignedNormalized(vector[0], 511.0f) & 0x3ff) |
+            (((uint32_t)MJFloatToSignedNormalized(vector[1], 511.0f) & 0x3ff) << 10) |
+            (((uint32_t)MJFloatToSignedNormalized(vector[2], 511.0f) & 0x3ff) << 20) |
+            (((uint32_t)MJFloatToSignedNormalized(w, 1.0f) & 0x3) << 30));
+}
+
+static inline void MJEncodeOctahedralNormal(const float *normal, int16_t *encoded)
+{
+    float x = normal[0];
+    float y = normal[1];
+    float z = normal[2];
+    float inverseLength = 1.0f / fmaxf(fabsf(x) + fabsf(y) + fabsf(z), 1e-20f);
+    x *= inverseLength;
+    y *= inverseLength;
+    if (z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals of the square.
+        float foldedX = copysignf(1.0f - fabsf(y), x);
+        float foldedY = copysignf(1.0f - fabsf(x), y);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = (int16_t)MJFloatToSignedNormalized(x, 32767.0f);
+    encoded[1] = (int16_t)MJFloatToSignedNormalized(y, 32767.0f);
+}
+
+void MJDecodeOctahedralNormal(const int16_t *encoded, float *normal)
+{
+    float x = fmaxf(encoded[0] / 32767.0f, -1.0f);
+    float y = fmaxf(encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = fmaxf(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float inverseLength = 1.0f / sqrtf(x * x + y * y + z * z);
+    normal[0] = x * inverseLength;
+    normal[1] = y * inverseLength;
+    normal[2] = z * inverseLength;
+}
+
+#pragma mark - SIMD helpers
+
+#if defined(__SSE2__)
+
+static inline __m128i MJSignedNormalized4(__m128 value, __m128 scale)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    value = _mm_mul_ps(value, scale);
+    value = _mm_add_ps(value, _mm_or_ps(half, _mm_and_ps(value, signMask)));
+    return _mm_cvttps_epi32(value);
+}
+
+static inline __m128 MJSelect4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i MJSelectInt4(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+static inline int32x4_t MJSignedNormalized4(float32x4_t value, float32x4_t scale)
+{
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+    value = vminq_f32(vmaxq_f32(value, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+    value = vmulq_f32(value, scale);
+    uint32x4_t half = vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)),
+                                vandq_u32(vreinterpretq_u32_f32(value), signMask));
+    value = vaddq_f32(value, vreinterpretq_f32_u32(half));
+    return vcvtq_s32_f32(value);
+}
+
+#endif
+
+#pragma mark - Batch conversions
+
+void MJConvertFloatsToHalfFloats(const float *floats,
+                                 uint16_t *halfFloats,
+                                 size_t count)
+{
+    size_t i = 0;
+    
+#if defined(__SSE2__)
+    const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+    const __m128i overflowMinusOne = _mm_set1_epi32(kMJHalfOverflow - 1);
+    const __m128i infinity = _mm_set1_epi32(kMJFloatInfinity);
+    const __m128i minNormal = _mm_set1_epi32(kMJHalfMinNormal);
+    const __m128i denormMagic = _mm_set1_epi32(kMJHalfDenormMagic);
+    const __m128i exponentBias = _mm_set1_epi32((int)kMJHalfExponentBias);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i halfInfinity = _mm_set1_epi32(0x7c00);
+    const __m128i halfNaN = _mm_set1_epi32(0x7e00);
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i results[2];
+        for (int j = 0; j < 2; j++) {
+            __m128i f = _mm_castps_si128(_mm_loadu_ps(floats + i + j * 4));
+            __m128i sign = _mm_and_si128(f, signMask);
+            f = _mm_xor_si128(f, sign);
+            
+            // The sign is gone, so signed compares are fine.
+            __m128i overflow = _mm_cmpgt_epi32(f, overflowMinusOne);
+            __m128i nan = _mm_cmpgt_epi32(f, infinity);
+            __m128i denormal = _mm_cmpgt_epi32(minNormal, f);
+            
+            __m128i special = MJSelectInt4(nan, halfNaN, halfInfinity);
+            __m128i denormalHalf = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(f),
+                                                                             _mm_castsi128_ps(denormMagic))),
+                                                 denormMagic);
+            __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(f, 13), one);
+            __m128i normalHalf = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(f, exponentBias), mantissaOdd), 13);
+            
+            __m128i half = MJSelectInt4(overflow, special, MJSelectInt4(denormal, denormalHalf, normalHalf));
+            half = _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+            
+            // Sign extend the low halves so that the saturating pack keeps them intact.
+            results[j] = _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+        }
+        _mm_storeu_si128((__m128i *)(halfFloats + i), _mm_packs_epi32(results[0], results[1]));
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+    const uint32x4_t overflowLimit = vdupq_n_u32(kMJHalfOverflow);
+    const uint32x4_t infinity = vdupq_n_u32(kMJFloatInfinity);
+    const uint32x4_t minNormal = vdupq_n_u32(kMJHalfMinNormal);
+    const uint32x4_t denormMagic = vdupq_n_u32(kMJHalfDenormMagic);
+    const uint32x4_t exponentBias = vdupq_n_u32(kMJHalfExponentBias);
+    const uint32x4_t one = vdupq_n_u32(1);
+    
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t f = vreinterpretq_u32_f32(vld1q_f32(floats + i));
+        uint32x4_t sign = vandq_u32(f, signMask);
+        f = veorq_u32(f, sign);
+        
+        uint32x4_t overflow = vcgeq_u32(f, overflowLimit);
+        uint32x4_t nan = vcgtq_u32(f, infinity);
+        uint32x4_t denormal = vcltq_u32(f, minNormal);
+        
+        uint32x4_t special = vbslq_u32(nan, vdupq_n_u32(0x7e00), vdupq_n_u32(0x7c00));
+        uint32x4_t denormalHalf = vsubq_u32(vreinterpretq_u32_f32(vaddq_f32(vreinterpretq_f32_u32(f),
+                                                                            vreinterpretq_f32_u32(denormMagic))),
+                                            denormMagic);
+        uint32x4_t mantissaOdd = vandq_u32(vshrq_n_u32(f, 13), one);
+        uint32x4_t normalHalf = vshrq_n_u32(vaddq_u32(vaddq_u32(f, exponentBias), mantissaOdd), 13);
+        
+        uint32x4_t half = vbslq_u32(overflow, special, vbslq_u32(denormal, denormalHalf, normalHalf));
+        half = vorrq_u32(half, vshrq_n_u32(sign, 16));
+        vst1_u16(halfFloats + i, vmovn_u32(half));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        halfFloats[i] = MJFloatToHalf(floats[i]);
+    }
+}
+
+void MJPackVectors1010102(const float *vectors,
+                          const float *w,
+                          uint32_t *packed,
+                          size_t count)
+{
+    size_t i = 0;
+    
+#if defined(__SSE2__)
+    const __m128 unitScale = _mm_set1_ps(511.0f);
+    const __m128 wScale = _mm_set1_ps(1.0f);
+    const __m128i mask10 = _mm_set1_epi32(0x3ff);
+    const __m128i mask2 = _mm_set1_epi32(0x3);
+    
+    for (; i + 4 <= count; i += 4) {
+        const float *v = vectors + i * 3;
+        __m128 x = _mm_setr_ps(v[0], v[3], v[6], v[9]);
+        __m128 y = _mm_setr_ps(v[1], v[4], v[7], v[10]);
+        __m128 z = _mm_setr_ps(v[2], v[5], v[8], v[11]);
+        __m128 vw = w ? _mm_loadu_ps(w + i) : _mm_setzero_ps();
+        
+        __m128i result = _mm_and_si128(MJSignedNormalized4(x, unitScale), mask10);
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(MJSignedNormalized4(y, unitScale), mask10), 10));
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(MJSignedNormalized4(z, unitScale), mask10), 20));
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(MJSignedNormalized4(vw, wScale), mask2), 30));
+        _mm_storeu_si128((__m128i *)(packed + i), result);
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const float32x4_t unitScale = vdupq_n_f32(511.0f);
+    const float32x4_t wScale = vdupq_n_f32(1.0f);
+    const uint32x4_t mask10 = vdupq_n_u32(0x3ff);
+    const uint32x4_t mask2 = vdupq_n_u32(0x3);
+    
+    for (; i + 4 <= count; i += 4) {
+        float32x4x3_t xyz = vld3q_f32(vectors + i * 3);
+        float32x4_t vw = w ? vld1q_f32(w + i) : vdupq_n_f32(0.0f);
+        
+        uint32x4_t result = vandq_u32(vreinterpretq_u32_s32(MJSignedNormalized4(xyz.val[0], unitScale)), mask10);
+        result = vorrq_u32(result, vshlq_n_u32(vandq_u32(vreinterpretq_u32_s32(MJSignedNormalized4(xyz.val[1], unitScale)), mask10), 10));
+        result = vorrq_u32(result, vshlq_n_u32(vandq_u32(vreinterpretq_u32_s32(MJSignedNormalized4(xyz.val[2], unitScale)), mask10), 20));
+        result = vorrq_u32(result, vshlq_n_u32(vandq_u32(vreinterpretq_u32_s32(MJSignedNormalized4(vw, wScale)), mask2), 30));
+        vst1q_u32(packed + i, result);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        packed[i] = MJPackVector1010102(vectors + i * 3, w ? w[i] : 0.0f);
+    }
+}
+
+void MJEncodeOctahedralNormals(const float *normals,
+                               int16_t *encoded,
+                               size_t count)
+{
+    size_t i = 0;
+    
+#if defined(__SSE2__)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tiny = _mm_set1_ps(1e-20f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    
+    for (; i + 4 <= count; i += 4) {
+        const float *n = normals + i * 3;
+        __m128 x = _mm_setr_ps(n[0], n[3], n[6], n[9]);
+        __m128 y = _mm_setr_ps(n[1], n[4], n[7], n[10]);
+        __m128 z = _mm_setr_ps(n[2], n[5], n[8], n[11]);
+        
+        __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)),
+                                   _mm_andnot_ps(signMask, z));
+        __m128 inverseLength = _mm_div_ps(one, _mm_max_ps(length, tiny));
+        x = _mm_mul_ps(x, inverseLength);
+        y = _mm_mul_ps(y, inverseLength);
+        
+        __m128 foldedX = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, y)), _mm_and_ps(x, signMask));
+        __m128 foldedY = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_and_ps(y, signMask));
+        __m128 lower = _mm_cmplt_ps(z, zero);
+        x = MJSelect4(lower, foldedX, x);
+        y = MJSelect4(lower, foldedY, y);
+        
+        __m128i ex = MJSignedNormalized4(x, scale);
+        __m128i ey = MJSignedNormalized4(y, scale);
+        __m128i pairs = _mm_packs_epi32(_mm_unpacklo_epi32(ex, ey), _mm_unpackhi_epi32(ex, ey));
+        _mm_storeu_si128((__m128i *)(encoded + i * 2), pairs);
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    
+    for (; i + 4 <= count; i += 4) {
+        float32x4x3_t xyz = vld3q_f32(normals + i * 3);
+        float32x4_t x = xyz.val[0];
+        float32x4_t y = xyz.val[1];
+        float32x4_t z = xyz.val[2];
+        
+        float32x4_t length = vaddq_f32(vaddq_f32(vabsq_f32(x), vabsq_f32(y)), vabsq_f32(z));
+        length = vmaxq_f32(length, vdupq_n_f32(1e-20f));
+#if defined(__aarch64__)
+        // Divide like the scalar path, so that both round the same.
+        float32x4_t inverseLength = vdivq_f32(one, length);
+#else
+        // Two Newton-Raphson steps take the reciprocal estimate to within
+        // an ulp, so a component may round one step off the scalar path.
+        float32x4_t inverseLength = vrecpeq_f32(length);
+        inverseLength = vmulq_f32(inverseLength, vrecpsq_f32(length, inverseLength));
+        inverseLength = vmulq_f32(inverseLength, vrecpsq_f32(length, inverseLength));
+#endif
+        x = vmulq_f32(x, inverseLength);
+        y = vmulq_f32(y, inverseLength);
+        
+        uint32x4_t signX = vandq_u32(vreinterpretq_u32_f32(x), signMask);
+        uint32x4_t signY = vandq_u32(vreinterpretq_u32_f32(y), signMask);
+        float32x4_t foldedX = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vsubq_f32(one, vabsq_f32(y))), signX));
+        float32x4_t foldedY = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vsubq_f32(one, vabsq_f32(x))), signY));
+        uint32x4_t lower = vcltq_f32(z, vdupq_n_f32(0.0f));
+        x = vbslq_f32(lower, foldedX, x);
+        y = vbslq_f32(lower, foldedY, y);
+        
+        int16x4x2_t pairs;
+        pairs.val[0] = vmovn_s32(MJSignedNormalized4(x, scale));
+        pairs.val[1] = vmovn_s32(MJSignedNormalized4(y, scale));
+        vst2_s16(encoded + i * 2, pairs);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        MJEncodeOctahedralNormal(normals + i * 3, encoded + i * 2);
+    }
+}
@@ -47,3 +47,42 @@
 #else
 #error This file can only be compiled for OS X or iOS.
 #endif
+
+#if TARGET_OS_MAC && !TARGET_OS_IPHONE
+#define glMapBufferRangeMJ glMapBufferRange
+#define glUnmapBufferMJ glUnmapBuffer
+#define glFenceSyncMJ glFenceSync
+#define glClientWaitSyncMJ glClientWaitSync
+#define glDeleteSyncMJ glDeleteSync
+#define glVertexAttribDivisorMJ glVertexAttribDivisor
+#define glDrawArraysInstancedMJ glDrawArraysInstanced
+#define glDrawElementsInstancedMJ glDrawElementsInstanced
+#elif TARGET_OS_IPHONE
+#define glMapBufferRangeMJ glMapBufferRangeEXT
+#define glUnmapBufferMJ glUnmapBufferOES
+#define glFenceSyncMJ glFenceSyncAPPLE
+#define glClientWaitSyncMJ glClientWaitSyncAPPLE
+#define glDeleteSyncMJ glDeleteSyncAPPLE
+#define glVertexAttribDivisorMJ glVertexAttribDivisorEXT
+#define glDrawArraysInstancedMJ glDrawArraysInstancedEXT
+#define glDrawElementsInstancedMJ glDrawElementsInstancedEXT
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT GL_MAP_WRITE_BIT_EXT
+#define GL_MAP_INVALIDATE_RANGE_BIT GL_MAP_INVALIDATE_RANGE_BIT_EXT
+#define GL_MAP_UNSYNCHRONIZED_BIT GL_MAP_UNSYNCHRONIZED_BIT_EXT
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE GL_SYNC_GPU_COMMANDS_COMPLETE_APPLE
+#define GL_SYNC_FLUSH_COMMANDS_BIT GL_SYNC_FLUSH_COMMANDS_BIT_APPLE
+#define GL_TIMEOUT_EXPIRED GL_TIMEOUT_EXPIRED_APPLE
+#define GL_WAIT_FAILED GL_WAIT_FAILED_APPLE
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL GL_TEXTURE_MAX_LEVEL_APPLE
+#endif
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT GL_HALF_FLOAT_OES
+#endif
+#else
+#error This file can only be compiled for OS X or iOS.
+#endif
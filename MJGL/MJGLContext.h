@@ -24,6 +24,7 @@
 
 #import <Foundation/Foundation.h>
 #import "MJGL.h"
+#import "MJGLStateCache.h"
 
 /** Protocol for OpenGL context wrapper. */
 @protocol MJGLContext <NSObject>
@@ -36,7 +37,17 @@
 @property (nonatomic, strong) NSOpenGLContext *glContext;
 #endif
 
-/** Make this context the current OpenGL context. */
+/**
+ * The state cache that tracks the objects bound to this context. It becomes
+ * the current state cache of the thread when the context is made current.
+ */
+@property (nonatomic, strong, readonly) MJGLStateCache *stateCache;
+
+/**
+ * Make this context the current OpenGL context. The state cache of the
+ * context is invalidated, since the context may have been used by other
+ * code, e.g. GLKit, since it was last made current through MJGL.
+ */
 - (void)makeCurrent;
 
 @end
@@ -52,4 +63,13 @@
 - (id)initWithContext:(NSOpenGLContext *)glContext;
 #endif
 
+/**
+ * Initialize a context that shares objects, such as textures and buffers,
+ * with another context. Typically used to load resources on a background
+ * thread for use by the rendering context.
+ *
+ * @param context The context to share objects with.
+ */
+- (id)initWithSharegroupOfContext:(id<MJGLContext>)context;
+
 @end
@@ -27,11 +27,13 @@
 @implementation MJGLContext
 
 @synthesize glContext = _glContext;
+@synthesize stateCache = _stateCache;
 
 - (id)init
 {
     self = [super init];
     if (self) {
+        _stateCache = [[MJGLStateCache alloc] init];
 #if TARGET_OS_IPHONE
         _glContext = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES3];
         if (_glContext == nil) {
@@ -48,11 +50,33 @@
     self = [super init];
     if (self) {
         _glContext = glContext;
+        _stateCache = [[MJGLStateCache alloc] init];
     }
     return self;
 }
 #endif
 
+- (id)initWithSharegroupOfContext:(id<MJGLContext>)context
+{
+    self = [super init];
+    if (self) {
+#if TARGET_OS_IPHONE
+        EAGLContext *sharedContext = context.glContext;
+        _glContext = [[EAGLContext alloc] initWithAPI:sharedContext.API
+                                           sharegroup:sharedContext.sharegroup];
+#else
+        NSOpenGLContext *sharedContext = context.glContext;
+        _glContext = [[NSOpenGLContext alloc] initWithFormat:sharedContext.pixelFormat
+                                                shareContext:sharedContext];
+#endif
+        if (_glContext == nil) {
+            return nil;
+        }
+        _stateCache = [[MJGLStateCache alloc] init];
+    }
+    return self;
+}
+
 - (void)makeCurrent
 {
 #if TARGET_OS_IPHONE
@@ -60,6 +84,8 @@
 #else
     [self.glContext makeCurrentContext];
 #endif
+    [self.stateCache invalidate];
+    [MJGLStateCache setCurrentStateCache:self.stateCache];
 }
 
 @end
@@ -0,0 +1,141 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+
+/** The number of texture units whose bindings are tracked. */
+#define kMJGLStateCacheTextureUnitCount 16
+
+/**
+ * The MJGLStateCache object tracks the OpenGL objects bound to a context,
+ * so that binding an object that is already bound can be skipped.
+ *
+ * Each MJGLContext owns a state cache, which becomes the current state
+ * cache of the thread when the context is made current. All MJGL objects
+ * bind programs, vertex array objects, buffers and textures through the
+ * current state cache.
+ *
+ * If OpenGL state is changed behind the back of the state cache, e.g. by
+ * GLKit or by OpenGL calls in application code, call invalidate so that
+ * the next binds are issued again. MJGLContext invalidates its state cache
+ * whenever it is made current. MJGL draw calls leave vertex array object 0
+ * bound, so such code can't modify the vertex array objects of MJGL.
+ */
+@interface MJGLStateCache : NSObject
+
+/**
+ * The number of binds that have been passed on to OpenGL since the
+ * counters were last reset.
+ */
+@property (nonatomic, readonly) NSUInteger issuedBindCount;
+
+/**
+ * The number of binds that have been skipped since the counters were
+ * last reset, because the object was already bound.
+ */
+@property (nonatomic, readonly) NSUInteger skippedBindCount;
+
+/**
+ * The state cache of the MJGLContext that is current on the calling
+ * thread. If no MJGLContext has been made current on the thread, a
+ * state cache that passes every bind on to OpenGL is returned.
+ */
++ (MJGLStateCache *)currentStateCache;
+
+/**
+ * Make a state cache the current state cache of the calling thread.
+ * Called by MJGLContext when it is made current.
+ *
+ * @param stateCache The state cache, or nil to clear it.
+ */
++ (void)setCurrentStateCache:(MJGLStateCache *)stateCache;
+
+/**
+ * Make a shader program the current program.
+ *
+ * @return YES if the bind was passed on to OpenGL.
+ */
+- (BOOL)useProgram:(GLuint)program;
+
+/**
+ * Bind a vertex array object.
+ *
+ * @return YES if the bind was passed on to OpenGL.
+ */
+- (BOOL)bindVertexArray:(GLuint)vertexArray;
+
+/**
+ * Bind a buffer object to a target. Bindings to GL_ARRAY_BUFFER and
+ * GL_ELEMENT_ARRAY_BUFFER are tracked, other targets are always bound.
+ *
+ * @return YES if the bind was passed on to OpenGL.
+ */
+- (BOOL)bindBuffer:(GLuint)buffer target:(GLenum)target;
+
+/**
+ * Bind a texture to a target of a texture unit. Bindings to GL_TEXTURE_2D
+ * and GL_TEXTURE_CUBE_MAP are tracked, other targets are always bound.
+ *
+ * @param texture The name of the texture.
+ * @param target The texture target, e.g. GL_TEXTURE_2D.
+ * @param unit The texture unit, where 0 is GL_TEXTURE0.
+ *
+ * @return YES if the bind was passed on to OpenGL.
+ */
+- (BOOL)bindTexture:(GLuint)texture target:(GLenum)target unit:(GLuint)unit;
+
+/**
+ * Enable or disable primitive restart, and set the restart index.
+ *
+ * Does nothing on iOS, since OpenGL ES 2.0 has no primitive restart.
+ *
+ * @param enabled YES to enable primitive restart.
+ * @param index The index that restarts a primitive.
+ */
+- (void)setPrimitiveRestartEnabled:(BOOL)enabled index:(GLuint)index;
+
+/** Forget a program that has been deleted. */
+- (void)didDeleteProgram:(GLuint)program;
+
+/** Forget a vertex array object that has been deleted. */
+- (void)didDeleteVertexArray:(GLuint)vertexArray;
+
+/** Forget a buffer object that has been deleted. */
+- (void)didDeleteBuffer:(GLuint)buffer;
+
+/** Forget a texture that has been deleted. */
+- (void)didDeleteTexture:(GLuint)texture;
+
+/**
+ * Forget all tracked state, so that the next bind of every kind
+ * is passed on to OpenGL.
+ */
+- (void)invalidate;
+
+/** Reset the issued and skipped bind counters. */
+- (void)resetBindCounts;
+
+@end
@@ -0,0 +1,274 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJGLStateCache.h"
+
+/** Marks state that is not known, e.g. after invalidation. */
+#define kMJGLStateUnknown ((GLuint)0xffffffff)
+
+/**
+ * The current state cache of the thread is owned by the thread dictionary,
+ * so it stays alive while it is current even if its context is released.
+ * The thread-local pointer is only a fast path to it, since ARC does not
+ * allow strong thread-local variables.
+ */
+static __thread __unsafe_unretained MJGLStateCache *currentStateCache = nil;
+static NSString * const MJGLStateCacheThreadKey = @"MJGLStateCache";
+
+@interface MJGLStateCache ()
+- (id)initWithCaching:(BOOL)caching;
+@end
+
+@implementation MJGLStateCache {
+    BOOL _caching;
+    GLuint _program;
+    GLuint _vertexArray;
+    GLuint _arrayBuffer;
+    GLuint _elementArrayBuffer;
+    GLuint _activeTextureUnit;
+    GLuint _textures2D[kMJGLStateCacheTextureUnitCount];
+    GLuint _texturesCubeMap[kMJGLStateCacheTextureUnitCount];
+    GLuint _primitiveRestartEnabled;
+    GLuint _primitiveRestartIndex;
+    BOOL _primitiveRestartIndexKnown;
+}
+
+#pragma mark - Current state cache
+
++ (MJGLStateCache *)currentStateCache
+{
+    MJGLStateCache *stateCache = currentStateCache;
+    if (stateCache == nil) {
+        static dispatch_once_t pred;
+        static MJGLStateCache *passThroughStateCache = nil;
+        dispatch_once(&pred, ^{
+            passThroughStateCache = [[MJGLStateCache alloc] initWithCaching:NO];
+        });
+        stateCache = passThroughStateCache;
+    }
+    return stateCache;
+}
+
++ (void)setCurrentStateCache:(MJGLStateCache *)stateCache
+{
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    if (stateCache) {
+        threadDictionary[MJGLStateCacheThreadKey] = stateCache;
+    } else {
+        [threadDictionary removeObjectForKey:MJGLStateCacheThreadKey];
+    }
+    currentStateCache = stateCache;
+}
+
+#pragma mark - Initializing the state cache
+
+- (id)init
+{
+    return [self initWithCaching:YES];
+}
+
+- (id)initWithCaching:(BOOL)caching
+{
+    self = [super init];
+    if (self) {
+        _caching = caching;
+        [self invalidate];
+    }
+    return self;
+}
+
+#pragma mark - Binding objects
+
+- (BOOL)useProgram:(GLuint)program
+{
+    if (_caching && _program == program) {
+        _skippedBindCount++;
+        return NO;
+    }
+    
+    glUseProgram(program);
+    _program = program;
+    _issuedBindCount++;
+    return YES;
+}
+
+- (BOOL)bindVertexArray:(GLuint)vertexArray
+{
+    if (_caching && _vertexArray == vertexArray) {
+        _skippedBindCount++;
+        return NO;
+    }
+    
+    glBindVertexArrayMJ(vertexArray);
+    _vertexArray = vertexArray;
+    
+    // The element array buffer binding is part of the vertex array state.
+    _elementArrayBuffer = kMJGLStateUnknown;
+    _issuedBindCount++;
+    return YES;
+}
+
+- (BOOL)bindBuffer:(GLuint)buffer target:(GLenum)target
+{
+    GLuint *binding = NULL;
+    switch (target) {
+        case GL_ARRAY_BUFFER: binding = &_arrayBuffer; break;
+        case GL_ELEMENT_ARRAY_BUFFER: binding = &_elementArrayBuffer; break;
+    }
+    
+    if (_caching && binding && *binding == buffer) {
+        _skippedBindCount++;
+        return NO;
+    }
+    
+    glBindBuffer(target, buffer);
+    if (binding) {
+        *binding = buffer;
+    }
+    _issuedBindCount++;
+    return YES;
+}
+
+- (BOOL)bindTexture:(GLuint)texture target:(GLenum)target unit:(GLuint)unit
+{
+    GLuint *binding = NULL;
+    if (unit < kMJGLStateCacheTextureUnitCount) {
+        switch (target) {
+            case GL_TEXTURE_2D: binding = &_textures2D[unit]; break;
+            case GL_TEXTURE_CUBE_MAP: binding = &_texturesCubeMap[unit]; break;
+        }
+    }
+    
+    if (_caching && binding && *binding == texture) {
+        _skippedBindCount++;
+        return NO;
+    }
+    
+    if (!_caching || _activeTextureUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        _activeTextureUnit = unit;
+    }
+    glBindTexture(target, texture);
+    if (binding) {
+        *binding = texture;
+    }
+    _issuedBindCount++;
+    return YES;
+}
+
+#pragma mark - Setting state
+
+- (void)setPrimitiveRestartEnabled:(BOOL)enabled index:(GLuint)index
+{
+#if !TARGET_OS_IPHONE
+    GLuint enabledState = enabled ? GL_TRUE : GL_FALSE;
+    if (!_caching || _primitiveRestartEnabled != enabledState) {
+        if (enabled) {
+            glEnable(GL_PRIMITIVE_RESTART);
+        } else {
+            glDisable(GL_PRIMITIVE_RESTART);
+        }
+        _primitiveRestartEnabled = enabledState;
+    }
+    
+    // The restart index can't be marked unknown with a sentinel,
+    // since every value is a valid index.
+    if (enabled && (!_caching || !_primitiveRestartIndexKnown ||
+                    _primitiveRestartIndex != index)) {
+        glPrimitiveRestartIndex(index);
+        _primitiveRestartIndex = index;
+        _primitiveRestartIndexKnown = YES;
+    }
+#endif
+}
+
+#pragma mark - Deleting objects
+
+- (void)didDeleteProgram:(GLuint)program
+{
+    if (_program == program) {
+        _program = kMJGLStateUnknown;
+    }
+}
+
+- (void)didDeleteVertexArray:(GLuint)vertexArray
+{
+    // Deleting the bound vertex array object binds 0 instead.
+    if (_vertexArray == vertexArray) {
+        _vertexArray = 0;
+        _elementArrayBuffer = kMJGLStateUnknown;
+    }
+}
+
+- (void)didDeleteBuffer:(GLuint)buffer
+{
+    if (_arrayBuffer == buffer) {
+        _arrayBuffer = 0;
+    }
+    if (_elementArrayBuffer == buffer) {
+        _elementArrayBuffer = kMJGLStateUnknown;
+    }
+}
+
+- (void)didDeleteTexture:(GLuint)texture
+{
+    for (GLuint unit = 0; unit < kMJGLStateCacheTextureUnitCount; unit++) {
+        if (_textures2D[unit] == texture) {
+            _textures2D[unit] = kMJGLStateUnknown;
+        }
+        if (_texturesCubeMap[unit] == texture) {
+            _texturesCubeMap[unit] = kMJGLStateUnknown;
+        }
+    }
+}
+
+#pragma mark - Invalidating the state cache
+
+- (void)invalidate
+{
+    _program = kMJGLStateUnknown;
+    _vertexArray = kMJGLStateUnknown;
+    _arrayBuffer = kMJGLStateUnknown;
+    _elementArrayBuffer = kMJGLStateUnknown;
+    _activeTextureUnit = kMJGLStateUnknown;
+    _primitiveRestartEnabled = kMJGLStateUnknown;
+    _primitiveRestartIndexKnown = NO;
+    for (GLuint unit = 0; unit < kMJGLStateCacheTextureUnitCount; unit++) {
+        _textures2D[unit] = kMJGLStateUnknown;
+        _texturesCubeMap[unit] = kMJGLStateUnknown;
+    }
+}
+
+- (void)resetBindCounts
+{
+    _issuedBindCount = 0;
+    _skippedBindCount = 0;
+}
+
+@end
@@ -24,6 +24,43 @@
 
 #import "MJGL.h"
 
+#pragma mark - Type Definitions
+
+/**
+ * The type of the indices in an index buffer. Narrower types use less
+ * memory and bandwidth but can address fewer vertices. Prefer 16-bit over
+ * 8-bit indices, which many drivers handle on a slow path.
+ */
+typedef enum MJIndexBufferType
+{
+    /** 8-bit indices, addressing up to 255 vertices. */
+    MJIndexBufferTypeUnsignedByte = GL_UNSIGNED_BYTE,
+    
+    /** 16-bit indices, addressing up to 65,535 vertices. */
+    MJIndexBufferTypeUnsignedShort = GL_UNSIGNED_SHORT,
+    
+    /** 32-bit indices. */
+    MJIndexBufferTypeUnsignedInt = GL_UNSIGNED_INT
+} MJIndexBufferType;
+
+/**
+ * The usage pattern specifies how dynamic the index data is intended to be.
+ */
+typedef enum MJIndexBufferUsagePattern
+{
+    /** For index data that is only specified once and won't change. */
+    MJIndexBufferStatic = GL_STATIC_DRAW,
+    
+    /** For index data that may change during the rendering loop. */
+    MJIndexBufferChangesSometimes = GL_DYNAMIC_DRAW,
+    
+    /** For index data that is respecified every frame. */
+    MJIndexBufferChangesEveryFrame = GL_STREAM_DRAW
+} MJIndexBufferUsagePattern;
+
+
+#pragma mark - MJIndexBuffer Interface
+
 /**
  * The MJIndexBuffer object wraps a number of OpenGL calls for creating
  * "index buffer objects" (IBOs). An IBO is a memory buffer, controlled by
@@ -39,8 +76,29 @@
 /** The number of indices in the buffer. */
 @property (nonatomic, readonly) NSUInteger count;
 
+/** The type of the indices in the buffer. */
+@property (nonatomic, readonly) MJIndexBufferType type;
+
+/** The size in bytes of an individual index. */
+@property (nonatomic, readonly) NSUInteger indexSize;
+
+/**
+ * Indicates whether primitive restart is enabled when drawing with the
+ * index buffer. When enabled, the primitiveRestartIndex starts a new
+ * primitive, e.g. a new triangle strip, without a separate draw call.
+ *
+ * NOTE: Not supported on iOS, which uses OpenGL ES 2.0. OpenGL ES 3.0 has
+ * only the fixed restart index (GL_PRIMITIVE_RESTART_FIXED_INDEX), which
+ * is not used. Setting it to YES on iOS logs a warning and leaves it NO.
+ * Default value is NO.
+ */
+@property (nonatomic, assign) BOOL primitiveRestartEnabled;
+
+/** The index that restarts a primitive, the largest value of the type. */
+@property (nonatomic, readonly) GLuint primitiveRestartIndex;
+
 /**
- * Initialize the index buffer and copy index data to it.
+ * Initialize a static 16-bit index buffer and copy index data to it.
  *
  * @param indexCount The number of indices to store in the index buffer.
  *
@@ -49,11 +107,54 @@
 - (id)initWithCapacity:(unsigned int)indexCount
                indices:(const GLushort *)indices;
 
+/**
+ * Initialize an index buffer of a specific type.
+ *
+ * @param indexCount The number of indices that will fit in the buffer.
+ * @param type The type of the indices.
+ * @param usagePattern Specifies how the buffer will be used.
+ * @param indices Pointer to an array of indices of the specified type,
+ *                or NULL to leave the buffer uninitialized.
+ */
+- (id)initWithCapacity:(NSUInteger)indexCount
+                  type:(MJIndexBufferType)type
+                 usage:(MJIndexBufferUsagePattern)usagePattern
+               indices:(const void *)indices;
+
+/**
+ * Initialize an index buffer from 32-bit indices, stored as 16-bit
+ * indices if they can hold the largest index, and as 32-bit indices
+ * otherwise. 8-bit indices are never chosen, since many drivers handle
+ * them on a slow path. An index of 0xFFFFFFFF
+ * is treated as a primitive restart and converted to the restart index
+ * of the chosen type.
+ *
+ * @param indexCount The number of indices to store in the index buffer.
+ * @param usagePattern Specifies how the buffer will be used.
+ * @param indices Pointer to an array of 32-bit indices.
+ */
+- (id)initWithCapacity:(NSUInteger)indexCount
+                 usage:(MJIndexBufferUsagePattern)usagePattern
+             indices32:(const GLuint *)indices;
+
+/**
+ * Replace a range of indices in the buffer.
+ *
+ * @param offset Index of the first index to replace.
+ * @param indexCount The number of indices to replace.
+ * @param indices Pointer to an array of indices of the buffer's type.
+ */
+- (void)setIndicesAtOffset:(NSUInteger)offset
+                     count:(NSUInteger)indexCount
+                   indices:(const void *)indices;
+
 /**
  * Bind the index buffer to the OpenGL context as the current index buffer.
  *
  * This method is only necessary to call if the index buffer is not used
  * in conjunction with the draw call of the MJVertexBuffer object.
+ *
+ * Also enables or disables primitive restart for the index buffer.
  */
 - (void)bind;
 
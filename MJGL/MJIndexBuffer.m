@@ -22,43 +22,162 @@
 //  (MIT License)
 //
 
+
 #if !__has_feature(objc_arc)
 #error ARC must be enabled!
 #endif
 
 #import "MJIndexBuffer.h"
+#import "MJGLStateCache.h"
 
 @implementation MJIndexBuffer {
 	unsigned int _bufferId;
+    MJIndexBufferUsagePattern _usagePattern;
 }
 
+#pragma mark - Initializing/destroying the index buffer
+
 - (id)initWithCapacity:(unsigned int)indexCount
                indices:(const GLushort *)indices
+{
+    return [self initWithCapacity:indexCount
+                             type:MJIndexBufferTypeUnsignedShort
+                            usage:MJIndexBufferStatic
+                          indices:indices];
+}
+
+- (id)initWithCapacity:(NSUInteger)indexCount
+                  type:(MJIndexBufferType)type
+                 usage:(MJIndexBufferUsagePattern)usagePattern
+               indices:(const void *)indices
 {
     self = [super init];
 	if (self)
 	{
 		_bufferId = GL_INVALID_VALUE;
         _count = indexCount;
+        _type = type;
+        _usagePattern = usagePattern;
+        
+        switch (type)
+        {
+            case MJIndexBufferTypeUnsignedByte:
+                _indexSize = sizeof(GLubyte);
+                _primitiveRestartIndex = 0xff;
+                break;
+            case MJIndexBufferTypeUnsignedShort:
+                _indexSize = sizeof(GLushort);
+                _primitiveRestartIndex = 0xffff;
+                break;
+            case MJIndexBufferTypeUnsignedInt:
+                _indexSize = sizeof(GLuint);
+                _primitiveRestartIndex = 0xffffffff;
+                break;
+        }
 		
+        MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+        
+        // Make sure the buffer isn't attached to a vertex array object.
+        [stateCache bindVertexArray:0];
+        
 		glGenBuffers(1, &_bufferId);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _bufferId);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLushort),
-                     indices, GL_STATIC_DRAW);
+        [stateCache bindBuffer:_bufferId target:GL_ELEMENT_ARRAY_BUFFER];
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count * _indexSize,
+                     indices, (GLenum)usagePattern);
 	}
 	
 	return self;
 }
 
+- (id)initWithCapacity:(NSUInteger)indexCount
+                 usage:(MJIndexBufferUsagePattern)usagePattern
+             indices32:(const GLuint *)indices
+{
+    GLuint maxIndex = 0;
+    for (NSUInteger i = 0; i < indexCount; i++) {
+        if (indices[i] != 0xffffffff && indices[i] > maxIndex) {
+            maxIndex = indices[i];
+        }
+    }
+    
+    // The largest value of each type is reserved for primitive restart.
+    // Indices are not narrowed to bytes, which many drivers handle on a
+    // slow path.
+    if (maxIndex < 0xffff) {
+        GLushort *narrowIndices = malloc(indexCount * sizeof(GLushort));
+        for (NSUInteger i = 0; i < indexCount; i++) {
+            narrowIndices[i] = (indices[i] == 0xffffffff) ? 0xffff : (GLushort)indices[i];
+        }
+        self = [self initWithCapacity:indexCount
+                                 type:MJIndexBufferTypeUnsignedShort
+                                usage:usagePattern
+                              indices:narrowIndices];
+        free(narrowIndices);
+    } else {
+        self = [self initWithCapacity:indexCount
+                                 type:MJIndexBufferTypeUnsignedInt
+                                usage:usagePattern
+                              indices:indices];
+    }
+    
+    return self;
+}
+
 - (void)dealloc
 {
     glDeleteBuffers(1, &_bufferId);
+    [[MJGLStateCache currentStateCache] didDeleteBuffer:_bufferId];
 	_bufferId = GL_INVALID_VALUE;
 }
 
+#pragma mark - Modifying the index buffer
+
+- (void)setIndicesAtOffset:(NSUInteger)offset
+                     count:(NSUInteger)indexCount
+                   indices:(const void *)indices
+{
+    if (offset + indexCount > _count) {
+        NSLog(@"WARNING: Indices do not fit in the index buffer.");
+        return;
+    }
+    
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    
+    // Make sure the buffer isn't attached to the last bound vertex array
+    // object.
+    [stateCache bindVertexArray:0];
+    [stateCache bindBuffer:_bufferId target:GL_ELEMENT_ARRAY_BUFFER];
+    
+    if (_usagePattern != MJIndexBufferStatic && offset == 0 && indexCount == _count) {
+        // Respecify the whole buffer, so that the driver can orphan the old
+        // storage instead of waiting for draw calls that still use it.
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count * _indexSize, indices,
+                     (GLenum)_usagePattern);
+    } else {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset * _indexSize,
+                        indexCount * _indexSize, indices);
+    }
+}
+
+- (void)setPrimitiveRestartEnabled:(BOOL)primitiveRestartEnabled
+{
+#if TARGET_OS_IPHONE
+    if (primitiveRestartEnabled) {
+        NSLog(@"WARNING: Primitive restart is not supported by OpenGL ES 2.");
+        return;
+    }
+#endif
+    _primitiveRestartEnabled = primitiveRestartEnabled;
+}
+
+#pragma mark - Binding the index buffer
+
 - (void)bind
 {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _bufferId);
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    [stateCache bindBuffer:_bufferId target:GL_ELEMENT_ARRAY_BUFFER];
+    [stateCache setPrimitiveRestartEnabled:_primitiveRestartEnabled
+                                     index:_primitiveRestartIndex];
 }
 
 @end
@@ -24,6 +24,8 @@
 
 #import <Foundation/Foundation.h>
 #import "MJGL.h"
+#import <GLKit/GLKit.h>
+#import "MJShaderProgramBinaryCache.h"
 
 /** Write shaders with partial syntax coloring right in your code. */
 #if !TARGET_OS_IPHONE
@@ -44,6 +46,24 @@ extern NSString * const MJShaderProgramErrorDomain;
 /** The shader program could not be linked, after shader compilation. */
 #define kMJShaderProgramErrorLinkingShaderProgram 3
 
+/**
+ * Name of the uniform block with the matrices of the active camera, see
+ * MJCameraUniformBlock.
+ */
+extern NSString * const MJCameraUniformBlockName;
+
+/** Uniform buffer binding point of the camera uniform block. */
+#define kMJCameraUniformBlockBinding 0
+
+/**
+ * Handle of an active uniform of a shader program, used with the typed
+ * uniform setters.
+ */
+typedef NSInteger MJUniformHandle;
+
+/** Handle returned for uniforms that are not active in the program. */
+#define kMJUniformHandleInvalid -1
+
 @interface MJShaderProgram : NSObject
 
 /** The source code of the vertex shader. */
@@ -60,6 +80,46 @@ extern NSString * const MJShaderProgramErrorDomain;
  */
 @property (nonatomic, strong, readonly) NSArray *attributes;
 
+/**
+ * Optional cache of program binaries. If set, compileWithError: loads the
+ * program from a cached binary when possible, and stores the binary of
+ * the program after compiling it from source otherwise.
+ */
+@property (nonatomic, strong) MJShaderProgramBinaryCache *binaryCache;
+
+/**
+ * YES between beginCompile and the point where the compilation has been
+ * finished, either explicitly or by first use of the program.
+ */
+@property (nonatomic, readonly, getter = isCompiling) BOOL compiling;
+
+/**
+ * The error of the last compilation, or nil if it succeeded or has not
+ * been finished yet. Kept so that the error is not lost when the
+ * compilation is finished by first use of the program.
+ */
+@property (nonatomic, strong, readonly) NSError *compileError;
+
+/**
+ * Indicates whether the driver can compile shaders in the background
+ * (KHR_parallel_shader_compile), so that isCompileComplete can be asked
+ * without blocking. Expects a current OpenGL context.
+ */
++ (BOOL)supportsParallelCompile;
+
+/**
+ * Register the uniform buffer binding point of a uniform block. Programs
+ * with a block of that name have it bound to the binding point when they
+ * are linked, so that one uniform buffer can be shared by all of them.
+ * The camera uniform block is registered by default.
+ *
+ * NOTE: Uniform blocks are not supported by OpenGL ES 2 on iOS.
+ *
+ * @param binding The binding point.
+ * @param blockName The name of the uniform block.
+ */
++ (void)setBinding:(GLuint)binding forUniformBlock:(NSString *)blockName;
+
 /**
  * Initialize the shader program instance with shader source code
  * and shader attributes. The program must still be compiled before use.
@@ -82,6 +142,33 @@ extern NSString * const MJShaderProgramErrorDomain;
  */
 - (void)compileWithError:(__autoreleasing NSError **)error;
 
+/**
+ * Submit the vertex and fragment shaders for compilation and linking,
+ * without waiting for the result. The compilation is finished by
+ * finishCompileWithError:, or when the program is first used, which
+ * blocks until the driver is done with it.
+ *
+ * Submitting many programs before finishing any of them lets the driver
+ * compile them in parallel. See MJShaderProgramBatch.
+ */
+- (void)beginCompile;
+
+/**
+ * Check if the driver is done compiling and linking the program, so that
+ * finishCompileWithError: won't block. Only non-blocking if the driver
+ * supports parallel compilation, otherwise it always returns YES.
+ */
+- (BOOL)isCompileComplete;
+
+/**
+ * Finish a compilation started by beginCompile, blocking until the driver
+ * is done with it, and check the compile and link status. If the
+ * compilation has already been finished, the error is compileError.
+ *
+ * @param error Contains a pointer to an error object if compilation failed.
+ */
+- (void)finishCompileWithError:(__autoreleasing NSError **)error;
+
 /**
  * Get the attribute index of the specified attribute.
  *
@@ -99,7 +186,43 @@ extern NSString * const MJShaderProgramErrorDomain;
 - (NSInteger)indexOfUniform:(NSString *)uniform;
 
 /**
- * Binds the program to the GL context for immediate use.
+ * Get the handle of the specified uniform. The active uniforms of the
+ * program are reflected once when it is compiled, so this is a dictionary
+ * lookup. Look up handles once and keep them, rather than every frame.
+ *
+ * @param uniform Name of the uniform. For arrays, the first element, as
+ *                either "name" or "name[0]".
+ * @return Handle of the uniform, or kMJUniformHandleInvalid if the uniform
+ *         is not active in the program.
+ */
+- (MJUniformHandle)handleForUniform:(NSString *)uniform;
+
+/**
+ * The typed uniform setters store the value in the program and mark the
+ * uniform as changed if the value differs from the stored value. Changed
+ * uniforms are uploaded by the next prepareToDraw, so setting a uniform to
+ * the value it already has costs nothing.
+ *
+ * Invalid handles are ignored.
+ */
+- (void)setFloat:(float)value forUniform:(MJUniformHandle)handle;
+- (void)setVector2:(GLKVector2)value forUniform:(MJUniformHandle)handle;
+- (void)setVector3:(GLKVector3)value forUniform:(MJUniformHandle)handle;
+- (void)setVector4:(GLKVector4)value forUniform:(MJUniformHandle)handle;
+- (void)setMatrix3:(GLKMatrix3)value forUniform:(MJUniformHandle)handle;
+- (void)setMatrix4:(GLKMatrix4)value forUniform:(MJUniformHandle)handle;
+
+/**
+ * Set the texture unit of a sampler uniform.
+ *
+ * @param textureUnit The texture unit, where 0 is GL_TEXTURE0.
+ * @param handle Handle of the sampler uniform.
+ */
+- (void)setSampler:(GLint)textureUnit forUniform:(MJUniformHandle)handle;
+
+/**
+ * Binds the program to the GL context for immediate use, and uploads
+ * uniforms changed by the typed uniform setters.
  */
 - (void)prepareToDraw;
 
@@ -23,14 +23,79 @@
 //
 
 #import "MJShaderProgram.h"
+#import "MJGLStateCache.h"
+#include <dlfcn.h>
 
 NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
+NSString * const MJCameraUniformBlockName = @"MJCamera";
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (*MJMaxShaderCompilerThreadsProc)(GLuint count);
+
+/** Checks whether the current context supports an extension. */
+static BOOL MJHasExtension(const char *extension)
+{
+#if TARGET_OS_IPHONE
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    if (extensions == NULL) {
+        return NO;
+    }
+    size_t length = strlen(extension);
+    for (const char *match = strstr(extensions, extension); match != NULL;
+         match = strstr(match + length, extension)) {
+        if ((match == extensions || match[-1] == ' ') &&
+            (match[length] == ' ' || match[length] == '\0')) {
+            return YES;
+        }
+    }
+    return NO;
+#else
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (name && strcmp(name, extension) == 0) {
+            return YES;
+        }
+    }
+    return NO;
+#endif
+}
+
+/** Reflected active uniform with a CPU shadow of its value. */
+typedef struct MJUniform
+{
+    GLint location;
+    GLenum type;
+    GLuint valueOffset;
+    GLuint valueWordCount;
+    BOOL dirty;
+} MJUniform;
+
+/** The number of 32-bit words in a value of a uniform type. */
+static GLuint MJUniformWordCount(GLenum type)
+{
+    switch (type)
+    {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: return 4;
+        case GL_FLOAT_MAT2: return 4;
+        case GL_FLOAT_MAT3: return 9;
+        case GL_FLOAT_MAT4: return 16;
+        default: return 1;
+    }
+}
 
 @interface MJShaderProgram ()
 
 @property (nonatomic, copy, readwrite) NSString *vertexShader;
 @property (nonatomic, copy, readwrite) NSString *fragmentShader;
 @property (nonatomic, strong, readwrite) NSArray *attributes;
+@property (nonatomic, strong, readwrite) NSError *compileError;
 @property (nonatomic, assign) GLuint program;
 
 @end
@@ -38,6 +103,19 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
 @implementation MJShaderProgram {
     NSString *_vertexShader;
     NSString *_fragmentShader;
+    
+    // Reflected uniforms, indexed by handle.
+    NSDictionary *_uniformHandles;
+    MJUniform *_uniforms;
+    GLuint *_uniformValues;
+    MJUniformHandle *_dirtyUniforms;
+    NSUInteger _dirtyUniformCount;
+    
+    // Compilation state between beginCompile and finishCompileWithError:.
+    GLuint _pendingProgram;
+    GLuint _pendingVertexShader;
+    GLuint _pendingFragmentShader;
+    NSTimeInterval _compileDuration;
 }
 
 - (id)initWithVertexShader:(NSString *)vertexShader
@@ -54,7 +132,16 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
 
 - (void)dealloc
 {
+    if (_compiling) {
+        glDeleteShader(_pendingVertexShader);
+        glDeleteShader(_pendingFragmentShader);
+        glDeleteProgram(_pendingProgram);
+    }
+    free(_uniforms);
+    free(_uniformValues);
+    free(_dirtyUniforms);
     glDeleteProgram(self.program);
+    [[MJGLStateCache currentStateCache] didDeleteProgram:self.program];
 }
 
 - (NSInteger)indexOfAttribute:(NSString *)attribute {
@@ -66,6 +153,13 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
 }
 
 - (NSInteger)indexOfUniform:(NSString *)uniform {
+    MJUniformHandle handle = [self handleForUniform:uniform];
+    if (handle != kMJUniformHandleInvalid) {
+        return _uniforms[handle].location;
+    }
+    
+    // Only the first element of an array is reflected, ask GL for the
+    // location of other elements, e.g. "bones[3]".
     int location = glGetUniformLocation(self.program, [uniform UTF8String]);
     GLenum result = glGetError();
     if (result != GL_NO_ERROR) {
@@ -76,49 +170,267 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
 }
 
 - (void)prepareToDraw {
-    glUseProgram(self.program);
-    GLenum result = glGetError();
-    if (result != GL_NO_ERROR) {
-        NSLog(@"GL ERROR: %d", result);
+    [self finishCompileIfNeeded];
+    
+    if ([[MJGLStateCache currentStateCache] useProgram:self.program]) {
+        GLenum result = glGetError();
+        if (result != GL_NO_ERROR) {
+            NSLog(@"GL ERROR: %d", result);
+        }
+    }
+    
+    if (_dirtyUniformCount > 0) {
+        [self uploadDirtyUniforms];
     }
 }
 
+#pragma mark - Uniforms
+
+- (MJUniformHandle)handleForUniform:(NSString *)uniform {
+    [self finishCompileIfNeeded];
+    
+    NSNumber *handle = _uniformHandles[uniform];
+    if (handle == nil) {
+        return kMJUniformHandleInvalid;
+    }
+    
+    return [handle integerValue];
+}
+
+- (void)setFloat:(float)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT value:&value];
+}
+
+- (void)setVector2:(GLKVector2)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT_VEC2 value:value.v];
+}
+
+- (void)setVector3:(GLKVector3)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT_VEC3 value:value.v];
+}
+
+- (void)setVector4:(GLKVector4)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT_VEC4 value:value.v];
+}
+
+- (void)setMatrix3:(GLKMatrix3)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT_MAT3 value:value.m];
+}
+
+- (void)setMatrix4:(GLKMatrix4)value forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_FLOAT_MAT4 value:value.m];
+}
+
+- (void)setSampler:(GLint)textureUnit forUniform:(MJUniformHandle)handle {
+    [self setUniform:handle type:GL_INT value:&textureUnit];
+}
+
+- (void)setUniform:(MJUniformHandle)handle type:(GLenum)type value:(const void *)value {
+    if (handle < 0 || handle >= (MJUniformHandle)_uniformHandles.count) {
+        return;
+    }
+    
+    MJUniform *uniform = &_uniforms[handle];
+    
+    // Samplers and booleans are set as ints.
+    NSAssert(uniform->type == type || type == GL_INT,
+             @"Uniform type mismatch, expected 0x%x.", uniform->type);
+    
+    GLuint *shadow = _uniformValues + uniform->valueOffset;
+    size_t size = MIN(MJUniformWordCount(type), uniform->valueWordCount) * sizeof(GLuint);
+    if (memcmp(shadow, value, size) == 0) {
+        return;
+    }
+    
+    memcpy(shadow, value, size);
+    if (!uniform->dirty) {
+        uniform->dirty = YES;
+        _dirtyUniforms[_dirtyUniformCount++] = handle;
+    }
+}
+
+- (void)uploadDirtyUniforms {
+    for (NSUInteger i = 0; i < _dirtyUniformCount; i++) {
+        MJUniform *uniform = &_uniforms[_dirtyUniforms[i]];
+        const GLuint *value = _uniformValues + uniform->valueOffset;
+        const GLfloat *floats = (const GLfloat *)value;
+        const GLint *ints = (const GLint *)value;
+        
+        switch (uniform->type)
+        {
+            case GL_FLOAT: glUniform1fv(uniform->location, 1, floats); break;
+            case GL_FLOAT_VEC2: glUniform2fv(uniform->location, 1, floats); break;
+            case GL_FLOAT_VEC3: glUniform3fv(uniform->location, 1, floats); break;
+            case GL_FLOAT_VEC4: glUniform4fv(uniform->location, 1, floats); break;
+            case GL_FLOAT_MAT3: glUniformMatrix3fv(uniform->location, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform->location, 1, GL_FALSE, floats); break;
+            default: glUniform1iv(uniform->location, 1, ints); break;
+        }
+        
+        uniform->dirty = NO;
+    }
+    
+    _dirtyUniformCount = 0;
+}
+
+- (void)reflectUniforms:(GLuint)program {
+    free(_uniforms);
+    free(_uniformValues);
+    free(_dirtyUniforms);
+    _uniforms = NULL;
+    _uniformValues = NULL;
+    _dirtyUniforms = NULL;
+    _dirtyUniformCount = 0;
+    
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    
+    NSMutableDictionary *handles = [NSMutableDictionary dictionaryWithCapacity:uniformCount];
+    _uniforms = calloc(MAX(uniformCount, 1), sizeof(MJUniform));
+    _dirtyUniforms = calloc(MAX(uniformCount, 1), sizeof(MJUniformHandle));
+    GLchar *name = malloc(MAX(maxNameLength, 1));
+    GLuint valueWordCount = 0;
+    
+    MJUniformHandle handle = 0;
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, maxNameLength, NULL, &size, &type, name);
+        
+        GLint location = glGetUniformLocation(program, name);
+        if (location < 0) {
+            // Uniform in a uniform block.
+            continue;
+        }
+        
+        // Arrays are reported as "name[0]", register them both as "name"
+        // and as "name[0]".
+        NSString *uniformName = [NSString stringWithUTF8String:name];
+        if ([uniformName hasSuffix:@"[0]"]) {
+            handles[uniformName] = @(handle);
+            uniformName = [uniformName substringToIndex:uniformName.length - 3];
+        }
+        
+        MJUniform *uniform = &_uniforms[handle];
+        uniform->location = location;
+        uniform->type = type;
+        uniform->valueOffset = valueWordCount;
+        uniform->valueWordCount = MJUniformWordCount(type);
+        valueWordCount += uniform->valueWordCount;
+        
+        handles[uniformName] = @(handle);
+        handle++;
+    }
+    free(name);
+    
+    // Uniforms are initialized to zero when the program is linked.
+    _uniformValues = calloc(MAX(valueWordCount, 1), sizeof(GLuint));
+    _uniformHandles = [handles copy];
+    
+    [MJShaderProgram bindUniformBlocks:program];
+}
+
+#pragma mark - Uniform blocks
+
++ (NSMutableDictionary *)uniformBlockBindings {
+    static dispatch_once_t pred;
+    static NSMutableDictionary *bindings = nil;
+    dispatch_once(&pred, ^{
+        bindings = [NSMutableDictionary dictionaryWithObject:@(kMJCameraUniformBlockBinding)
+                                                      forKey:MJCameraUniformBlockName];
+    });
+    return bindings;
+}
+
++ (void)setBinding:(GLuint)binding forUniformBlock:(NSString *)blockName {
+    NSMutableDictionary *bindings = [self uniformBlockBindings];
+    @synchronized(bindings) {
+        bindings[blockName] = @(binding);
+    }
+}
+
++ (void)bindUniformBlocks:(GLuint)program {
+#if !TARGET_OS_IPHONE
+    GLint blockCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    if (blockCount == 0) {
+        return;
+    }
+    
+    NSMutableDictionary *bindings = [self uniformBlockBindings];
+    @synchronized(bindings) {
+        for (NSString *blockName in bindings) {
+            GLuint blockIndex = glGetUniformBlockIndex(program, [blockName UTF8String]);
+            if (blockIndex != GL_INVALID_INDEX) {
+                glUniformBlockBinding(program, blockIndex, [bindings[blockName] unsignedIntValue]);
+            }
+        }
+    }
+#endif
+}
+
 #pragma mark - Compilation and Linking
 
++ (BOOL)supportsParallelCompile {
+    static dispatch_once_t pred;
+    static BOOL supported = NO;
+    dispatch_once(&pred, ^{
+        supported = MJHasExtension("GL_KHR_parallel_shader_compile") ||
+                    MJHasExtension("GL_ARB_parallel_shader_compile");
+        if (supported) {
+            // Let the driver use as many compiler threads as it likes.
+            MJMaxShaderCompilerThreadsProc maxShaderCompilerThreads =
+                (MJMaxShaderCompilerThreadsProc)dlsym(RTLD_DEFAULT, "glMaxShaderCompilerThreadsKHR");
+            if (maxShaderCompilerThreads) {
+                maxShaderCompilerThreads(0xffffffff);
+            }
+        }
+    });
+    return supported;
+}
+
 - (void)compileWithError:(__autoreleasing NSError **)error {
     
     *error = nil;
     
-    // Create shader program.
-    GLuint program = glCreateProgram();
-    
-    // Create and compile vertex shader.
-    GLuint vertexShader;
-    bool success = [self compileShader:&vertexShader
-                                  type:GL_VERTEX_SHADER
-                                  code:[self.vertexShader UTF8String]];
-    if (!success) {
-        glDeleteProgram(program);
-        *error = [NSError errorWithDomain:(NSString *)MJShaderProgramErrorDomain
-                                     code:kMJShaderProgramErrorCompilingVertexShader
-                                 userInfo:@{NSLocalizedDescriptionKey : @"Failed to compile vertex shader."}];
+    [self beginCompile];
+    [self finishCompileWithError:error];
+}
+
+- (void)beginCompile {
+    if (_compiling) {
         return;
     }
+    self.compileError = nil;
     
-    // Create and compile fragment shader.
-    GLuint fragmentShader;
-    success = [self compileShader:&fragmentShader
-                             type:GL_FRAGMENT_SHADER
-                             code:[self.fragmentShader UTF8String]];
-    if (!success) {
-        glDeleteShader(vertexShader);
-        glDeleteProgram(program);
-        *error = [NSError errorWithDomain:(NSString *)MJShaderProgramErrorDomain
-                                     code:kMJShaderProgramErrorCompilingFragmentShader
-                                 userInfo:@{NSLocalizedDescriptionKey: @"Failed to compile fragment shader."}];
-        return;
+    if (self.binaryCache) {
+        GLuint program = [self.binaryCache loadProgramWithVertexShader:self.vertexShader
+                                                        fragmentShader:self.fragmentShader
+                                                            attributes:self.attributes];
+        if (program != 0) {
+            [self reflectUniforms:program];
+            self.program = program;
+            return;
+        }
     }
     
+    // Only the time spent in the compile and link calls counts as compile
+    // time, not the time until the compilation is finished.
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    
+    // Create shader program.
+    GLuint program = glCreateProgram();
+    
+    // Create and compile vertex and fragment shaders. The compile status
+    // is not checked until the compilation is finished, so that the driver
+    // can compile in the background.
+    GLuint vertexShader = [self createShaderOfType:GL_VERTEX_SHADER
+                                              code:[self.vertexShader UTF8String]];
+    GLuint fragmentShader = [self createShaderOfType:GL_FRAGMENT_SHADER
+                                                code:[self.fragmentShader UTF8String]];
+    
     // Attach vertex shader to program.
     glAttachShader(program, vertexShader);
     
@@ -133,18 +445,64 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
     }
     
     // Link program.
-    success = [self linkProgram:program];
-    if (!success) {
-        glDetachShader(program, vertexShader);
-        glDeleteShader(vertexShader);
-        glDetachShader(program, fragmentShader);
-        glDeleteShader(fragmentShader);
-        glDeleteProgram(program);
-        *error = [NSError errorWithDomain:(NSString *)MJShaderProgramErrorDomain
-                                     code:kMJShaderProgramErrorLinkingShaderProgram
-                                 userInfo:@{NSLocalizedDescriptionKey: @"Failed to compile shader program."}];
+    [self.binaryCache prepareProgramForLinking:program];
+    glLinkProgram(program);
+    
+    _compileDuration = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    _pendingProgram = program;
+    _pendingVertexShader = vertexShader;
+    _pendingFragmentShader = fragmentShader;
+    _compiling = YES;
+}
+
+- (BOOL)isCompileComplete {
+    if (!_compiling) {
+        return YES;
+    }
+    
+    if (![MJShaderProgram supportsParallelCompile]) {
+        // Without the extension there is no way to ask without blocking.
+        return YES;
+    }
+    
+    GLint complete = GL_FALSE;
+    glGetProgramiv(_pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+- (void)finishCompileWithError:(__autoreleasing NSError **)error {
+    if (error) {
+        *error = nil;
+    }
+    
+    if (!_compiling) {
+        if (error) {
+            *error = self.compileError;
+        }
         return;
     }
+    _compiling = NO;
+    
+    GLuint program = _pendingProgram;
+    GLuint vertexShader = _pendingVertexShader;
+    GLuint fragmentShader = _pendingFragmentShader;
+    _pendingProgram = 0;
+    _pendingVertexShader = 0;
+    _pendingFragmentShader = 0;
+    
+    NSInteger errorCode = 0;
+    NSString *errorDescription = nil;
+    if (![self checkShader:vertexShader]) {
+        errorCode = kMJShaderProgramErrorCompilingVertexShader;
+        errorDescription = @"Failed to compile vertex shader.";
+    } else if (![self checkShader:fragmentShader]) {
+        errorCode = kMJShaderProgramErrorCompilingFragmentShader;
+        errorDescription = @"Failed to compile fragment shader.";
+    } else if (![self checkProgram:program]) {
+        errorCode = kMJShaderProgramErrorLinkingShaderProgram;
+        errorDescription = @"Failed to compile shader program.";
+    }
     
     // Release vertex and fragment shaders.
     glDetachShader(program, vertexShader);
@@ -152,38 +510,65 @@ NSString * const MJShaderProgramErrorDomain = @"MJShaderProgramErrorDomain";
     glDetachShader(program, fragmentShader);
     glDeleteShader(fragmentShader);
     
+    if (errorCode != 0) {
+        glDeleteProgram(program);
+        self.compileError = [NSError errorWithDomain:(NSString *)MJShaderProgramErrorDomain
+                                                code:errorCode
+                                            userInfo:@{NSLocalizedDescriptionKey: errorDescription}];
+        if (error) {
+            *error = self.compileError;
+        }
+        return;
+    }
+    
+    [self.binaryCache storeProgram:program
+                      vertexShader:self.vertexShader
+                    fragmentShader:self.fragmentShader
+                        attributes:self.attributes
+                       compileTime:_compileDuration];
+    
+    [self reflectUniforms:program];
     self.program = program;
 }
 
-- (BOOL)compileShader:(GLuint *)shader type:(GLenum)type code:(const char *)sourceCode {
+- (void)finishCompileIfNeeded {
+    if (_compiling) {
+        NSError *error = nil;
+        [self finishCompileWithError:&error];
+        if (error) {
+            NSLog(@"ERROR: %@", error.localizedDescription);
+        }
+    }
+}
+
+- (GLuint)createShaderOfType:(GLenum)type code:(const char *)sourceCode {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &sourceCode, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+- (BOOL)checkShader:(GLuint)shader {
     GLint status;
-    
-    *shader = glCreateShader(type);
-    glShaderSource(*shader, 1, &sourceCode, NULL);
-    glCompileShader(*shader);
-    
-    glGetShaderiv(*shader, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
     if (status == 0) {
         GLint logLength;
-        glGetShaderiv(*shader, GL_INFO_LOG_LENGTH, &logLength);
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
         if (logLength > 0) {
             GLchar *log = (GLchar *)malloc(logLength);
-            glGetShaderInfoLog(*shader, logLength, &logLength, log);
+            glGetShaderInfoLog(shader, logLength, &logLength, log);
             NSLog(@"Shader compile log:\n%s", log);
             free(log);
         }
         
-        glDeleteShader(*shader);
         return NO;
     }
     
     return YES;
 }
 
-- (BOOL)linkProgram:(GLuint)program {
+- (BOOL)checkProgram:(GLuint)program {
     GLint status;
-    glLinkProgram(program);
-    
     glGetProgramiv(program, GL_LINK_STATUS, &status);
     if (status == 0) {
         GLint logLength;
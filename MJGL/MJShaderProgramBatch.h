@@ -0,0 +1,93 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJShaderProgram.h"
+
+/**
+ * Block called when a program of a batch has finished compiling.
+ *
+ * @param program The program that has finished compiling.
+ * @param error Error object if the compilation failed, otherwise nil.
+ */
+typedef void (^MJShaderProgramBatchCompletion)(MJShaderProgram *program, NSError *error);
+
+/**
+ * The MJShaderProgramBatch object compiles many shader programs at once.
+ *
+ * All programs are submitted to the driver up front, so a driver that
+ * supports KHR_parallel_shader_compile can compile them in parallel on
+ * its own threads. The batch is then polled, e.g. once per frame from a
+ * loading screen, and calls the completion block for each program that
+ * has finished, without blocking on programs that are still compiling.
+ *
+ * Without KHR_parallel_shader_compile, polling finishes programs one by
+ * one until its time budget is spent, which spreads the cost of the
+ * compilation over several frames.
+ *
+ * Programs that are used before the batch has finished them are finished
+ * on first use.
+ */
+@interface MJShaderProgramBatch : NSObject
+
+/** The programs of the batch. */
+@property (nonatomic, strong, readonly) NSArray *programs;
+
+/** The number of programs that have not been finished. */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/** YES when all programs have been finished. */
+@property (nonatomic, readonly, getter = isFinished) BOOL finished;
+
+/**
+ * Initialize a batch of programs.
+ *
+ * @param programs Array of MJShaderProgram objects to compile.
+ * @param completion Block called for each finished program, on the thread
+ *                   that polls the batch. May be nil.
+ */
+- (id)initWithPrograms:(NSArray *)programs
+            completion:(MJShaderProgramBatchCompletion)completion;
+
+/**
+ * Submit all programs for compilation. Requires a current OpenGL context.
+ */
+- (void)submit;
+
+/**
+ * Finish the programs that the driver is done with and call the
+ * completion block for them.
+ *
+ * @param timeBudget The maximum time to spend finishing programs. At least
+ *                   one program is finished per call, if one is pending.
+ */
+- (void)pollWithTimeBudget:(NSTimeInterval)timeBudget;
+
+/**
+ * Finish all programs, blocking until the driver is done with them.
+ */
+- (void)waitUntilFinished;
+
+@end
@@ -0,0 +1,109 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJShaderProgramBatch.h"
+
+@implementation MJShaderProgramBatch {
+    MJShaderProgramBatchCompletion _completion;
+    NSMutableArray *_pendingPrograms;
+}
+
+- (id)initWithPrograms:(NSArray *)programs
+            completion:(MJShaderProgramBatchCompletion)completion
+{
+    self = [super init];
+    if (self) {
+        _programs = [NSArray arrayWithArray:programs];
+        _completion = [completion copy];
+        _pendingPrograms = [NSMutableArray arrayWithCapacity:programs.count];
+    }
+    return self;
+}
+
+- (NSUInteger)pendingCount
+{
+    return _pendingPrograms.count;
+}
+
+- (BOOL)isFinished
+{
+    return _pendingPrograms.count == 0;
+}
+
+- (void)submit
+{
+    for (MJShaderProgram *program in _programs) {
+        [program beginCompile];
+        [_pendingPrograms addObject:program];
+    }
+}
+
+- (void)pollWithTimeBudget:(NSTimeInterval)timeBudget
+{
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    BOOL finishedAny = NO;
+    
+    NSUInteger i = 0;
+    while (i < _pendingPrograms.count) {
+        if (finishedAny && CFAbsoluteTimeGetCurrent() - startTime >= timeBudget) {
+            break;
+        }
+        
+        MJShaderProgram *program = _pendingPrograms[i];
+        if (![program isCompileComplete]) {
+            i++;
+            continue;
+        }
+        
+        [_pendingPrograms removeObjectAtIndex:i];
+        [self finishProgram:program];
+        finishedAny = YES;
+    }
+}
+
+- (void)waitUntilFinished
+{
+    while (_pendingPrograms.count > 0) {
+        MJShaderProgram *program = _pendingPrograms[0];
+        [_pendingPrograms removeObjectAtIndex:0];
+        [self finishProgram:program];
+    }
+}
+
+- (void)finishProgram:(MJShaderProgram *)program
+{
+    // The program may already have been finished by first use, in which
+    // case the error is kept by the program.
+    [program finishCompileWithError:NULL];
+    if (_completion) {
+        _completion(program, program.compileError);
+    }
+}
+
+@end
@@ -0,0 +1,110 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+
+/**
+ * The MJShaderProgramBinaryCache object stores linked shader programs as
+ * driver specific binaries on disk, so that later launches can load them
+ * with glProgramBinary instead of compiling and linking the shader sources.
+ *
+ * Binaries are keyed by a hash of the shader sources, the attribute
+ * bindings and the vendor, renderer and version strings of the driver, so
+ * a driver update invalidates the cached binaries. A binary that is missing
+ * or rejected by the driver makes the shader program fall back to
+ * compiling from source, after which the new binary is stored.
+ *
+ * Program binaries are not available with OpenGL ES 2.0 on iOS, or on
+ * drivers that report no binary formats, in which case every lookup is
+ * a miss.
+ */
+@interface MJShaderProgramBinaryCache : NSObject
+
+/** The directory where the binaries are stored. */
+@property (nonatomic, strong, readonly) NSURL *directoryURL;
+
+/** The number of programs loaded from a cached binary. */
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/** The number of programs that had no cached binary. */
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/** The number of cached binaries rejected by the driver. */
+@property (nonatomic, readonly) NSUInteger rejectCount;
+
+/**
+ * Time saved by loading binaries, i.e. the time it took to compile the
+ * programs from source when they were stored, minus the time it took to
+ * load them.
+ */
+@property (nonatomic, readonly) NSTimeInterval timeSaved;
+
+/**
+ * Shared cache stored in the caches directory of the application.
+ */
++ (MJShaderProgramBinaryCache *)sharedCache;
+
+/**
+ * Initialize a binary cache that stores binaries in a directory.
+ * The directory is created if it does not exist.
+ *
+ * @param directoryURL The directory to store binaries in.
+ */
+- (id)initWithDirectoryURL:(NSURL *)directoryURL;
+
+/**
+ * Create a program from a cached binary. Used by MJShaderProgram.
+ *
+ * @return A linked program, or 0 if there was no usable binary.
+ */
+- (GLuint)loadProgramWithVertexShader:(NSString *)vertexShader
+                       fragmentShader:(NSString *)fragmentShader
+                           attributes:(NSArray *)attributes;
+
+/**
+ * Prepare a program that is about to be linked for having its binary
+ * stored. Used by MJShaderProgram.
+ */
+- (void)prepareProgramForLinking:(GLuint)program;
+
+/**
+ * Store the binary of a linked program. Used by MJShaderProgram.
+ *
+ * @param compileTime The time spent in the compile and link calls of the
+ *                    program, not including any wait until the compilation
+ *                    was finished. Used to report the time saved by later
+ *                    loads.
+ */
+- (void)storeProgram:(GLuint)program
+        vertexShader:(NSString *)vertexShader
+      fragmentShader:(NSString *)fragmentShader
+          attributes:(NSArray *)attributes
+         compileTime:(NSTimeInterval)compileTime;
+
+/** Delete all cached binaries. */
+- (void)removeAllBinaries;
+
+@end
@@ -0,0 +1,274 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJShaderProgramBinaryCache.h"
+#import <CommonCrypto/CommonDigest.h>
+
+#define kMJProgramBinaryMagic 0x42504a4d // "MJPB"
+#define kMJProgramBinaryVersion 1
+
+/** Header of a cached program binary file, followed by the binary. */
+typedef struct MJProgramBinaryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t length;
+    double compileTime;
+} MJProgramBinaryHeader;
+
+@implementation MJShaderProgramBinaryCache {
+    NSString *_driverDescription;
+    BOOL _supported;
+}
+
+#pragma mark - Initializing the cache
+
++ (MJShaderProgramBinaryCache *)sharedCache
+{
+    static dispatch_once_t pred;
+    static MJShaderProgramBinaryCache *instance = nil;
+    dispatch_once(&pred, ^{
+        NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory
+                                                                   inDomains:NSUserDomainMask] lastObject];
+        NSURL *directoryURL = [cachesURL URLByAppendingPathComponent:@"MJShaderProgramBinaryCache"
+                                                         isDirectory:YES];
+        instance = [[MJShaderProgramBinaryCache alloc] initWithDirectoryURL:directoryURL];
+    });
+    return instance;
+}
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL
+{
+    self = [super init];
+    if (self) {
+        _directoryURL = directoryURL;
+        
+        NSError *error = nil;
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:directoryURL
+                                      withIntermediateDirectories:YES
+                                                       attributes:nil
+                                                            error:&error]) {
+            NSLog(@"ERROR: %@", error.localizedDescription);
+        }
+    }
+    return self;
+}
+
+#pragma mark - Loading and storing binaries
+
+- (GLuint)loadProgramWithVertexShader:(NSString *)vertexShader
+                       fragmentShader:(NSString *)fragmentShader
+                           attributes:(NSArray *)attributes
+{
+#if TARGET_OS_IPHONE
+    _missCount++;
+    return 0;
+#else
+    if (![self isSupported]) {
+        _missCount++;
+        return 0;
+    }
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    
+    NSURL *url = [self binaryURLForVertexShader:vertexShader
+                                 fragmentShader:fragmentShader
+                                     attributes:attributes];
+    NSData *data = [NSData dataWithContentsOfURL:url
+                                         options:NSDataReadingMappedIfSafe
+                                           error:NULL];
+    if (data == nil) {
+        _missCount++;
+        return 0;
+    }
+    
+    MJProgramBinaryHeader header;
+    if (data.length < sizeof(header)) {
+        [self rejectBinaryAtURL:url];
+        return 0;
+    }
+    memcpy(&header, data.bytes, sizeof(header));
+    if (header.magic != kMJProgramBinaryMagic ||
+        header.version != kMJProgramBinaryVersion ||
+        header.length != data.length - sizeof(header)) {
+        [self rejectBinaryAtURL:url];
+        return 0;
+    }
+    
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format,
+                    (const uint8_t *)data.bytes + sizeof(header),
+                    (GLsizei)header.length);
+    
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == 0) {
+        // E.g. a driver update that didn't change the version string.
+        glDeleteProgram(program);
+        [self rejectBinaryAtURL:url];
+        return 0;
+    }
+    
+    _hitCount++;
+    NSTimeInterval loadTime = CFAbsoluteTimeGetCurrent() - startTime;
+    _timeSaved += MAX(header.compileTime - loadTime, 0.0);
+    return program;
+#endif
+}
+
+- (void)prepareProgramForLinking:(GLuint)program
+{
+#if !TARGET_OS_IPHONE
+    if ([self isSupported]) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+#endif
+}
+
+- (void)storeProgram:(GLuint)program
+        vertexShader:(NSString *)vertexShader
+      fragmentShader:(NSString *)fragmentShader
+          attributes:(NSArray *)attributes
+         compileTime:(NSTimeInterval)compileTime
+{
+#if !TARGET_OS_IPHONE
+    if (![self isSupported]) {
+        return;
+    }
+    
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    
+    NSMutableData *data = [NSMutableData dataWithLength:sizeof(MJProgramBinaryHeader) + length];
+    GLenum format = 0;
+    GLsizei writtenLength = 0;
+    glGetProgramBinary(program, length, &writtenLength, &format,
+                       (uint8_t *)data.mutableBytes + sizeof(MJProgramBinaryHeader));
+    if (writtenLength <= 0) {
+        return;
+    }
+    
+    MJProgramBinaryHeader header;
+    header.magic = kMJProgramBinaryMagic;
+    header.version = kMJProgramBinaryVersion;
+    header.format = format;
+    header.length = (uint32_t)writtenLength;
+    header.compileTime = compileTime;
+    memcpy(data.mutableBytes, &header, sizeof(header));
+    data.length = sizeof(header) + writtenLength;
+    
+    NSURL *url = [self binaryURLForVertexShader:vertexShader
+                                 fragmentShader:fragmentShader
+                                     attributes:attributes];
+    NSError *error = nil;
+    if (![data writeToURL:url options:NSDataWritingAtomic error:&error]) {
+        NSLog(@"ERROR: %@", error.localizedDescription);
+    }
+#endif
+}
+
+- (void)removeAllBinaries
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSArray *urls = [fileManager contentsOfDirectoryAtURL:_directoryURL
+                               includingPropertiesForKeys:nil
+                                                  options:0
+                                                    error:NULL];
+    for (NSURL *url in urls) {
+        [fileManager removeItemAtURL:url error:NULL];
+    }
+}
+
+#pragma mark - Utility methods
+
+- (void)rejectBinaryAtURL:(NSURL *)url
+{
+    _rejectCount++;
+    _missCount++;
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+/**
+ * Checks, once, whether the driver supports any program binary formats.
+ * Expects a current OpenGL context.
+ */
+- (BOOL)isSupported
+{
+    if (_driverDescription == nil) {
+        const char *vendor = (const char *)glGetString(GL_VENDOR);
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        const char *version = (const char *)glGetString(GL_VERSION);
+        _driverDescription = [NSString stringWithFormat:@"%s\n%s\n%s",
+                              vendor ? vendor : "", renderer ? renderer : "",
+                              version ? version : ""];
+        
+#if !TARGET_OS_IPHONE
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        _supported = formatCount > 0;
+#endif
+    }
+    return _supported;
+}
+
+- (NSURL *)binaryURLForVertexShader:(NSString *)vertexShader
+                     fragmentShader:(NSString *)fragmentShader
+                         attributes:(NSArray *)attributes
+{
+    NSString *key = [NSString stringWithFormat:@"%@\x1e%@\x1e%@\x1e%@",
+                     vertexShader, fragmentShader,
+                     [attributes componentsJoinedByString:@","],
+                     _driverDescription];
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(keyData.bytes, (CC_LONG)keyData.length, digest);
+    
+    NSMutableString *fileName = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2 + 4];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [fileName appendFormat:@"%02x", digest[i]];
+    }
+    [fileName appendString:@".bin"];
+    
+    return [_directoryURL URLByAppendingPathComponent:fileName];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %lu hits, %lu misses, %lu rejected, %.1f ms saved>",
+            NSStringFromClass([self class]), (unsigned long)_hitCount,
+            (unsigned long)_missCount, (unsigned long)_rejectCount,
+            _timeSaved * 1000.0];
+}
+
+@end
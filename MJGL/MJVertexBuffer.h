@@ -85,9 +85,31 @@ typedef enum MJVertexBufferUsagePattern
      * common to create two vertex buffers so that one buffer can be filled
      * with data while the other is being rendered.
      */
-    MJVertexBufferChangesEveryFrame = GL_STREAM_DRAW
+    MJVertexBufferChangesEveryFrame = GL_STREAM_DRAW,
+    
+    /**
+     * MJVertexBufferStreamed is like MJVertexBufferChangesEveryFrame, but
+     * the buffer is streamed: it is allocated as a ring of
+     * kMJVertexBufferStreamRegionCount regions, each with room for the
+     * requested number of vertices. The CPU writes into one region per
+     * frame while the GPU may still be reading the previous ones, and a
+     * fence per region makes sure a region is never overwritten before
+     * the GPU is done with it.
+     *
+     * The fences are created by finishFrame, which must be called once
+     * at the end of every frame that draws from the buffer. Each frame
+     * writes all vertices it draws, since the other regions hold the
+     * vertices of earlier frames. See mapNextVertices:firstVertex:.
+     */
+    MJVertexBufferStreamed = 0x10000 | GL_STREAM_DRAW
 } MJVertexBufferUsagePattern;
 
+/**
+ * The number of regions in the ring of a streamed vertex buffer, i.e. the
+ * number of frames the CPU may run ahead of the GPU before it has to wait.
+ */
+#define kMJVertexBufferStreamRegionCount 3
+
 
 #pragma mark - MJVertexBuffer Interface
 
@@ -96,15 +118,50 @@ typedef enum MJVertexBufferUsagePattern
  * "vertex buffer objects" (VBOs). A VBO is a memory buffer, controlled by
  * the OpenGL driver, where vertex data is stored. This allows the OpenGL
  * driver to store vertex data in a suitable area, such as video memory.
+ *
+ * If the vertex declaration is split into several streams, each stream
+ * is stored in a VBO of its own, with its own usage pattern, and the
+ * streamMask property selects the streams that draw calls read from.
  */
 @interface MJVertexBuffer : NSObject
 
 /** The number of vertices in the buffer. */
 @property (nonatomic, readonly) NSUInteger count;
 
-/** The stride, or size, in bytes, of an individual vertex. */
+/**
+ * The stride, or size, in bytes, of an individual vertex in the first
+ * stream, which is the whole vertex unless the declaration has several
+ * streams.
+ */
 @property (nonatomic, readonly) NSUInteger stride;
 
+/** The number of streams, one per stream of the vertex declaration. */
+@property (nonatomic, readonly) NSUInteger streamCount;
+
+/**
+ * Bit mask of the streams that the draw calls bind, where bit n is set
+ * to bind stream n. Defaults to all streams. A pass that only needs some
+ * of the components, e.g. a depth prepass with positions in stream 0,
+ * draws with a mask of only those streams, so that the other streams are
+ * not fetched. A vertex array object is kept per mask that has been used.
+ */
+@property (nonatomic, assign) NSUInteger streamMask;
+
+/**
+ * YES if the buffer was created with the MJVertexBufferStreamed
+ * usage pattern, for any of its streams, and is streamed through a ring of
+ * regions. The count property is then the number of vertices in each region.
+ */
+@property (nonatomic, readonly, getter = isStreaming) BOOL streaming;
+
+/**
+ * The number of times the CPU had to wait for the GPU to finish reading
+ * a region of a streamed buffer before it could be written again.
+ * A steadily increasing value means that the CPU runs more than
+ * kMJVertexBufferStreamRegionCount frames ahead of the GPU.
+ */
+@property (nonatomic, readonly) NSUInteger streamStallCount;
+
 /**
  * The mode the vertex buffer will be drawn in. It specifies how the
  * geometry defined by the vertices will be interpreted. The default is
@@ -112,6 +169,21 @@ typedef enum MJVertexBufferUsagePattern
  */
 @property (nonatomic, assign) MJVertexDrawMode drawMode;
 
+/**
+ * Vertex buffer holding per-instance data for instanced draw calls, e.g.
+ * transforms and colors. Its vertex declaration should consist of
+ * per-instance components in a single stream, which are bound to the
+ * vertex attributes following those of this buffer's declaration.
+ * Setting it to nil disables those vertex attributes again.
+ *
+ * Create the instance buffer with MJVertexBufferStreamed to
+ * stream per-frame instance data: map the instances of a frame with
+ * mapNextVertices:firstVertex: on the instance buffer, pass the first
+ * vertex as the first instance to the instanced draw methods, and call
+ * finishFrame on the instance buffer at the end of the frame.
+ */
+@property (nonatomic, strong) MJVertexBuffer *instanceBuffer;
+
 /**
  * Initialize an empty vertex buffer with room for a number of vertices.
  *
@@ -151,10 +223,111 @@ typedef enum MJVertexBufferUsagePattern
            declaration:(MJVertexDeclaration *)vertexDeclaration
               vertices:(const void *)vertices;
 
+/**
+ * Initialize an empty vertex buffer with a stream for each stream of the
+ * vertex declaration, each with its own usage pattern.
+ *
+ * @param vertexCount The number of vertices that will fit in the buffer.
+ *
+ * @param usagePatterns The usage pattern of each stream, as an array of
+ *                      NSNumber objects with MJVertexBufferUsagePattern
+ *                      values, e.g. a static stream of positions and a
+ *                      stream of colors that changes every frame.
+ *
+ * @param vertexDeclaration Declaration of how the individual vertices
+ *                          in the streams are structured.
+ *
+ * @return The vertex buffer or nil if it could not be created.
+ */
+- (id)initWithCapacity:(NSUInteger)vertexCount
+          streamUsages:(NSArray *)usagePatterns
+           declaration:(MJVertexDeclaration *)vertexDeclaration;
+
+/**
+ * Get the stride, or size in bytes, of a vertex in a stream.
+ *
+ * @param stream Index of the stream.
+ */
+- (NSUInteger)strideOfStream:(NSUInteger)stream;
+
+/**
+ * Copy vertex data into the buffer.
+ *
+ * A streamed buffer can only be rewritten as a whole, once per frame,
+ * since every region of the ring must hold all of its vertices. The
+ * vertices are written into the region of the current frame without
+ * synchronizing with the GPU.
+ *
+ * @param offset Index of the first vertex to replace.
+ * @param vertexCount The number of vertices to copy.
+ * @param vertices A pointer to the vertex data to copy.
+ */
 - (void)setVerticesAtOffset:(NSUInteger)offset
                       count:(NSUInteger)vertexCount
                    vertices:(const void *)vertices;
 
+/**
+ * Copy vertex data into one stream of the buffer, like
+ * setVerticesAtOffset:count:vertices: does for the first stream.
+ *
+ * @param offset Index of the first vertex to replace.
+ * @param vertexCount The number of vertices to copy.
+ * @param vertices A pointer to the vertex data of the stream to copy.
+ * @param stream Index of the stream.
+ */
+- (void)setVerticesAtOffset:(NSUInteger)offset
+                      count:(NSUInteger)vertexCount
+                   vertices:(const void *)vertices
+                     stream:(NSUInteger)stream;
+
+/**
+ * Map room for the next vertices of the current frame in a streamed
+ * buffer, so that they can be written directly into buffer memory.
+ * The returned pointer is valid until unmapVertices is called, which
+ * must happen before the buffer is drawn.
+ *
+ * The vertices are appended after the vertices previously mapped in the
+ * same frame. Draw them by passing the first vertex to one of the draw
+ * methods.
+ *
+ * @param vertexCount The number of vertices to map.
+ * @param firstVertex Set to the index of the first mapped vertex in the
+ *                    region of the current frame.
+ * @return Pointer to write the vertices to, or NULL if the buffer is not
+ *         streamed or the region of the current frame is full.
+ */
+- (void *)mapNextVertices:(NSUInteger)vertexCount
+              firstVertex:(NSUInteger *)firstVertex;
+
+/**
+ * Map room for the next vertices of the current frame in one streamed
+ * stream of the buffer, like mapNextVertices:firstVertex: does for the
+ * first stream. Each stream appends at its own position, so map the same
+ * number of vertices in each streamed stream to keep them in step.
+ *
+ * @param vertexCount The number of vertices to map.
+ * @param firstVertex Set to the index of the first mapped vertex.
+ * @param stream Index of the stream.
+ * @return Pointer to write the vertices of the stream to, or NULL.
+ */
+- (void *)mapNextVertices:(NSUInteger)vertexCount
+              firstVertex:(NSUInteger *)firstVertex
+                   stream:(NSUInteger)stream;
+
+/**
+ * Unmap vertices previously mapped with mapNextVertices:firstVertex:,
+ * in all streams.
+ */
+- (void)unmapVertices;
+
+/**
+ * Mark the end of a frame for a streamed buffer. Call it once per frame,
+ * after the last draw call that reads from the buffer. The next frame
+ * writes into the next region of the ring. Does nothing for buffers that
+ * are not streamed.
+ */
+- (void)finishFrame;
+
 /**
  * Draw the geometry defined by the vertices, interpreted according to
  * the draw mode specified by the drawMode property.
@@ -184,4 +357,71 @@ typedef enum MJVertexBufferUsagePattern
                              count:(NSUInteger)vertexCount
                        indexBuffer:(MJIndexBuffer *)indexBuffer;
 
+/**
+ * Draw the geometry indirectly defined by the index buffer, where the
+ * base vertex is added to each index before the vertex is fetched. This
+ * makes it possible to draw vertices written anywhere in the buffer, e.g.
+ * by mapNextVertices:firstVertex:, with an index buffer that starts at 0.
+ */
+- (void)drawWithFirstVertexAtIndex:(NSUInteger)firstIndex
+                             count:(NSUInteger)vertexCount
+                       indexBuffer:(MJIndexBuffer *)indexBuffer
+                        baseVertex:(NSUInteger)baseVertex;
+
+/**
+ * Draw a number of instances of the geometry defined by the vertices,
+ * with per-instance data from the instance buffer.
+ *
+ * @param instanceCount The number of instances to draw.
+ */
+- (void)drawInstanced:(NSUInteger)instanceCount;
+
+/**
+ * Draw a number of instances of the geometry defined by the vertices,
+ * with per-instance data from the instance buffer.
+ *
+ * @param instanceCount The number of instances to draw.
+ * @param firstInstance Index of the first instance in the instance buffer.
+ */
+- (void)drawInstanced:(NSUInteger)instanceCount
+        firstInstance:(NSUInteger)firstInstance;
+
+/**
+ * Draw a number of instances of the geometry indirectly defined by the
+ * index buffer, with per-instance data from the instance buffer.
+ *
+ * @param indexBuffer The index buffer to draw with.
+ * @param instanceCount The number of instances to draw.
+ */
+- (void)drawWithIndexBuffer:(MJIndexBuffer *)indexBuffer
+                  instanced:(NSUInteger)instanceCount;
+
+/**
+ * Draw a number of instances of the geometry indirectly defined by the
+ * index buffer, with per-instance data from the instance buffer.
+ *
+ * @param indexBuffer The index buffer to draw with.
+ * @param instanceCount The number of instances to draw.
+ * @param firstInstance Index of the first instance in the instance buffer.
+ */
+- (void)drawWithIndexBuffer:(MJIndexBuffer *)indexBuffer
+                  instanced:(NSUInteger)instanceCount
+              firstInstance:(NSUInteger)firstInstance;
+
+/**
+ * Draw a number of instances of the geometry indirectly defined by a range
+ * of the index buffer, with per-instance data from the instance buffer.
+ *
+ * @param firstIndex Index of the first index to draw in the index buffer.
+ * @param vertexCount The number of indices to draw.
+ * @param indexBuffer The index buffer to draw with.
+ * @param instanceCount The number of instances to draw.
+ * @param firstInstance Index of the first instance in the instance buffer.
+ */
+- (void)drawWithFirstVertexAtIndex:(NSUInteger)firstIndex
+                             count:(NSUInteger)vertexCount
+                       indexBuffer:(MJIndexBuffer *)indexBuffer
+                         instanced:(NSUInteger)instanceCount
+                     firstInstance:(NSUInteger)firstInstance;
+
 @end
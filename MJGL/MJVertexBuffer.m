@@ -27,14 +27,46 @@
 #endif
 
 #import "MJVertexBuffer.h"
+#import "MJGLStateCache.h"
+
+/** A VBO holding one stream of the vertex declaration. */
+typedef struct MJVertexStream {
+    GLuint bufferId;
+    NSUInteger stride;
+    BOOL streaming;
+    NSUInteger streamCursor;
+    void *mappedVertices;
+} MJVertexStream;
+
+/**
+ * A vertex array object binding the streams of a stream mask, with the
+ * offsets its attribute pointers were last applied at.
+ */
+typedef struct MJVertexArray {
+    GLuint arrayObjectId;
+    NSUInteger appliedBaseVertex;
+    NSUInteger appliedRegion;
+    NSUInteger appliedBaseInstance;
+} MJVertexArray;
 
 @interface MJVertexBuffer ()
 @property (nonatomic, strong) MJVertexDeclaration *vertexDeclaration;
+@property (nonatomic, readonly) GLuint bufferId;
+- (id)initWithCapacity:(NSUInteger)vertexCount
+          streamUsages:(NSArray *)usagePatterns
+           declaration:(MJVertexDeclaration *)vertexDeclaration
+              vertices:(const void *)vertices;
+- (NSUInteger)streamBaseVertex;
 @end
 
 @implementation MJVertexBuffer {
-    GLuint _bufferId;
-    uint32_t _arrayObjectId;
+    MJVertexStream _streams[kMJVertexDeclarationMaxStreamCount];
+    MJVertexArray _vertexArrays[1 << kMJVertexDeclarationMaxStreamCount];
+    NSUInteger _allStreamsMask;
+    
+    // Streaming state, only used by MJVertexBufferStreamed streams.
+    GLsync _regionFences[kMJVertexBufferStreamRegionCount];
+    NSUInteger _region;
 }
 
 #pragma mark - Initializing/destroying the vertex buffer
@@ -54,6 +86,38 @@
            declaration:(MJVertexDeclaration *)vertexDeclaration
               vertices:(const void *)vertices
 {
+    NSMutableArray *usagePatterns = [NSMutableArray array];
+    for (NSUInteger i = 0; i < vertexDeclaration.streamCount; i++) {
+        [usagePatterns addObject:@(usagePattern)];
+    }
+    return [self initWithCapacity:vertexCount
+                     streamUsages:usagePatterns
+                      declaration:vertexDeclaration
+                         vertices:vertices];
+}
+
+- (id)initWithCapacity:(NSUInteger)vertexCount
+          streamUsages:(NSArray *)usagePatterns
+           declaration:(MJVertexDeclaration *)vertexDeclaration
+{
+    return [self initWithCapacity:vertexCount
+                     streamUsages:usagePatterns
+                      declaration:vertexDeclaration
+                         vertices:(const void *)0];
+}
+
+- (id)initWithCapacity:(NSUInteger)vertexCount
+          streamUsages:(NSArray *)usagePatterns
+           declaration:(MJVertexDeclaration *)vertexDeclaration
+              vertices:(const void *)vertices
+{
+    if (usagePatterns.count != vertexDeclaration.streamCount) {
+        NSLog(@"ERROR: %lu usage patterns for %lu vertex streams.",
+              (unsigned long)usagePatterns.count,
+              (unsigned long)vertexDeclaration.streamCount);
+        return nil;
+    }
+    
     self = [super init];
 	if (self)
 	{
@@ -61,22 +125,51 @@
 		self.vertexDeclaration = vertexDeclaration;
 		_count = vertexCount;
 		_stride = vertexDeclaration.stride;
-		_bufferId = GL_INVALID_VALUE;
+        _streamCount = vertexDeclaration.streamCount;
+        _allStreamsMask = (1 << _streamCount) - 1;
+        _streamMask = _allStreamsMask;
 		
-        glGenVertexArraysMJ(1, &_arrayObjectId);
-        glBindVertexArrayMJ(_arrayObjectId);
+        MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
         
-		glGenBuffers(1, &_bufferId);
-		glBindBuffer(GL_ARRAY_BUFFER, _bufferId);
-		
-        [self.vertexDeclaration apply];
+        for (NSUInteger i = 0; i < _streamCount; i++) {
+            MJVertexStream *stream = &_streams[i];
+            GLenum usage = (GLenum)[usagePatterns[i] unsignedIntValue];
+            stream->stride = [vertexDeclaration strideOfStream:i];
+            stream->streaming = (usage == MJVertexBufferStreamed);
+            _streaming = _streaming || stream->streaming;
+            
+            // Initial vertices are only given for single stream buffers.
+            const void *streamVertices = (i == 0) ? vertices : NULL;
+            
+            glGenBuffers(1, &stream->bufferId);
+            [stateCache bindBuffer:stream->bufferId target:GL_ARRAY_BUFFER];
+            
+            if (stream->streaming) {
+                // Allocate the whole ring, the first region is the current
+                // one. Initial vertices go into every region, so that the
+                // buffer draws the same whichever region is current.
+                GLsizeiptr regionSize = _count * stream->stride;
+                glBufferData(GL_ARRAY_BUFFER, regionSize * kMJVertexBufferStreamRegionCount,
+                             NULL, GL_STREAM_DRAW);
+                if (streamVertices) {
+                    for (NSUInteger region = 0; region < kMJVertexBufferStreamRegionCount; region++) {
+                        glBufferSubData(GL_ARRAY_BUFFER, region * regionSize, regionSize,
+                                        streamVertices);
+                    }
+                    stream->streamCursor = _count;
+                }
+            } else {
+                glBufferData(GL_ARRAY_BUFFER, _count * stream->stride, streamVertices, usage);
+            }
+        }
         
-        glBufferData(GL_ARRAY_BUFFER, _count * _stride, vertices,
-                     (GLenum)usagePattern);
+        // Create the vertex array object of all streams up front, the
+        // ones of other masks are created when they are first drawn with.
+        [self bindVertexArrayForStreams:_allStreamsMask];
         
-        // Bind back to default state
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArrayMJ(0);
+        // Unbind the vertex array object so that later buffer binds,
+        // e.g. of index buffers, don't modify it.
+        [stateCache bindVertexArray:0];
 	}
 	
 	return self;
@@ -84,9 +177,33 @@
 
 - (void)dealloc
 {
-    glDeleteVertexArraysMJ(1, &_arrayObjectId);
-	glDeleteBuffers(1, &_bufferId);
-	_bufferId = GL_INVALID_VALUE;
+    for (NSUInteger i = 0; i < kMJVertexBufferStreamRegionCount; i++) {
+        if (_regionFences[i]) {
+            glDeleteSyncMJ(_regionFences[i]);
+        }
+    }
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    for (NSUInteger mask = 0; mask <= _allStreamsMask; mask++) {
+        if (_vertexArrays[mask].arrayObjectId != 0) {
+            glDeleteVertexArraysMJ(1, &_vertexArrays[mask].arrayObjectId);
+            [stateCache didDeleteVertexArray:_vertexArrays[mask].arrayObjectId];
+        }
+    }
+    for (NSUInteger i = 0; i < _streamCount; i++) {
+        glDeleteBuffers(1, &_streams[i].bufferId);
+        [stateCache didDeleteBuffer:_streams[i].bufferId];
+        _streams[i].bufferId = GL_INVALID_VALUE;
+    }
+}
+
+- (GLuint)bufferId
+{
+    return _streams[0].bufferId;
+}
+
+- (NSUInteger)strideOfStream:(NSUInteger)stream
+{
+    return stream < _streamCount ? _streams[stream].stride : 0;
 }
 
 #pragma mark - Modifying the vertex buffer
@@ -95,21 +212,196 @@
                       count:(NSUInteger)vertexCount
                    vertices:(const void *)vertices
 {
-	glBindBuffer(GL_ARRAY_BUFFER, _bufferId);
-	glBufferSubData(GL_ARRAY_BUFFER, offset * _stride, vertexCount * _stride,
+    [self setVerticesAtOffset:offset count:vertexCount vertices:vertices stream:0];
+}
+
+- (void)setVerticesAtOffset:(NSUInteger)offset
+                      count:(NSUInteger)vertexCount
+                   vertices:(const void *)vertices
+                     stream:(NSUInteger)streamIndex
+{
+    if (streamIndex >= _streamCount) {
+        NSLog(@"WARNING: No vertex stream %lu.", (unsigned long)streamIndex);
+        return;
+    }
+    
+    MJVertexStream *stream = &_streams[streamIndex];
+    if (stream->streaming) {
+        [self streamVerticesAtOffset:offset count:vertexCount vertices:vertices stream:streamIndex];
+        return;
+    }
+    
+    [[MJGLStateCache currentStateCache] bindBuffer:stream->bufferId target:GL_ARRAY_BUFFER];
+	glBufferSubData(GL_ARRAY_BUFFER, offset * stream->stride, vertexCount * stream->stride,
                     vertices);
 }
 
+#pragma mark - Streaming
+
+- (void)streamVerticesAtOffset:(NSUInteger)offset
+                         count:(NSUInteger)vertexCount
+                      vertices:(const void *)vertices
+                        stream:(NSUInteger)streamIndex
+{
+    // A partial update would leave the other regions of the ring with
+    // stale vertices, and a second update in the same frame would
+    // overwrite vertices that the GPU may still read.
+    MJVertexStream *stream = &_streams[streamIndex];
+    if (offset != 0 || vertexCount != _count) {
+        NSLog(@"WARNING: Streamed vertex buffers can only be rewritten as a whole.");
+        return;
+    }
+    if (stream->streamCursor != 0) {
+        NSLog(@"WARNING: Streamed vertex buffer already written this frame, call finishFrame first.");
+        return;
+    }
+    
+    void *destination = [self mapRegionAtOffset:offset count:vertexCount stream:streamIndex];
+    if (destination) {
+        memcpy(destination, vertices, vertexCount * stream->stride);
+        [self unmapStream:streamIndex];
+        stream->streamCursor = _count;
+    }
+}
+
+- (void *)mapNextVertices:(NSUInteger)vertexCount
+              firstVertex:(NSUInteger *)firstVertex
+{
+    return [self mapNextVertices:vertexCount firstVertex:firstVertex stream:0];
+}
+
+- (void *)mapNextVertices:(NSUInteger)vertexCount
+              firstVertex:(NSUInteger *)firstVertex
+                   stream:(NSUInteger)streamIndex
+{
+    if (streamIndex >= _streamCount || !_streams[streamIndex].streaming) {
+        NSLog(@"WARNING: Only streamed vertex buffers can be mapped.");
+        return NULL;
+    }
+    
+    MJVertexStream *stream = &_streams[streamIndex];
+    if (stream->streamCursor + vertexCount > _count) {
+        NSLog(@"WARNING: Stream region is full, %lu of %lu vertices used.",
+              (unsigned long)stream->streamCursor, (unsigned long)_count);
+        return NULL;
+    }
+    
+    NSUInteger first = stream->streamCursor;
+    void *destination = [self mapRegionAtOffset:first count:vertexCount stream:streamIndex];
+    if (destination) {
+        stream->streamCursor += vertexCount;
+        if (firstVertex) {
+            *firstVertex = first;
+        }
+    }
+    
+    return destination;
+}
+
+- (void *)mapRegionAtOffset:(NSUInteger)offset
+                      count:(NSUInteger)vertexCount
+                     stream:(NSUInteger)streamIndex
+{
+    MJVertexStream *stream = &_streams[streamIndex];
+    NSAssert(stream->mappedVertices == NULL, @"Vertex stream is already mapped.");
+    
+    [self waitForCurrentRegion];
+    
+    // The fence of the region guarantees that the GPU is done with it,
+    // so the driver does not have to synchronize or copy anything.
+    GLintptr byteOffset = (GLintptr)((_region * _count + offset) * stream->stride);
+    GLsizeiptr byteCount = (GLsizeiptr)(vertexCount * stream->stride);
+    [[MJGLStateCache currentStateCache] bindBuffer:stream->bufferId target:GL_ARRAY_BUFFER];
+    stream->mappedVertices = glMapBufferRangeMJ(GL_ARRAY_BUFFER, byteOffset, byteCount,
+                                                GL_MAP_WRITE_BIT |
+                                                GL_MAP_INVALIDATE_RANGE_BIT |
+                                                GL_MAP_UNSYNCHRONIZED_BIT);
+    if (stream->mappedVertices == NULL) {
+        NSLog(@"GL ERROR: %d", glGetError());
+    }
+    
+    return stream->mappedVertices;
+}
+
+- (void)unmapStream:(NSUInteger)streamIndex
+{
+    MJVertexStream *stream = &_streams[streamIndex];
+    if (stream->mappedVertices) {
+        [[MJGLStateCache currentStateCache] bindBuffer:stream->bufferId target:GL_ARRAY_BUFFER];
+        glUnmapBufferMJ(GL_ARRAY_BUFFER);
+        stream->mappedVertices = NULL;
+    }
+}
+
+- (void)unmapVertices
+{
+    for (NSUInteger i = 0; i < _streamCount; i++) {
+        [self unmapStream:i];
+    }
+}
+
+- (void)finishFrame
+{
+    if (!_streaming) {
+        return;
+    }
+    
+    [self unmapVertices];
+    
+    // One fence covers the region of the frame in all streams.
+    if (_regionFences[_region]) {
+        glDeleteSyncMJ(_regionFences[_region]);
+    }
+    _regionFences[_region] = glFenceSyncMJ(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    
+    _region = (_region + 1) % kMJVertexBufferStreamRegionCount;
+    for (NSUInteger i = 0; i < _streamCount; i++) {
+        _streams[i].streamCursor = 0;
+    }
+}
+
+- (void)waitForCurrentRegion
+{
+    GLsync fence = _regionFences[_region];
+    if (fence == NULL) {
+        return;
+    }
+    
+    GLenum result = glClientWaitSyncMJ(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        _streamStallCount++;
+        do {
+            result = glClientWaitSyncMJ(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                        1000000000ull);
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    if (result == GL_WAIT_FAILED) {
+        NSLog(@"GL ERROR: %d", glGetError());
+    }
+    
+    glDeleteSyncMJ(fence);
+    _regionFences[_region] = NULL;
+}
+
+- (NSUInteger)streamBaseVertex
+{
+    return [self baseVertexOfStream:0];
+}
+
+- (NSUInteger)baseVertexOfStream:(NSUInteger)streamIndex
+{
+    return _streams[streamIndex].streaming ? _region * _count : 0;
+}
+
 #pragma mark - Drawing
 
 - (void)drawWithFirstVertexAtIndex:(NSUInteger)firstIndex
                              count:(NSUInteger)vertexCount
 {
-    glBindVertexArrayMJ(_arrayObjectId);
-	glBindBuffer(GL_ARRAY_BUFFER, _bufferId);
+    [self bindVertexArrayWithBaseVertex:0];
     GLenum drawMode = [self drawModeAsGLConstant];
 	glDrawArrays(drawMode, (GLint)firstIndex, (GLint)vertexCount);
-    glBindVertexArrayMJ(0);
+    [self unbindVertexArray];
 }
 
 - (void)drawWithIndexBuffer:(MJIndexBuffer *)indexBuffer
@@ -121,26 +413,223 @@
                              count:(NSUInteger)vertexCount
                        indexBuffer:(MJIndexBuffer *)indexBuffer
 {
-    glBindVertexArrayMJ(_arrayObjectId);
-	glBindBuffer(GL_ARRAY_BUFFER, _bufferId);
+    [self drawWithFirstVertexAtIndex:firstIndex
+                               count:vertexCount
+                         indexBuffer:indexBuffer
+                          baseVertex:0];
+}
+
+- (void)drawWithFirstVertexAtIndex:(NSUInteger)firstIndex
+                             count:(NSUInteger)vertexCount
+                       indexBuffer:(MJIndexBuffer *)indexBuffer
+                        baseVertex:(NSUInteger)baseVertex
+{
+    [self bindVertexArrayWithBaseVertex:baseVertex];
     [indexBuffer bind];
     GLenum drawMode = [self drawModeAsGLConstant];
-	glDrawElements(drawMode, (GLint)vertexCount, GL_UNSIGNED_SHORT,
-				   (GLvoid *)(firstIndex * sizeof(GLushort)));
-    glBindVertexArrayMJ(0);
+	glDrawElements(drawMode, (GLint)vertexCount, (GLenum)indexBuffer.type,
+				   (GLvoid *)(firstIndex * indexBuffer.indexSize));
+    [self unbindVertexArray];
 }
 
 - (void)draw
 {
-    glBindVertexArrayMJ(_arrayObjectId);
-	glBindBuffer(GL_ARRAY_BUFFER, _bufferId);
+    [self drawWithFirstVertexAtIndex:0 count:_count];
+}
+
+#pragma mark - Instanced drawing
+
+- (void)setInstanceBuffer:(MJVertexBuffer *)instanceBuffer
+{
+    MJVertexBuffer *previousInstanceBuffer = _instanceBuffer;
+    _instanceBuffer = instanceBuffer;
+    
+    GLuint firstAttribute = (GLuint)self.vertexDeclaration.attributeCount;
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    for (NSUInteger mask = 0; mask <= _allStreamsMask; mask++) {
+        MJVertexArray *vertexArray = &_vertexArrays[mask];
+        if (vertexArray->arrayObjectId == 0) {
+            continue;
+        }
+        [stateCache bindVertexArray:vertexArray->arrayObjectId];
+        
+        // Otherwise non-instanced draws would still read per-instance
+        // data from the previous instance buffer.
+        [previousInstanceBuffer.vertexDeclaration disableAttributesFromAttribute:firstAttribute];
+        [self attachInstanceBufferToVertexArray:vertexArray];
+    }
+    [stateCache bindVertexArray:0];
+}
+
+- (void)drawInstanced:(NSUInteger)instanceCount
+{
+    [self drawInstanced:instanceCount firstInstance:0];
+}
+
+- (void)drawInstanced:(NSUInteger)instanceCount
+        firstInstance:(NSUInteger)firstInstance
+{
+    if (_instanceBuffer == nil) {
+        NSLog(@"WARNING: Instanced drawing requires an instance buffer.");
+        return;
+    }
+    
+    MJVertexArray *vertexArray = [self bindVertexArrayWithBaseVertex:0];
+    [self applyBaseInstance:firstInstance toVertexArray:vertexArray];
     GLenum drawMode = [self drawModeAsGLConstant];
-	glDrawArrays(drawMode, 0, (GLsizei)_count);
-    glBindVertexArrayMJ(0);
+    glDrawArraysInstancedMJ(drawMode, 0, (GLsizei)_count, (GLsizei)instanceCount);
+    [self unbindVertexArray];
+}
+
+- (void)drawWithIndexBuffer:(MJIndexBuffer *)indexBuffer
+                  instanced:(NSUInteger)instanceCount
+{
+    [self drawWithIndexBuffer:indexBuffer
+                    instanced:instanceCount
+                firstInstance:0];
+}
+
+- (void)drawWithIndexBuffer:(MJIndexBuffer *)indexBuffer
+                  instanced:(NSUInteger)instanceCount
+              firstInstance:(NSUInteger)firstInstance
+{
+    [self drawWithFirstVertexAtIndex:0
+                               count:indexBuffer.count
+                         indexBuffer:indexBuffer
+                           instanced:instanceCount
+                       firstInstance:firstInstance];
+}
+
+- (void)drawWithFirstVertexAtIndex:(NSUInteger)firstIndex
+                             count:(NSUInteger)vertexCount
+                       indexBuffer:(MJIndexBuffer *)indexBuffer
+                         instanced:(NSUInteger)instanceCount
+                     firstInstance:(NSUInteger)firstInstance
+{
+    if (_instanceBuffer == nil) {
+        NSLog(@"WARNING: Instanced drawing requires an instance buffer.");
+        return;
+    }
+    
+    MJVertexArray *vertexArray = [self bindVertexArrayWithBaseVertex:0];
+    [self applyBaseInstance:firstInstance toVertexArray:vertexArray];
+    [indexBuffer bind];
+    GLenum drawMode = [self drawModeAsGLConstant];
+    glDrawElementsInstancedMJ(drawMode, (GLsizei)vertexCount,
+                              (GLenum)indexBuffer.type,
+                              (GLvoid *)(firstIndex * indexBuffer.indexSize),
+                              (GLsizei)instanceCount);
+    [self unbindVertexArray];
 }
 
 #pragma mark - Utility methods
 
+/**
+ * Bind the vertex array object of a stream mask, creating it the first
+ * time the mask is used.
+ */
+- (MJVertexArray *)bindVertexArrayForStreams:(NSUInteger)mask
+{
+    mask &= _allStreamsMask;
+    if (mask == 0) {
+        mask = _allStreamsMask;
+    }
+    
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    MJVertexArray *vertexArray = &_vertexArrays[mask];
+    if (vertexArray->arrayObjectId != 0) {
+        [stateCache bindVertexArray:vertexArray->arrayObjectId];
+        return vertexArray;
+    }
+    
+    glGenVertexArraysMJ(1, &vertexArray->arrayObjectId);
+    [stateCache bindVertexArray:vertexArray->arrayObjectId];
+    for (NSUInteger i = 0; i < _streamCount; i++) {
+        if (mask & (1 << i)) {
+            [stateCache bindBuffer:_streams[i].bufferId target:GL_ARRAY_BUFFER];
+            [self.vertexDeclaration applyStream:i atOffset:0 firstAttribute:0];
+        }
+    }
+    vertexArray->appliedBaseVertex = 0;
+    vertexArray->appliedRegion = 0;
+    
+    if (_instanceBuffer) {
+        [self attachInstanceBufferToVertexArray:vertexArray];
+    }
+    
+    return vertexArray;
+}
+
+/**
+ * Bind the vertex array object of the stream mask and apply a base vertex.
+ * Base vertices are applied by offsetting the attribute pointers of the
+ * vertex array object, since glDrawElementsBaseVertex is not available
+ * on OpenGL ES. The offset of a streamed stream also includes the region
+ * of the current frame.
+ */
+- (MJVertexArray *)bindVertexArrayWithBaseVertex:(NSUInteger)baseVertex
+{
+    MJVertexArray *vertexArray = [self bindVertexArrayForStreams:_streamMask];
+    NSUInteger region = _streaming ? _region : 0;
+    if (baseVertex != vertexArray->appliedBaseVertex || region != vertexArray->appliedRegion) {
+        MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+        NSUInteger mask = vertexArray - _vertexArrays;
+        for (NSUInteger i = 0; i < _streamCount; i++) {
+            if (mask & (1 << i)) {
+                [stateCache bindBuffer:_streams[i].bufferId target:GL_ARRAY_BUFFER];
+                NSUInteger offset = ([self baseVertexOfStream:i] + baseVertex) * _streams[i].stride;
+                [self.vertexDeclaration applyStream:i atOffset:offset firstAttribute:0];
+            }
+        }
+        vertexArray->appliedBaseVertex = baseVertex;
+        vertexArray->appliedRegion = region;
+    }
+    return vertexArray;
+}
+
+/**
+ * Unbind the vertex array object after a draw, so that buffers bound to
+ * GL_ELEMENT_ARRAY_BUFFER later on, by MJGL, GLKit or application code,
+ * don't replace the index buffer of the vertex array object.
+ */
+- (void)unbindVertexArray
+{
+    [[MJGLStateCache currentStateCache] bindVertexArray:0];
+}
+
+/** Expects the vertex array object to be bound. */
+- (void)attachInstanceBufferToVertexArray:(MJVertexArray *)vertexArray
+{
+    if (_instanceBuffer) {
+        [[MJGLStateCache currentStateCache] bindBuffer:_instanceBuffer.bufferId
+                                                target:GL_ARRAY_BUFFER];
+        [_instanceBuffer.vertexDeclaration applyAtOffset:0
+                                          firstAttribute:(GLuint)self.vertexDeclaration.attributeCount];
+    }
+    vertexArray->appliedBaseInstance = 0;
+}
+
+/**
+ * Like base vertices, the first instance is applied by offsetting the
+ * attribute pointers of the instance buffer, since base instances are
+ * not available on OpenGL ES. Expects the vertex array object to be bound.
+ */
+- (void)applyBaseInstance:(NSUInteger)firstInstance toVertexArray:(MJVertexArray *)vertexArray
+{
+    if (_instanceBuffer == nil) {
+        return;
+    }
+    
+    NSUInteger baseInstance = [_instanceBuffer streamBaseVertex] + firstInstance;
+    if (baseInstance != vertexArray->appliedBaseInstance) {
+        [[MJGLStateCache currentStateCache] bindBuffer:_instanceBuffer.bufferId
+                                                target:GL_ARRAY_BUFFER];
+        [_instanceBuffer.vertexDeclaration applyAtOffset:baseInstance * _instanceBuffer.stride
+                                          firstAttribute:(GLuint)self.vertexDeclaration.attributeCount];
+        vertexArray->appliedBaseInstance = baseInstance;
+    }
+}
+
 - (GLenum)drawModeAsGLConstant
 {
     GLenum mode;
@@ -24,6 +24,9 @@
 
 #import "MJGL.h"
 
+/** The maximum number of buffer streams a vertex declaration can span. */
+#define kMJVertexDeclarationMaxStreamCount 4
+
 /**
  * The MJVertexDeclaration object wraps OpenGL calls for defining the structure
  * of a vertex. Each vertex consists of a number of components.
@@ -31,20 +34,94 @@
  * When a vertex buffer is about to be rendered, it applies the vertex
  * declaration so that the rendering pipeline knows how to interpret
  * the vertex data.
+ *
+ * The components are interleaved in one buffer stream by default. A
+ * declaration can also be split into several streams with beginNextStream,
+ * each stored in a buffer of its own, e.g. positions in stream 0 and all
+ * other components in stream 1, so that passes that only need positions,
+ * such as depth prepasses and shadow passes, fetch only those bytes.
  */
 @interface MJVertexDeclaration : NSObject
 
 /**
- * The stride, or size in bytes, of an individual vertex.
+ * The stride, or size in bytes, of an individual vertex in the first
+ * stream, which is the whole vertex unless the declaration is split into
+ * several streams.
  */
 @property (nonatomic, readonly) NSUInteger stride;
 
+/** The number of buffer streams the components are stored in. */
+@property (nonatomic, readonly) NSUInteger streamCount;
+
+/**
+ * The number of vertex attributes used by the components.
+ */
+@property (nonatomic, readonly) NSUInteger attributeCount;
+
+/**
+ * Get the stride, or size in bytes, of a vertex in a stream.
+ *
+ * @param stream Index of the stream.
+ */
+- (NSUInteger)strideOfStream:(NSUInteger)stream;
+
+/**
+ * Start the next buffer stream. Components added afterwards are stored
+ * in the next stream, but keep consecutive vertex attributes.
+ */
+- (void)beginNextStream;
+
 /**
  * Apply the vertex declaration so that the rendering pipeline knows
- * how to interpret the vertex data in the vertex buffer.
+ * how to interpret the vertex data in the vertex buffer. Applies the
+ * components of all streams to the bound buffer, so it is only meant for
+ * declarations with one stream.
  */
 - (void)apply;
 
+/**
+ * Apply the vertex declaration with the offsets of all components shifted
+ * by a number of bytes, so that the first vertex is read from that offset
+ * in the vertex buffer.
+ *
+ * @param offset The offset in bytes of the first vertex.
+ */
+- (void)applyAtOffset:(NSUInteger)offset;
+
+/**
+ * Apply the vertex declaration with the offsets of all components shifted
+ * by a number of bytes, binding the components to consecutive vertex
+ * attributes starting at the specified attribute. Used to apply the
+ * declaration of an instance buffer after the declaration of the vertex
+ * buffer it is drawn with.
+ *
+ * @param offset The offset in bytes of the first vertex.
+ * @param firstAttribute The vertex attribute of the first component.
+ */
+- (void)applyAtOffset:(NSUInteger)offset firstAttribute:(GLuint)firstAttribute;
+
+/**
+ * Disable the vertex attributes that applyAtOffset:firstAttribute: enabled
+ * and reset their divisors to 0, e.g. when the instance buffer of a vertex
+ * array object is removed.
+ *
+ * @param firstAttribute The vertex attribute of the first component.
+ */
+- (void)disableAttributesFromAttribute:(GLuint)firstAttribute;
+
+/**
+ * Apply the components of one stream, reading them from the buffer bound
+ * to GL_ARRAY_BUFFER.
+ *
+ * @param stream Index of the stream.
+ * @param offset The offset in bytes of the first vertex in the stream.
+ * @param firstAttribute The vertex attribute of the first component of
+ *                       the declaration.
+ */
+- (void)applyStream:(NSUInteger)stream
+           atOffset:(NSUInteger)offset
+     firstAttribute:(GLuint)firstAttribute;
+
 /**
  * Add a floating point component. The component may consist of one
  * or more floats. For example, the position vector component in 3D space
@@ -54,6 +131,17 @@
  */
 - (void)addFloatComponentOfCount:(GLint)count;
 
+/**
+ * Add a floating point component that advances per instance rather than
+ * per vertex. For example, a per-instance transform matrix consists of
+ * four components of four floats each.
+ *
+ * @param The number of floats in the component.
+ * @param divisor The number of instances drawn before the component
+ *                advances to the next element, usually 1.
+ */
+- (void)addFloatComponentOfCount:(GLint)count divisor:(GLuint)divisor;
+
 /**
  * Add an unsigned byte component, usually an RGB(A) color.
  *
@@ -68,6 +156,17 @@
  */
 - (void)addNormalizedUnsignedByteComponentOfCount:(GLint)count;
 
+/**
+ * Add a normalized unsigned byte component that advances per instance
+ * rather than per vertex, usually a per-instance RGBA color.
+ *
+ * @param The number of normalized unsigned bytes in the component.
+ * @param divisor The number of instances drawn before the component
+ *                advances to the next element, usually 1.
+ */
+- (void)addNormalizedUnsignedByteComponentOfCount:(GLint)count
+                                          divisor:(GLuint)divisor;
+
 /**
  * Add a normalized unsigned short component.
  *
@@ -75,4 +174,46 @@
  */
 - (void)addNormalizedUnsignedShortComponentOfCount:(GLint)count;
 
+/**
+ * Add a normalized signed byte component, mapping -127 to 127 to -1 to 1
+ * by c / 127, with -128 clamped to -1. This is the rule of OpenGL 4.2 and
+ * OpenGL ES 3.0 that the converters of MJVertexPacking.h encode for.
+ * Older specifications also allow (2c + 1) / 255, which reads every
+ * value up to half a step higher.
+ *
+ * @param The number of normalized signed bytes in the component.
+ */
+- (void)addNormalizedByteComponentOfCount:(GLint)count;
+
+/**
+ * Add a normalized signed short component, mapping -32767 to 32767 to
+ * -1 to 1 by c / 32767, like the signed bytes above. For example,
+ * an octahedral encoded normal consists of two normalized shorts, see
+ * MJEncodeOctahedralNormals.
+ *
+ * @param The number of normalized signed shorts in the component.
+ */
+- (void)addNormalizedShortComponentOfCount:(GLint)count;
+
+/**
+ * Add a half float component, e.g. a position or texture coordinates with
+ * half the size of floats. See MJConvertFloatsToHalfFloats.
+ *
+ * @param The number of half floats in the component.
+ */
+- (void)addHalfFloatComponentOfCount:(GLint)count;
+
+#if !TARGET_OS_IPHONE
+/**
+ * Add a normalized signed 10_10_10_2 component, which packs a normal or a
+ * tangent with its handedness into four bytes. See MJPackVectors1010102.
+ * The components convert like the signed bytes above, x, y and z by
+ * c / 511 and the 2-bit w by c / 1, so w is one of -1, 0 and 1.
+ *
+ * NOTE: OS X only! OpenGL ES 2 has no packed vertex formats, so use
+ * octahedral normals on iOS.
+ */
+- (void)addPackedNormalComponent;
+#endif
+
 @end
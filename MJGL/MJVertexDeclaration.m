@@ -36,37 +36,156 @@
 @property (nonatomic, assign) GLsizei stride;
 @property (nonatomic, assign) const GLvoid *offset;
 @property (nonatomic, assign) GLuint attribute;
+@property (nonatomic, assign) GLuint divisor;
+@property (nonatomic, assign) NSUInteger stream;
 @end
 @implementation MJVertexDeclarationComponent
 @end
 
+/** Size in bytes of a component of a type. */
+static GLsizei MJVertexComponentSize(GLenum type, GLint count)
+{
+    switch (type)
+    {
+        case GL_FLOAT:
+            return count * sizeof(GLfloat);
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return count * sizeof(GLubyte);
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return count * sizeof(GLushort);
+#if !TARGET_OS_IPHONE
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+            return count * sizeof(GLuint);
+        case GL_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+            // All four components are packed into one word.
+            return sizeof(GLuint);
+#endif
+        default:
+            NSLog(@"ERROR: Unsupported vertex component type %d.", type);
+            return 0;
+    }
+}
+
 
 
 @interface MJVertexDeclaration ()
 @property (nonatomic, strong) NSMutableArray *components;
-@property (nonatomic, readwrite) NSUInteger stride;
 
 @end
 
-@implementation MJVertexDeclaration
+@implementation MJVertexDeclaration {
+    NSUInteger _streamStrides[kMJVertexDeclarationMaxStreamCount];
+    NSUInteger _currentStream;
+}
+
+- (NSUInteger)stride
+{
+    return _streamStrides[0];
+}
+
+- (NSUInteger)streamCount
+{
+    return _currentStream + 1;
+}
+
+- (NSUInteger)strideOfStream:(NSUInteger)stream
+{
+    return stream <= _currentStream ? _streamStrides[stream] : 0;
+}
+
+- (void)beginNextStream
+{
+    if (_currentStream + 1 >= kMJVertexDeclarationMaxStreamCount) {
+        NSLog(@"ERROR: Vertex declarations can have at most %d streams.",
+              kMJVertexDeclarationMaxStreamCount);
+        return;
+    }
+    _currentStream++;
+}
 
 - (void)apply
+{
+    [self applyAtOffset:0];
+}
+
+- (void)applyAtOffset:(NSUInteger)offset
+{
+    [self applyAtOffset:offset firstAttribute:0];
+}
+
+- (void)applyAtOffset:(NSUInteger)offset firstAttribute:(GLuint)firstAttribute
+{
+    for (MJVertexDeclarationComponent *component in self.components)
+    {
+        glVertexAttribPointer(firstAttribute + component.index,
+                              component.size,
+                              component.type,
+                              component.normalized,
+                              component.stride,
+                              (const GLvoid *)((uintptr_t)component.offset + offset));
+        glEnableVertexAttribArray(firstAttribute + component.attribute);
+        if (component.divisor != 0) {
+            glVertexAttribDivisorMJ(firstAttribute + component.attribute,
+                                    component.divisor);
+        }
+    }
+}
+
+- (void)applyStream:(NSUInteger)stream
+           atOffset:(NSUInteger)offset
+     firstAttribute:(GLuint)firstAttribute
 {
     for (MJVertexDeclarationComponent *component in self.components)
     {
-        glVertexAttribPointer(component.index,
+        if (component.stream != stream) {
+            continue;
+        }
+        glVertexAttribPointer(firstAttribute + component.index,
                               component.size,
                               component.type,
                               component.normalized,
                               component.stride,
-                              component.offset);
-        glEnableVertexAttribArray(component.attribute);
+                              (const GLvoid *)((uintptr_t)component.offset + offset));
+        glEnableVertexAttribArray(firstAttribute + component.attribute);
+        if (component.divisor != 0) {
+            glVertexAttribDivisorMJ(firstAttribute + component.attribute,
+                                    component.divisor);
+        }
     }
 }
 
+- (void)disableAttributesFromAttribute:(GLuint)firstAttribute
+{
+    for (MJVertexDeclarationComponent *component in self.components)
+    {
+        glDisableVertexAttribArray(firstAttribute + component.attribute);
+        if (component.divisor != 0) {
+            glVertexAttribDivisorMJ(firstAttribute + component.attribute, 0);
+        }
+    }
+}
+
+- (NSUInteger)attributeCount
+{
+    return self.components.count;
+}
+
+- (void)addComponentOfType:(GLenum)type
+                normalized:(GLboolean)normalized
+                     count:(GLint)count
+{
+    [self addComponentOfType:type normalized:normalized count:count divisor:0];
+}
+
 - (void)addComponentOfType:(GLenum)type
                 normalized:(GLboolean)normalized
                      count:(GLint)count
+                   divisor:(GLuint)divisor
 {
     if (self.components == nil) {
         // Lazily instantiate components array
@@ -80,25 +199,21 @@
 	component.type = type;
 	component.normalized = normalized;
 	component.stride = 0;
-	component.offset = (const GLvoid *)_stride;
+	component.offset = (const GLvoid *)_streamStrides[_currentStream];
 	component.attribute = (GLuint) self.components.count;
+    component.divisor = divisor;
+    component.stream = _currentStream;
 
     [self.components addObject:component];
 
-    switch (type)
-    {
-        case GL_FLOAT:
-            _stride += count * sizeof(GLfloat);
-            break;
-        case GL_UNSIGNED_BYTE:
-            _stride += count * sizeof(GLubyte);
-            break;
-    }
+    _streamStrides[_currentStream] += MJVertexComponentSize(type, count);
 
-    // Update stride
+    // Update stride of the components in the stream
     for (MJVertexDeclarationComponent *component in self.components)
     {
-        component.stride = (GLsizei) _stride;
+        if (component.stream == _currentStream) {
+            component.stride = (GLsizei) _streamStrides[_currentStream];
+        }
     }
 }
 
@@ -108,6 +223,11 @@
     [self addComponentOfType:GL_FLOAT normalized:GL_FALSE count:count];
 }
 
+- (void)addFloatComponentOfCount:(GLint)count divisor:(GLuint)divisor
+{
+    [self addComponentOfType:GL_FLOAT normalized:GL_FALSE count:count divisor:divisor];
+}
+
 - (void)addUnsignedByteComponentOfCount:(GLint)count
 {
     [self addComponentOfType:GL_UNSIGNED_BYTE normalized:GL_FALSE count:count];
@@ -118,10 +238,38 @@
     [self addComponentOfType:GL_UNSIGNED_BYTE normalized:GL_TRUE count:count];
 }
 
+- (void)addNormalizedUnsignedByteComponentOfCount:(GLint)count
+                                          divisor:(GLuint)divisor
+{
+    [self addComponentOfType:GL_UNSIGNED_BYTE normalized:GL_TRUE count:count divisor:divisor];
+}
+
 - (void)addNormalizedUnsignedShortComponentOfCount:(GLint)count
 {
     [self addComponentOfType:GL_UNSIGNED_SHORT normalized:GL_TRUE count:count];
 }
 
+- (void)addNormalizedByteComponentOfCount:(GLint)count
+{
+    [self addComponentOfType:GL_BYTE normalized:GL_TRUE count:count];
+}
+
+- (void)addNormalizedShortComponentOfCount:(GLint)count
+{
+    [self addComponentOfType:GL_SHORT normalized:GL_TRUE count:count];
+}
+
+- (void)addHalfFloatComponentOfCount:(GLint)count
+{
+    [self addComponentOfType:GL_HALF_FLOAT normalized:GL_FALSE count:count];
+}
+
+#if !TARGET_OS_IPHONE
+- (void)addPackedNormalComponent
+{
+    [self addComponentOfType:GL_INT_2_10_10_10_REV normalized:GL_TRUE count:4];
+}
+#endif
+
 
 @end
@@ -0,0 +1,77 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJRenderQueue.h"
+
+/** A unit of recorded render work, run on the render thread. */
+typedef void (^MJRenderCommand)(void);
+
+/**
+ * The MJRenderCommandList object records the render work of a frame on
+ * one thread so that it can be replayed on another, typically by an
+ * MJRenderThread.
+ *
+ * Commands are blocks, which retain the objects they capture. The packets
+ * of the render queue do not retain their objects, so those must be kept
+ * alive until the list has been executed, e.g. by capturing them in a
+ * command.
+ */
+@interface MJRenderCommandList : NSObject
+
+/**
+ * A render queue that is submitted after the commands of the list,
+ * or nil if the list was created without one.
+ */
+@property (nonatomic, strong, readonly) MJRenderQueue *renderQueue;
+
+/** The number of commands recorded. */
+@property (nonatomic, readonly) NSUInteger commandCount;
+
+/**
+ * Initialize a command list.
+ *
+ * @param packetCapacity Capacity of the render queue of the list, or 0
+ *                       for a list without a render queue.
+ */
+- (id)initWithRenderQueueCapacity:(NSUInteger)packetCapacity;
+
+/**
+ * Record a command.
+ *
+ * @param command The command, which is run when the list is executed.
+ */
+- (void)addCommand:(MJRenderCommand)command;
+
+/**
+ * Run the commands in the order they were recorded and then submit the
+ * render queue. Must be called on the thread of the OpenGL context.
+ */
+- (void)execute;
+
+/** Remove all commands and render packets, so that the list can be reused. */
+- (void)clear;
+
+@end
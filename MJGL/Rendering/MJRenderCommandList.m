@@ -0,0 +1,72 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJRenderCommandList.h"
+
+@implementation MJRenderCommandList {
+    NSMutableArray *_commands;
+}
+
+- (id)initWithRenderQueueCapacity:(NSUInteger)packetCapacity
+{
+    self = [super init];
+    if (self) {
+        _commands = [NSMutableArray array];
+        if (packetCapacity > 0) {
+            _renderQueue = [[MJRenderQueue alloc] initWithCapacity:packetCapacity];
+        }
+    }
+    return self;
+}
+
+- (NSUInteger)commandCount
+{
+    return _commands.count;
+}
+
+- (void)addCommand:(MJRenderCommand)command
+{
+    [_commands addObject:[command copy]];
+}
+
+- (void)execute
+{
+    for (MJRenderCommand command in _commands) {
+        command();
+    }
+    [_renderQueue submit];
+}
+
+- (void)clear
+{
+    [_commands removeAllObjects];
+    [_renderQueue clear];
+}
+
+@end
@@ -0,0 +1,195 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+#import "MJShaderProgram.h"
+#import "MJVertexBuffer.h"
+#import "MJIndexBuffer.h"
+
+/** The maximum number of textures bound by a single render packet. */
+#define kMJRenderPacketMaxTextures 4
+
+/** The number of layers of the render queue. */
+#define kMJRenderLayerCount 3
+
+/**
+ * Layers are submitted in order, so that e.g. all opaque geometry is drawn
+ * before any translucent geometry.
+ */
+typedef enum MJRenderLayer
+{
+    /** Opaque geometry. Sorted front to back by default. */
+    MJRenderLayerOpaque = 0,
+    
+    /** Translucent geometry. Sorted back to front by default. */
+    MJRenderLayerTranslucent,
+    
+    /** Overlays, e.g. 2D UI. Drawn in submission order by default. */
+    MJRenderLayerOverlay
+} MJRenderLayer;
+
+/**
+ * The depth order specifies how the packets of a layer are ordered.
+ */
+typedef enum MJRenderDepthOrder
+{
+    /**
+     * Packets are grouped by state to minimize state changes, and sorted
+     * front to back within each group. Suitable for opaque geometry.
+     */
+    MJRenderDepthOrderFrontToBack = 0,
+    
+    /**
+     * Packets are sorted back to front, and grouped by state only when
+     * they have the same depth. Required for blending.
+     */
+    MJRenderDepthOrderBackToFront,
+    
+    /** Packets are drawn in the order they were added. */
+    MJRenderDepthOrderSubmission
+} MJRenderDepthOrder;
+
+/**
+ * A render packet describes a single draw call and the state it needs.
+ *
+ * The render queue does not retain the objects of a packet, so they must
+ * be kept alive until the queue has been submitted.
+ */
+typedef struct MJRenderPacket
+{
+    /** The layer the packet is drawn in. */
+    MJRenderLayer layer;
+    
+    /** The shader program to draw with. */
+    __unsafe_unretained MJShaderProgram *program;
+    
+    /** The vertex buffer to draw. */
+    __unsafe_unretained MJVertexBuffer *vertexBuffer;
+    
+    /** The index buffer to draw with, or nil to draw the vertices directly. */
+    __unsafe_unretained MJIndexBuffer *indexBuffer;
+    
+    /** Index of the first vertex, or first index if indexed, to draw. */
+    NSUInteger first;
+    
+    /** The number of vertices or indices to draw, or 0 to draw all. */
+    NSUInteger count;
+    
+    /**
+     * Textures to bind to texture units 0 and up. Only the names are kept,
+     * so textures from a texture manager must stay retained until the
+     * queue has been submitted.
+     */
+    GLuint textures[kMJRenderPacketMaxTextures];
+    
+    /** The number of textures in the textures array. */
+    NSUInteger textureCount;
+    
+    /**
+     * Distance from the camera, used for depth ordering.
+     * Negative values are treated as 0.
+     */
+    float depth;
+} MJRenderPacket;
+
+/**
+ * The MJRenderQueue object collects render packets during a frame and
+ * submits them in an order that minimizes state changes.
+ *
+ * Each packet is encoded as a 64-bit sort key made up of its layer,
+ * its state (shader program, textures and vertex buffer) and its depth,
+ * where the depth order of the layer decides whether state or depth is
+ * most significant. The keys are radix sorted and the packets are then
+ * submitted in order, only changing the state that differs from the
+ * previous packet.
+ */
+@interface MJRenderQueue : NSObject
+
+/** The number of packets waiting to be submitted. */
+@property (nonatomic, readonly) NSUInteger packetCount;
+
+/** The number of shader program changes made by the last submit. */
+@property (nonatomic, readonly) NSUInteger programChangeCount;
+
+/** The number of texture changes made by the last submit. */
+@property (nonatomic, readonly) NSUInteger textureChangeCount;
+
+/**
+ * Initialize a render queue with room for a number of packets. The queue
+ * grows if more packets are added.
+ *
+ * @param packetCapacity The initial number of packets that fit in the queue.
+ */
+- (id)initWithCapacity:(NSUInteger)packetCapacity;
+
+/**
+ * Set how the packets of a layer are ordered.
+ *
+ * @param depthOrder The depth order of the layer.
+ * @param layer The layer to set the depth order for.
+ */
+- (void)setDepthOrder:(MJRenderDepthOrder)depthOrder
+             forLayer:(MJRenderLayer)layer;
+
+/**
+ * Get how the packets of a layer are ordered.
+ *
+ * @param layer The layer to get the depth order for.
+ * @return The depth order of the layer.
+ */
+- (MJRenderDepthOrder)depthOrderForLayer:(MJRenderLayer)layer;
+
+/**
+ * Add a packet to be drawn by the next submit.
+ *
+ * @param packet The packet to draw. It is copied.
+ * @param uniforms Block that sets the uniforms of the packet, called after
+ *                 the shader program has been made current and before the
+ *                 packet is drawn. The uniforms it sets are uploaded right
+ *                 after it returns, so they apply to this packet. May be nil.
+ */
+- (void)addPacket:(const MJRenderPacket *)packet
+         uniforms:(void (^)(MJShaderProgram *program))uniforms;
+
+/**
+ * Add a packet without uniforms to be drawn by the next submit.
+ *
+ * @param packet The packet to draw. It is copied.
+ */
+- (void)addPacket:(const MJRenderPacket *)packet;
+
+/**
+ * Sort and draw the packets added since the last submit, and remove
+ * them from the queue.
+ */
+- (void)submit;
+
+/**
+ * Remove all packets from the queue without drawing them.
+ */
+- (void)clear;
+
+@end
@@ -0,0 +1,386 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJRenderQueue.h"
+#import "MJRadixSort.h"
+#import "MJGLStateCache.h"
+#import "MJProfiler.h"
+
+// Layout of the sort key, from the most significant bit:
+// layer (2 bits), then state (38 bits) and depth (24 bits) in the order
+// given by the depth order of the layer.
+#define kMJRenderKeyLayerShift 62
+#define kMJRenderKeyDepthBits 24
+#define kMJRenderKeyStateBits 38
+#define kMJRenderKeyDepthMask ((1ull << kMJRenderKeyDepthBits) - 1)
+#define kMJRenderKeyProgramBits 10
+#define kMJRenderKeyTextureBits 14
+#define kMJRenderKeyVertexBufferBits 14
+
+typedef struct MJRenderQueueEntry
+{
+    MJRenderPacket packet;
+    NSInteger uniformsIndex;
+} MJRenderQueueEntry;
+
+/**
+ * Open addressing hash table that maps pointers and texture names to
+ * small, dense indices for the sort keys of a frame.
+ */
+typedef struct MJRenderInternTable
+{
+    uint64_t *keys;
+    uint32_t *indices;
+    uint32_t capacity;
+    uint32_t count;
+} MJRenderInternTable;
+
+static void MJRenderInternTableInit(MJRenderInternTable *table, uint32_t capacity)
+{
+    table->capacity = capacity;
+    table->count = 0;
+    table->keys = calloc(capacity, sizeof(uint64_t));
+    table->indices = calloc(capacity, sizeof(uint32_t));
+}
+
+static void MJRenderInternTableFree(MJRenderInternTable *table)
+{
+    free(table->keys);
+    free(table->indices);
+}
+
+static void MJRenderInternTableClear(MJRenderInternTable *table)
+{
+    memset(table->indices, 0, table->capacity * sizeof(uint32_t));
+    table->count = 0;
+}
+
+static uint32_t MJRenderInternTableIndex(MJRenderInternTable *table, uint64_t key)
+{
+    // Indices are stored off by one, so that 0 marks an empty slot.
+    uint32_t mask = table->capacity - 1;
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    uint32_t slot = (uint32_t)(hash >> 32) & mask;
+    while (table->indices[slot] != 0) {
+        if (table->keys[slot] == key) {
+            return table->indices[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    if ((table->count + 1) * 2 > table->capacity) {
+        // Keep the load factor below one half.
+        MJRenderInternTable grown;
+        MJRenderInternTableInit(&grown, table->capacity * 2);
+        for (uint32_t i = 0; i < table->capacity; i++) {
+            if (table->indices[i] != 0) {
+                uint32_t s = (uint32_t)((table->keys[i] * 0x9E3779B97F4A7C15ull) >> 32) & (grown.capacity - 1);
+                while (grown.indices[s] != 0) {
+                    s = (s + 1) & (grown.capacity - 1);
+                }
+                grown.keys[s] = table->keys[i];
+                grown.indices[s] = table->indices[i];
+            }
+        }
+        grown.count = table->count;
+        MJRenderInternTableFree(table);
+        *table = grown;
+        return MJRenderInternTableIndex(table, key);
+    }
+    
+    table->keys[slot] = key;
+    table->indices[slot] = ++table->count;
+    return table->count - 1;
+}
+
+static inline uint64_t MJRenderQuantizeDepth(float depth)
+{
+    // The bit patterns of non-negative floats sort like the floats.
+    if (!(depth > 0.0f)) {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> (31 - kMJRenderKeyDepthBits)) & kMJRenderKeyDepthMask;
+}
+
+@implementation MJRenderQueue {
+    MJRenderDepthOrder _depthOrders[kMJRenderLayerCount];
+    
+    NSUInteger _capacity;
+    MJRenderQueueEntry *_entries;
+    uint64_t *_keys;
+    uint32_t *_order;
+    uint64_t *_scratchKeys;
+    uint32_t *_scratchOrder;
+    NSMutableArray *_uniforms;
+    
+    MJRenderInternTable _programIndices;
+    MJRenderInternTable _textureIndices;
+    MJRenderInternTable _vertexBufferIndices;
+}
+
+#pragma mark - Initializing/destroying the render queue
+
+- (id)initWithCapacity:(NSUInteger)packetCapacity
+{
+    self = [super init];
+    if (self) {
+        _depthOrders[MJRenderLayerOpaque] = MJRenderDepthOrderFrontToBack;
+        _depthOrders[MJRenderLayerTranslucent] = MJRenderDepthOrderBackToFront;
+        _depthOrders[MJRenderLayerOverlay] = MJRenderDepthOrderSubmission;
+        
+        _uniforms = [NSMutableArray array];
+        MJRenderInternTableInit(&_programIndices, 64);
+        MJRenderInternTableInit(&_textureIndices, 256);
+        MJRenderInternTableInit(&_vertexBufferIndices, 256);
+        
+        if (![self growToCapacity:MAX(packetCapacity, 16)]) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (id)init
+{
+    return [self initWithCapacity:1024];
+}
+
+- (void)dealloc
+{
+    free(_entries);
+    free(_keys);
+    free(_order);
+    free(_scratchKeys);
+    free(_scratchOrder);
+    MJRenderInternTableFree(&_programIndices);
+    MJRenderInternTableFree(&_textureIndices);
+    MJRenderInternTableFree(&_vertexBufferIndices);
+}
+
+- (BOOL)growToCapacity:(NSUInteger)capacity
+{
+    MJRenderQueueEntry *entries = realloc(_entries, capacity * sizeof(MJRenderQueueEntry));
+    if (entries) _entries = entries;
+    uint64_t *keys = realloc(_keys, capacity * sizeof(uint64_t));
+    if (keys) _keys = keys;
+    uint32_t *order = realloc(_order, capacity * sizeof(uint32_t));
+    if (order) _order = order;
+    uint64_t *scratchKeys = realloc(_scratchKeys, capacity * sizeof(uint64_t));
+    if (scratchKeys) _scratchKeys = scratchKeys;
+    uint32_t *scratchOrder = realloc(_scratchOrder, capacity * sizeof(uint32_t));
+    if (scratchOrder) _scratchOrder = scratchOrder;
+    
+    if (!entries || !keys || !order || !scratchKeys || !scratchOrder) {
+        NSLog(@"ERROR: Unable to grow render queue to %lu packets.",
+              (unsigned long)capacity);
+        return NO;
+    }
+    
+    _capacity = capacity;
+    return YES;
+}
+
+#pragma mark - Configuring layers
+
+- (void)setDepthOrder:(MJRenderDepthOrder)depthOrder
+             forLayer:(MJRenderLayer)layer
+{
+    if ((NSUInteger)layer >= kMJRenderLayerCount) {
+        NSLog(@"WARNING: Invalid render layer %d.", (int)layer);
+        return;
+    }
+    _depthOrders[layer] = depthOrder;
+}
+
+- (MJRenderDepthOrder)depthOrderForLayer:(MJRenderLayer)layer
+{
+    if ((NSUInteger)layer >= kMJRenderLayerCount) {
+        NSLog(@"WARNING: Invalid render layer %d.", (int)layer);
+        return MJRenderDepthOrderSubmission;
+    }
+    return _depthOrders[layer];
+}
+
+#pragma mark - Adding packets
+
+- (void)addPacket:(const MJRenderPacket *)packet
+{
+    [self addPacket:packet uniforms:nil];
+}
+
+- (void)addPacket:(const MJRenderPacket *)packet
+         uniforms:(void (^)(MJShaderProgram *program))uniforms
+{
+    if ((NSUInteger)packet->layer >= kMJRenderLayerCount) {
+        NSLog(@"WARNING: Invalid render layer %d, packet dropped.", (int)packet->layer);
+        return;
+    }
+    if (packet->textureCount > kMJRenderPacketMaxTextures) {
+        NSLog(@"WARNING: Render packet has %lu textures, at most %d are supported, packet dropped.",
+              (unsigned long)packet->textureCount, kMJRenderPacketMaxTextures);
+        return;
+    }
+    
+    if (_packetCount == _capacity && ![self growToCapacity:_capacity * 2]) {
+        return;
+    }
+    
+    MJRenderQueueEntry *entry = &_entries[_packetCount];
+    entry->packet = *packet;
+    entry->uniformsIndex = -1;
+    if (uniforms) {
+        entry->uniformsIndex = (NSInteger)_uniforms.count;
+        [_uniforms addObject:[uniforms copy]];
+    }
+    
+    _keys[_packetCount] = [self sortKeyForPacket:packet];
+    _order[_packetCount] = (uint32_t)_packetCount;
+    _packetCount++;
+}
+
+- (uint64_t)sortKeyForPacket:(const MJRenderPacket *)packet
+{
+    uint64_t layer = (uint64_t)packet->layer << kMJRenderKeyLayerShift;
+    MJRenderDepthOrder depthOrder = _depthOrders[packet->layer];
+    
+    if (depthOrder == MJRenderDepthOrderSubmission) {
+        return layer | (uint64_t)_packetCount;
+    }
+    
+    // Textures are interned as a set, hashed from their names.
+    uint64_t textureHash = 0xcbf29ce484222325ull;
+    for (NSUInteger i = 0; i < packet->textureCount; i++) {
+        textureHash = (textureHash ^ packet->textures[i]) * 0x100000001b3ull;
+    }
+    
+    uint64_t program = MJRenderInternTableIndex(&_programIndices,
+                                                (uint64_t)(uintptr_t)packet->program);
+    uint64_t texture = MJRenderInternTableIndex(&_textureIndices, textureHash);
+    uint64_t vertexBuffer = MJRenderInternTableIndex(&_vertexBufferIndices,
+                                                     (uint64_t)(uintptr_t)packet->vertexBuffer);
+    
+    // Indices that overflow their bits only make the sort less effective,
+    // the executor compares the actual state.
+    uint64_t state =
+        ((program & ((1ull << kMJRenderKeyProgramBits) - 1))
+            << (kMJRenderKeyTextureBits + kMJRenderKeyVertexBufferBits)) |
+        ((texture & ((1ull << kMJRenderKeyTextureBits) - 1))
+            << kMJRenderKeyVertexBufferBits) |
+        (vertexBuffer & ((1ull << kMJRenderKeyVertexBufferBits) - 1));
+    uint64_t depth = MJRenderQuantizeDepth(packet->depth);
+    
+    if (depthOrder == MJRenderDepthOrderBackToFront) {
+        depth = kMJRenderKeyDepthMask - depth;
+        return layer | (depth << kMJRenderKeyStateBits) | state;
+    }
+    
+    return layer | (state << kMJRenderKeyDepthBits) | depth;
+}
+
+#pragma mark - Submitting packets
+
+- (void)submit
+{
+    MJProfileScope("MJRenderQueue.submit");
+    
+    _programChangeCount = 0;
+    _textureChangeCount = 0;
+    
+    MJRadixSort64(_keys, _order, _scratchKeys, _scratchOrder, _packetCount);
+    
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    __unsafe_unretained MJShaderProgram *currentProgram = nil;
+    GLuint currentTextures[kMJRenderPacketMaxTextures] = {0};
+    NSUInteger currentTextureCount = 0;
+    
+    for (NSUInteger i = 0; i < _packetCount; i++) {
+        const MJRenderQueueEntry *entry = &_entries[_order[i]];
+        const MJRenderPacket *packet = &entry->packet;
+        
+        if (packet->program != currentProgram) {
+            [packet->program prepareToDraw];
+            currentProgram = packet->program;
+            _programChangeCount++;
+        }
+        
+        for (NSUInteger unit = 0; unit < packet->textureCount; unit++) {
+            GLuint texture = packet->textures[unit];
+            if (unit >= currentTextureCount || currentTextures[unit] != texture) {
+                [stateCache bindTexture:texture target:GL_TEXTURE_2D unit:(GLuint)unit];
+                currentTextures[unit] = texture;
+                _textureChangeCount++;
+            }
+        }
+        currentTextureCount = MAX(currentTextureCount, packet->textureCount);
+        
+        if (entry->uniformsIndex >= 0) {
+            void (^uniforms)(MJShaderProgram *) = _uniforms[(NSUInteger)entry->uniformsIndex];
+            uniforms(packet->program);
+            
+            // The setters only store the values, upload them before the
+            // draw. The program is already current, so this is only the
+            // upload of the uniforms that changed.
+            [packet->program prepareToDraw];
+        }
+        
+        [self drawPacket:packet];
+    }
+    
+    [self clear];
+}
+
+- (void)drawPacket:(const MJRenderPacket *)packet
+{
+    MJVertexBuffer *vertexBuffer = packet->vertexBuffer;
+    MJIndexBuffer *indexBuffer = packet->indexBuffer;
+    
+    if (indexBuffer) {
+        NSUInteger count = packet->count ? packet->count : indexBuffer.count;
+        [vertexBuffer drawWithFirstVertexAtIndex:packet->first
+                                           count:count
+                                     indexBuffer:indexBuffer];
+    } else {
+        NSUInteger count = packet->count ? packet->count : vertexBuffer.count;
+        [vertexBuffer drawWithFirstVertexAtIndex:packet->first
+                                           count:count];
+    }
+}
+
+- (void)clear
+{
+    _packetCount = 0;
+    [_uniforms removeAllObjects];
+    MJRenderInternTableClear(&_programIndices);
+    MJRenderInternTableClear(&_textureIndices);
+    MJRenderInternTableClear(&_vertexBufferIndices);
+}
+
+@end
@@ -0,0 +1,114 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGLContext.h"
+#import "MJRenderCommandList.h"
+
+/** Default maximum number of frames in flight, i.e. double buffering. */
+#define kMJRenderThreadDefaultMaxFramesInFlight 2
+
+/**
+ * The MJRenderThread object owns an OpenGL context on a dedicated thread
+ * and replays the command lists that another thread records, so that the
+ * simulation of the next frame overlaps the GL submission of the last one.
+ *
+ * A frame is recorded between beginFrame and commitFrame:, typically by the
+ * delegate of the frame ticker. The lists are handed between the threads
+ * through lock-free queues, and beginFrame blocks while the maximum number
+ * of frames are in flight, so the recording thread can never get further
+ * ahead of the render thread than that.
+ *
+ * All methods except start and stop must be called from one thread, the
+ * recording thread. The thread retains the object while it is running, so
+ * it has to be stopped before it can be released.
+ */
+@interface MJRenderThread : NSObject
+
+/** The context made current on the render thread. */
+@property (nonatomic, strong, readonly) id<MJGLContext> context;
+
+/** Maximum number of frames that are recorded but not yet rendered. */
+@property (nonatomic, readonly) NSUInteger maxFramesInFlight;
+
+/**
+ * Run on the render thread after each frame, typically to present the
+ * frame, e.g. by flushing the buffer of the OS X OpenGL context or by
+ * presenting the renderbuffer of the iOS context. Set before start.
+ */
+@property (nonatomic, copy) MJRenderCommand presentHandler;
+
+/** YES if the render thread has been started and not stopped. */
+@property (nonatomic, readonly) BOOL running;
+
+/**
+ * Initialize a render thread with double buffered command lists.
+ *
+ * @param context The context to render with. It must not be current on
+ *                any other thread while the render thread is running.
+ */
+- (id)initWithContext:(id<MJGLContext>)context;
+
+/**
+ * Initialize a render thread.
+ *
+ * @param context The context to render with. It must not be current on
+ *                any other thread while the render thread is running.
+ * @param maxFramesInFlight Number of command lists, at least 1.
+ * @param packetCapacity Render queue capacity of each command list, or 0
+ *                       for command lists without render queues.
+ */
+- (id)initWithContext:(id<MJGLContext>)context
+    maxFramesInFlight:(NSUInteger)maxFramesInFlight
+  renderQueueCapacity:(NSUInteger)packetCapacity;
+
+/** Start the render thread. */
+- (void)start;
+
+/**
+ * Stop the render thread after it has rendered the frames already
+ * committed. Blocks until the thread has finished. May be called from
+ * another thread than the recording thread, in which case a recording
+ * thread blocked in beginFrame is woken and gets nil.
+ */
+- (void)stop;
+
+/**
+ * Get an empty command list to record the next frame into. Blocks while
+ * the maximum number of frames are in flight.
+ *
+ * @return The command list of the frame, or nil if the render thread is
+ *         not running or was stopped while waiting.
+ */
+- (MJRenderCommandList *)beginFrame;
+
+/**
+ * Hand a recorded frame over to the render thread.
+ *
+ * @param commandList The command list returned by the last beginFrame.
+ */
+- (void)commitFrame:(MJRenderCommandList *)commandList;
+
+@end
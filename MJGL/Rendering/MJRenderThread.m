@@ -0,0 +1,269 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJRenderThread.h"
+#include <stdatomic.h>
+
+#if !TARGET_OS_IPHONE
+#import <OpenGL/OpenGL.h>
+#endif
+
+#pragma mark - Single producer, single consumer ring
+
+/**
+ * Lock-free queue with one producer and one consumer thread. The head is
+ * only written by the consumer and the tail only by the producer, so each
+ * side just has to publish its slot with release and observe the other
+ * side with acquire.
+ */
+typedef struct MJRenderRing {
+    void **slots;
+    NSUInteger mask;
+    _Atomic NSUInteger head;
+    _Atomic NSUInteger tail;
+} MJRenderRing;
+
+static void MJRenderRingInit(MJRenderRing *ring, NSUInteger capacity)
+{
+    NSUInteger size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring->slots = calloc(size, sizeof(void *));
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+static void MJRenderRingFree(MJRenderRing *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+static BOOL MJRenderRingPush(MJRenderRing *ring, void *item)
+{
+    NSUInteger tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    NSUInteger head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head > ring->mask) {
+        return NO;
+    }
+    ring->slots[tail & ring->mask] = item;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return YES;
+}
+
+static void *MJRenderRingPop(MJRenderRing *ring)
+{
+    NSUInteger head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    NSUInteger tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    void *item = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return item;
+}
+
+#pragma mark - Render thread
+
+@implementation MJRenderThread {
+    // Owns the command lists, the rings only hold unretained pointers.
+    NSArray *_commandLists;
+    
+    MJRenderRing _submitted;
+    MJRenderRing _available;
+    
+    dispatch_semaphore_t _framesInFlight;
+    dispatch_semaphore_t _work;
+    dispatch_semaphore_t _finished;
+    
+    _Atomic BOOL _running;
+    _Atomic BOOL _stopping;
+    NSThread *_thread;
+}
+
+- (id)initWithContext:(id<MJGLContext>)context
+{
+    return [self initWithContext:context
+               maxFramesInFlight:kMJRenderThreadDefaultMaxFramesInFlight
+             renderQueueCapacity:0];
+}
+
+- (id)initWithContext:(id<MJGLContext>)context
+    maxFramesInFlight:(NSUInteger)maxFramesInFlight
+  renderQueueCapacity:(NSUInteger)packetCapacity
+{
+    self = [super init];
+    if (self) {
+        _context = context;
+        _maxFramesInFlight = MAX(maxFramesInFlight, 1);
+        
+        MJRenderRingInit(&_submitted, _maxFramesInFlight);
+        MJRenderRingInit(&_available, _maxFramesInFlight);
+        
+        NSMutableArray *commandLists = [NSMutableArray arrayWithCapacity:_maxFramesInFlight];
+        for (NSUInteger i = 0; i < _maxFramesInFlight; i++) {
+            MJRenderCommandList *commandList = [[MJRenderCommandList alloc] initWithRenderQueueCapacity:packetCapacity];
+            [commandLists addObject:commandList];
+            MJRenderRingPush(&_available, (__bridge void *)commandList);
+        }
+        _commandLists = commandLists;
+        
+        _framesInFlight = dispatch_semaphore_create((long)_maxFramesInFlight);
+        _work = dispatch_semaphore_create(0);
+        atomic_init(&_running, NO);
+        atomic_init(&_stopping, NO);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    MJRenderRingFree(&_submitted);
+    MJRenderRingFree(&_available);
+}
+
+- (BOOL)running
+{
+    return atomic_load(&_running);
+}
+
+- (void)start
+{
+    if (!atomic_load(&_running)) {
+        atomic_store(&_stopping, NO);
+        _finished = dispatch_semaphore_create(0);
+        _thread = [[NSThread alloc] initWithTarget:self selector:@selector(renderLoop) object:nil];
+        _thread.name = @"MJRenderThread";
+        atomic_store(&_running, YES);
+        [_thread start];
+    }
+}
+
+- (void)stop
+{
+    if (atomic_load(&_running)) {
+        atomic_store(&_stopping, YES);
+        dispatch_semaphore_signal(_work);
+        dispatch_semaphore_wait(_finished, DISPATCH_TIME_FOREVER);
+        _thread = nil;
+        atomic_store(&_running, NO);
+        
+        // Wake the recording thread if it is blocked in beginFrame.
+        dispatch_semaphore_signal(_framesInFlight);
+    }
+}
+
+- (MJRenderCommandList *)beginFrame
+{
+    while (atomic_load(&_running)) {
+        dispatch_semaphore_wait(_framesInFlight, DISPATCH_TIME_FOREVER);
+        
+        // The render thread makes a list available before it signals that
+        // its frame is done, so there is one to take here unless the wait
+        // was ended by stop. The extra signal of a stop that nobody waited
+        // for is used up here, after which the loop waits again.
+        void *item = MJRenderRingPop(&_available);
+        if (item) {
+            return (__bridge MJRenderCommandList *)item;
+        }
+    }
+    return nil;
+}
+
+- (void)commitFrame:(MJRenderCommandList *)commandList
+{
+    if (commandList == nil) {
+        return;
+    }
+    if (!MJRenderRingPush(&_submitted, (__bridge void *)commandList)) {
+        NSLog(@"ERROR: More frames committed than begun.");
+        return;
+    }
+    dispatch_semaphore_signal(_work);
+}
+
+#pragma mark - Render loop
+
+- (void)renderLoop
+{
+    @autoreleasepool {
+        [_context makeCurrent];
+    }
+    
+    while (YES) {
+        dispatch_semaphore_wait(_work, DISPATCH_TIME_FOREVER);
+        
+        void *item = MJRenderRingPop(&_submitted);
+        if (item == NULL) {
+            if (atomic_load(&_stopping)) {
+                break;
+            }
+            continue;
+        }
+        [self renderFrame:item];
+    }
+    
+    // Stop may be called from another thread than the recording thread,
+    // so frames may have been committed after the stop signal. Render them
+    // rather than leave them in the queue.
+    void *item;
+    while ((item = MJRenderRingPop(&_submitted)) != NULL) {
+        [self renderFrame:item];
+    }
+    
+    dispatch_semaphore_signal(_finished);
+}
+
+- (void)renderFrame:(void *)item
+{
+#if !TARGET_OS_IPHONE
+    // Other threads may use the context at the same time, e.g. the main
+    // thread when the view is resized.
+    CGLContextObj cglContext = [_context.glContext CGLContextObj];
+    CGLLockContext(cglContext);
+#endif
+    @autoreleasepool {
+        MJRenderCommandList *commandList = (__bridge MJRenderCommandList *)item;
+        [commandList execute];
+        if (_presentHandler) {
+            _presentHandler();
+        }
+        [commandList clear];
+    }
+#if !TARGET_OS_IPHONE
+    CGLUnlockContext(cglContext);
+#endif
+    
+    MJRenderRingPush(&_available, item);
+    dispatch_semaphore_signal(_framesInFlight);
+}
+
+@end
@@ -0,0 +1,129 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJGL.h"
+#import "MJCamera2D.h"
+#import "MJShaderProgram.h"
+
+/**
+ * An axis aligned, textured and colored rectangle in the 2D world.
+ */
+typedef struct MJSprite
+{
+    /** Position of the upper left corner of the sprite in the 2D world. */
+    GLKVector2 position;
+    
+    /** Width and height of the sprite in the 2D world. */
+    GLKVector2 size;
+    
+    /** Texture coordinates of the sprite, as (u0, v0, u1, v1). */
+    GLKVector4 textureRect;
+    
+    /** RGBA color of the sprite, each channel in the range [0, 1]. */
+    GLKVector4 color;
+} MJSprite;
+
+/**
+ * The MJSpriteBatch object collects sprites during a frame and draws them
+ * with as few draw calls as possible.
+ *
+ * Sprites outside the frame of the camera are culled when they are added.
+ * The remaining sprites are written into a single streamed vertex buffer
+ * in the order they were added, and drawn with one draw call per run of
+ * consecutive sprites that share program and texture. Optionally, they
+ * are sorted by program and texture first, for longer runs.
+ *
+ * The vertices of a sprite consist of a float position, float texture
+ * coordinates and a normalized unsigned byte color, so the attributes of
+ * the shader programs should be listed in that order. Setting the uniforms
+ * of the shader programs, e.g. the camera matrices, is left to the caller.
+ */
+@interface MJSpriteBatch : NSObject
+
+/** The camera whose frame sprites are culled against. */
+@property (nonatomic, strong) MJCamera2D *camera;
+
+/** The maximum number of sprites that can be drawn per frame. */
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/** The number of sprites waiting to be drawn by the next flush. */
+@property (nonatomic, readonly) NSUInteger spriteCount;
+
+/** The number of sprites culled since the last flush. */
+@property (nonatomic, readonly) NSUInteger culledSpriteCount;
+
+/** The number of draw calls issued by the last flush. */
+@property (nonatomic, readonly) NSUInteger drawCallCount;
+
+/**
+ * Sort the sprites of each flush by shader program and texture, so that
+ * fewer draw calls are needed. Sprites that share program and texture
+ * keep their order, but others are reordered, which changes the result
+ * where blended sprites overlap. Only enable it when overlapping sprites
+ * are drawn in separate flushes or do not need to be in order. Defaults
+ * to NO.
+ */
+@property (nonatomic, assign) BOOL sortsSprites;
+
+/**
+ * Initialize a sprite batch with room for a number of sprites per frame.
+ *
+ * @param spriteCapacity The maximum number of sprites per frame.
+ * @param camera The camera whose frame sprites are culled against.
+ *
+ * @return The sprite batch or nil if it could not be created.
+ */
+- (id)initWithCapacity:(NSUInteger)spriteCapacity
+                camera:(MJCamera2D *)camera;
+
+/**
+ * Add a sprite to be drawn by the next flush, unless it is outside the
+ * frame of the camera.
+ *
+ * @param sprite The sprite to draw.
+ * @param texture The name of the texture to draw the sprite with. Only
+ *                the name is kept, so a texture from a texture manager
+ *                must stay retained until the batch has been flushed.
+ * @param program The shader program to draw the sprite with.
+ */
+- (void)addSprite:(const MJSprite *)sprite
+          texture:(GLuint)texture
+          program:(MJShaderProgram *)program;
+
+/**
+ * Draw the sprites added since the last flush and remove them from the
+ * batch. The sprites are drawn in the order they were added, unless
+ * sortsSprites is set. May be called several times per frame, e.g. once
+ * per layer.
+ */
+- (void)flush;
+
+/**
+ * Mark the end of a frame. Call it once per frame, after the last flush.
+ */
+- (void)finishFrame;
+
+@end
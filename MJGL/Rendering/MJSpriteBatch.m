@@ -0,0 +1,289 @@
+//
+//  Copyright (c) 2013 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJSpriteBatch.h"
+#import "MJVertexBuffer.h"
+#import "MJIndexBuffer.h"
+#import "MJRadixSort.h"
+#import "MJGLStateCache.h"
+#import "MJProfiler.h"
+
+/** Sprites per draw call, limited by the range of 16-bit indices. */
+#define kMJSpriteBatchMaxSpritesPerDraw 16384
+
+typedef struct MJSpriteVertex
+{
+    GLfloat x, y;
+    GLfloat u, v;
+    GLubyte color[4];
+} MJSpriteVertex;
+
+typedef struct MJSpriteBatchItem
+{
+    GLfloat x0, y0, x1, y1;
+    GLfloat u0, v0, u1, v1;
+    GLubyte color[4];
+} MJSpriteBatchItem;
+
+static inline GLubyte MJSpriteColorChannel(float value)
+{
+    if (value <= 0.0f) return 0;
+    if (value >= 1.0f) return 255;
+    return (GLubyte)(value * 255.0f + 0.5f);
+}
+
+@implementation MJSpriteBatch {
+    MJVertexBuffer *_vertexBuffer;
+    MJIndexBuffer *_indexBuffer;
+    
+    // Shader programs referenced by the sort keys of this frame.
+    NSMutableArray *_programs;
+    __unsafe_unretained MJShaderProgram *_lastProgram;
+    uint32_t _lastProgramIndex;
+    
+    MJSpriteBatchItem *_items;
+    uint64_t *_keys;
+    uint32_t *_order;
+    uint64_t *_scratchKeys;
+    uint32_t *_scratchOrder;
+}
+
+#pragma mark - Initializing/destroying the sprite batch
+
+- (id)initWithCapacity:(NSUInteger)spriteCapacity
+                camera:(MJCamera2D *)camera
+{
+    self = [super init];
+    if (self) {
+        _capacity = spriteCapacity;
+        _camera = camera;
+        _programs = [NSMutableArray array];
+        
+        _items = malloc(spriteCapacity * sizeof(MJSpriteBatchItem));
+        _keys = malloc(spriteCapacity * sizeof(uint64_t));
+        _order = malloc(spriteCapacity * sizeof(uint32_t));
+        _scratchKeys = malloc(spriteCapacity * sizeof(uint64_t));
+        _scratchOrder = malloc(spriteCapacity * sizeof(uint32_t));
+        if (!_items || !_keys || !_order || !_scratchKeys || !_scratchOrder) {
+            [self freeBuffers];
+            return nil;
+        }
+        
+        MJVertexDeclaration *declaration = [[MJVertexDeclaration alloc] init];
+        [declaration addFloatComponentOfCount:2];
+        [declaration addFloatComponentOfCount:2];
+        [declaration addNormalizedUnsignedByteComponentOfCount:4];
+        
+        _vertexBuffer = [[MJVertexBuffer alloc] initWithCapacity:spriteCapacity * 4
+                                                           usage:MJVertexBufferStreamed
+                                                     declaration:declaration];
+        
+        // All draw calls share one index buffer of quads starting at vertex 0.
+        NSUInteger quadCount = MIN(spriteCapacity, kMJSpriteBatchMaxSpritesPerDraw);
+        GLushort *indices = malloc(quadCount * 6 * sizeof(GLushort));
+        for (NSUInteger i = 0; i < quadCount; i++) {
+            GLushort vertex = (GLushort)(i * 4);
+            GLushort *quad = indices + i * 6;
+            quad[0] = vertex;
+            quad[1] = vertex + 1;
+            quad[2] = vertex + 2;
+            quad[3] = vertex + 2;
+            quad[4] = vertex + 3;
+            quad[5] = vertex;
+        }
+        _indexBuffer = [[MJIndexBuffer alloc] initWithCapacity:(unsigned int)(quadCount * 6)
+                                                       indices:indices];
+        free(indices);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self freeBuffers];
+}
+
+- (void)freeBuffers
+{
+    free(_items);
+    free(_keys);
+    free(_order);
+    free(_scratchKeys);
+    free(_scratchOrder);
+    _items = NULL;
+    _keys = NULL;
+    _order = NULL;
+    _scratchKeys = NULL;
+    _scratchOrder = NULL;
+}
+
+#pragma mark - Adding sprites
+
+- (void)addSprite:(const MJSprite *)sprite
+          texture:(GLuint)texture
+          program:(MJShaderProgram *)program
+{
+    float x0 = sprite->position.x;
+    float y0 = sprite->position.y;
+    float x1 = x0 + sprite->size.x;
+    float y1 = y0 + sprite->size.y;
+    
+    if (_camera) {
+        CGRect frame = _camera.frame;
+        if (x1 < CGRectGetMinX(frame) || x0 > CGRectGetMaxX(frame) ||
+            y1 < CGRectGetMinY(frame) || y0 > CGRectGetMaxY(frame)) {
+            _culledSpriteCount++;
+            return;
+        }
+    }
+    
+    if (_spriteCount == _capacity) {
+        NSLog(@"WARNING: Sprite batch is full, dropping sprite.");
+        return;
+    }
+    
+    MJSpriteBatchItem *item = &_items[_spriteCount];
+    item->x0 = x0;
+    item->y0 = y0;
+    item->x1 = x1;
+    item->y1 = y1;
+    item->u0 = sprite->textureRect.x;
+    item->v0 = sprite->textureRect.y;
+    item->u1 = sprite->textureRect.z;
+    item->v1 = sprite->textureRect.w;
+    item->color[0] = MJSpriteColorChannel(sprite->color.r);
+    item->color[1] = MJSpriteColorChannel(sprite->color.g);
+    item->color[2] = MJSpriteColorChannel(sprite->color.b);
+    item->color[3] = MJSpriteColorChannel(sprite->color.a);
+    
+    uint64_t programIndex = [self indexOfProgram:program];
+    _keys[_spriteCount] = (programIndex << 32) | texture;
+    _order[_spriteCount] = (uint32_t)_spriteCount;
+    _spriteCount++;
+}
+
+- (uint32_t)indexOfProgram:(MJShaderProgram *)program
+{
+    if (program != _lastProgram || _programs.count == 0) {
+        NSUInteger index = [_programs indexOfObjectIdenticalTo:program];
+        if (index == NSNotFound) {
+            index = _programs.count;
+            [_programs addObject:program];
+        }
+        _lastProgram = program;
+        _lastProgramIndex = (uint32_t)index;
+    }
+    return _lastProgramIndex;
+}
+
+#pragma mark - Drawing
+
+- (void)flush
+{
+    MJProfileScope("MJSpriteBatch.flush");
+    
+    _drawCallCount = 0;
+    
+    if (_spriteCount > 0) {
+        if (_sortsSprites) {
+            MJRadixSort64(_keys, _order, _scratchKeys, _scratchOrder, _spriteCount);
+        }
+        
+        NSUInteger firstVertex = 0;
+        MJSpriteVertex *vertices = [_vertexBuffer mapNextVertices:_spriteCount * 4
+                                                      firstVertex:&firstVertex];
+        if (vertices) {
+            [self writeVertices:vertices];
+            [_vertexBuffer unmapVertices];
+            [self drawFromVertex:firstVertex];
+        }
+    }
+    
+    _spriteCount = 0;
+    _culledSpriteCount = 0;
+    [_programs removeAllObjects];
+    _lastProgram = nil;
+}
+
+- (void)finishFrame
+{
+    [_vertexBuffer finishFrame];
+}
+
+- (void)writeVertices:(MJSpriteVertex *)vertices
+{
+    for (NSUInteger i = 0; i < _spriteCount; i++) {
+        const MJSpriteBatchItem *item = &_items[_order[i]];
+        uint32_t color;
+        memcpy(&color, item->color, sizeof(color));
+        
+        MJSpriteVertex *quad = vertices + i * 4;
+        quad[0] = (MJSpriteVertex){item->x0, item->y0, item->u0, item->v0};
+        quad[1] = (MJSpriteVertex){item->x1, item->y0, item->u1, item->v0};
+        quad[2] = (MJSpriteVertex){item->x1, item->y1, item->u1, item->v1};
+        quad[3] = (MJSpriteVertex){item->x0, item->y1, item->u0, item->v1};
+        for (int corner = 0; corner < 4; corner++) {
+            memcpy(quad[corner].color, &color, sizeof(color));
+        }
+    }
+}
+
+- (void)drawFromVertex:(NSUInteger)firstVertex
+{
+    MJGLStateCache *stateCache = [MJGLStateCache currentStateCache];
+    
+    NSUInteger runStart = 0;
+    while (runStart < _spriteCount) {
+        uint64_t key = _keys[runStart];
+        NSUInteger runEnd = runStart + 1;
+        while (runEnd < _spriteCount && _keys[runEnd] == key) {
+            runEnd++;
+        }
+        
+        MJShaderProgram *program = _programs[(NSUInteger)(key >> 32)];
+        [program prepareToDraw];
+        [stateCache bindTexture:(GLuint)(key & 0xffffffff)
+                         target:GL_TEXTURE_2D
+                           unit:0];
+        
+        for (NSUInteger first = runStart; first < runEnd;
+             first += kMJSpriteBatchMaxSpritesPerDraw) {
+            NSUInteger count = MIN(runEnd - first, kMJSpriteBatchMaxSpritesPerDraw);
+            [_vertexBuffer drawWithFirstVertexAtIndex:0
+                                                count:count * 6
+                                          indexBuffer:_indexBuffer
+                                           baseVertex:firstVertex + first * 4];
+            _drawCallCount++;
+        }
+        
+        runStart = runEnd;
+    }
+}
+
+@end
@@ -0,0 +1,183 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#import <Foundation/Foundation.h>
+#import "MJAbstract3DCamera.h"
+#import "MJFrustum.h"
+
+/** An axis aligned bounding box. */
+typedef struct MJBoundingBox {
+    GLKVector3 min;
+    GLKVector3 max;
+} MJBoundingBox;
+
+/**
+ * Make a bounding box from its minimum and maximum corners.
+ *
+ * @param min The minimum corner.
+ * @param max The maximum corner.
+ */
+static inline MJBoundingBox MJBoundingBoxMake(GLKVector3 min, GLKVector3 max)
+{
+    MJBoundingBox box = {min, max};
+    return box;
+}
+
+/**
+ * The MJBoundingVolumeHierarchy object is a spatial index of the bounding
+ * boxes of scene objects, so that the objects visible to a camera or hit
+ * by a ray can be found without testing every object.
+ *
+ * The hierarchy is a binary tree of boxes with one object per leaf. Static
+ * content is best added up front and then built with rebuild, which uses
+ * the surface area heuristic to pick the splits. Objects added afterwards
+ * are inserted incrementally next to the subtree that grows the least.
+ * When an object moves out of the box of its leaf, the leaf is given the
+ * new box and the boxes above it are refit, up to the first box that does
+ * not change. Call rebuild again if the tree degrades after a lot of
+ * inserts and moves.
+ *
+ * Queries write object identifiers to a caller owned array and return the
+ * total number found, which may be more than the capacity of the array.
+ */
+@interface MJBoundingVolumeHierarchy : NSObject
+
+/** The number of objects in the hierarchy. */
+@property (nonatomic, readonly) NSUInteger objectCount;
+
+/**
+ * The distance that the boxes of the leaves extend beyond their objects,
+ * so that objects which move by less than that leave the tree as it is.
+ * Queries still test the objects themselves. A larger margin makes moves
+ * cheaper and queries visit more nodes. Applies to leaves that are added,
+ * moved or rebuilt after it is set. Defaults to 0.
+ */
+@property (nonatomic, assign) float margin;
+
+/**
+ * Add an object to the hierarchy.
+ *
+ * @param bounds The bounding box of the object in world space.
+ *
+ * @return The identifier of the object. Identifiers of removed objects
+ *         are reused.
+ */
+- (NSUInteger)addObjectWithBounds:(MJBoundingBox)bounds;
+
+/**
+ * Move an object.
+ *
+ * @param bounds The new bounding box of the object.
+ * @param object The identifier of the object.
+ */
+- (void)setBounds:(MJBoundingBox)bounds forObject:(NSUInteger)object;
+
+/**
+ * Get the bounding box of an object.
+ *
+ * @param object The identifier of the object.
+ */
+- (MJBoundingBox)boundsForObject:(NSUInteger)object;
+
+/**
+ * Remove an object from the hierarchy.
+ *
+ * @param object The identifier of the object.
+ */
+- (void)removeObject:(NSUInteger)object;
+
+/** Remove all objects from the hierarchy. */
+- (void)removeAllObjects;
+
+/**
+ * Build the whole tree again with the surface area heuristic. Typically
+ * called once after the static content of a scene has been added.
+ */
+- (void)rebuild;
+
+/**
+ * Recompute all the boxes of the tree. Adding, moving and removing objects
+ * already refits the boxes above them, so this is rarely needed.
+ */
+- (void)refit;
+
+/**
+ * Find the objects that are at least partly inside a frustum. Subtrees
+ * entirely outside a plane are skipped, and subtrees entirely inside the
+ * frustum are added without testing their objects.
+ *
+ * @param frustum The frustum.
+ * @param results Set to the identifiers of the objects found.
+ * @param capacity The number of identifiers that fit in results.
+ *
+ * @return The number of objects found.
+ */
+- (NSUInteger)queryFrustum:(const MJFrustum *)frustum
+                   results:(uint32_t *)results
+                  capacity:(NSUInteger)capacity;
+
+/**
+ * Find the objects that are at least partly visible to a camera.
+ *
+ * @param camera The camera.
+ * @param results Set to the identifiers of the objects found.
+ * @param capacity The number of identifiers that fit in results.
+ *
+ * @return The number of objects found.
+ */
+- (NSUInteger)queryCamera:(MJAbstract3DCamera *)camera
+                  results:(uint32_t *)results
+                 capacity:(NSUInteger)capacity;
+
+/**
+ * Find the objects that overlap a rectangle in the XY plane, e.g. the
+ * frame of a 2D camera.
+ *
+ * @param rect The rectangle.
+ * @param results Set to the identifiers of the objects found.
+ * @param capacity The number of identifiers that fit in results.
+ *
+ * @return The number of objects found.
+ */
+- (NSUInteger)queryRect:(CGRect)rect
+                results:(uint32_t *)results
+               capacity:(NSUInteger)capacity;
+
+/**
+ * Find the nearest object whose bounding box is hit by a ray.
+ *
+ * @param origin The origin of the ray.
+ * @param direction The direction of the ray, in units of distance.
+ * @param maxDistance The length of the ray.
+ * @param distance Set to the distance to the hit, if not NULL.
+ *
+ * @return The identifier of the object hit, or NSNotFound.
+ */
+- (NSUInteger)pickWithRayOrigin:(GLKVector3)origin
+                      direction:(GLKVector3)direction
+                    maxDistance:(float)maxDistance
+                       distance:(float *)distance;
+
+@end
@@ -0,0 +1,822 @@
+//
+//  Copyright (c) 2014 Martin Johannesson
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+//  (MIT License)
+//
+
+
+#if !__has_feature(objc_arc)
+#error ARC must be enabled!
+#endif
+
+#import "MJBoundingVolumeHierarchy.h"
+
+#define kMJBVHNull -1
+#define kMJBVHBinCount 16
+#define kMJBVHInitialCapacity 64
+
+/**
+ * A node of the tree, either a leaf with an object or an inner node. The
+ * bounds of a leaf are those of its object grown by the margin, so that an
+ * object can move a little without the tree being updated.
+ */
+typedef struct MJBVHNode {
+    MJBoundingBox bounds;
+    int32_t parent;  // Next free node while the node is unused.
+    int32_t left;    // kMJBVHNull for leaves.
+    int32_t right;
+    int32_t object;  // kMJBVHNull for inner nodes.
+} MJBVHNode;
+
+typedef struct MJBVHTree {
+    MJBVHNode *nodes;
+    int32_t nodeCapacity;
+    int32_t nodeCount;
+    int32_t freeNode;
+    int32_t root;
+    
+    // Traversal stack, as large as the node array so that it never overflows.
+    uint32_t *stack;
+    
+    MJBoundingBox *objectBounds;
+    int32_t *objectLeaves;  // kMJBVHNull for unused identifiers.
+    uint32_t *freeObjects;
+    uint32_t objectCapacity;
+    uint32_t objectHighWater;
+    uint32_t freeObjectCount;
+    uint32_t objectCount;
+    
+    float margin;
+} MJBVHTree;
+
+#pragma mark - Boxes
+
+static inline MJBoundingBox MJBVHUnion(MJBoundingBox a, MJBoundingBox b)
+{
+    MJBoundingBox box;
+    box.min = GLKVector3Minimum(a.min, b.min);
+    box.max = GLKVector3Maximum(a.max, b.max);
+    return box;
+}
+
+/** Half the surface area, which is all the heuristic needs. */
+static inline float MJBVHArea(MJBoundingBox box)
+{
+    GLKVector3 d = GLKVector3Subtract(box.max, box.min);
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline float MJBVHCentroid(MJBoundingBox box, int axis)
+{
+    return (box.min.v[axis] + box.max.v[axis]) * 0.5f;
+}
+
+static const MJBoundingBox MJBVHEmptyBox = {
+    {{INFINITY, INFINITY, INFINITY}},
+    {{-INFINITY, -INFINITY, -INFINITY}}
+};
+
+static inline MJBoundingBox MJBVHGrow(MJBoundingBox box, float margin)
+{
+    GLKVector3 d = GLKVector3Make(margin, margin, margin);
+    box.min = GLKVector3Subtract(box.min, d);
+    box.max = GLKVector3Add(box.max, d);
+    return box;
+}
+
+static inline BOOL MJBVHContains(MJBoundingBox outer, MJBoundingBox inner)
+{
+    return (inner.min.x >= outer.min.x && inner.min.y >= outer.min.y && inner.min.z >= outer.min.z &&
+            inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z);
+}
+
+#pragma mark - Storage
+
+static void MJBVHTreeFree(MJBVHTree *tree)
+{
+    float margin = tree->margin;
+    free(tree->nodes);
+    free(tree->stack);
+    free(tree->objectBounds);
+    free(tree->objectLeaves);
+    free(tree->freeObjects);
+    memset(tree, 0, sizeof(MJBVHTree));
+    tree->root = kMJBVHNull;
+    tree->freeNode = kMJBVHNull;
+    tree->margin = margin;
+}
+
+static void MJBVHReserveNodes(MJBVHTree *tree, int32_t capacity)
+{
+    if (capacity <= tree->nodeCapacity) {
+        return;
+    }
+    int32_t newCapacity = MAX(tree->nodeCapacity * 2, MAX(capacity, kMJBVHInitialCapacity));
+    tree->nodes = realloc(tree->nodes, newCapacity * sizeof(MJBVHNode));
+    tree->stack = realloc(tree->stack, newCapacity * sizeof(uint32_t));
+    tree->nodeCapacity = newCapacity;
+}
+
+static int32_t MJBVHAllocateNode(MJBVHTree *tree)
+{
+    int32_t index = tree->freeNode;
+    if (index != kMJBVHNull) {
+        tree->freeNode = tree->nodes[index].parent;
+    } else {
+        MJBVHReserveNodes(tree, tree->nodeCount + 1);
+        index = tree->nodeCount++;
+    }
+    MJBVHNode *node = &tree->nodes[index];
+    node->parent = kMJBVHNull;
+    node->left = kMJBVHNull;
+    node->right = kMJBVHNull;
+    node->object = kMJBVHNull;
+    return index;
+}
+
+static void MJBVHFreeNode(MJBVHTree *tree, int32_t index)
+{
+    tree->nodes[index].parent = tree->freeNode;
+    tree->nodes[index].object = kMJBVHNull;
+    tree->freeNode = index;
+}
+
+static uint32_t MJBVHAllocateObject(MJBVHTree *tree)
+{
+    if (tree->freeObjectCount > 0) {
+        return tree->freeObjects[--tree->freeObjectCount];
+    }
+    if (tree->objectHighWater == tree->objectCapacity) {
+        uint32_t capacity = MAX(tree->objectCapacity * 2, kMJBVHInitialCapacity);
+        tree->objectBounds = realloc(tree->objectBounds, capacity * sizeof(MJBoundingBox));
+        tree->objectLeaves = realloc(tree->objectLeaves, capacity * sizeof(int32_t));
+        tree->freeObjects = realloc(tree->freeObjects, capacity * sizeof(uint32_t));
+        tree->objectCapacity = capacity;
+    }
+    return tree->objectHighWater++;
+}
+
+static inline BOOL MJBVHIsObject(const MJBVHTree *tree, NSUInteger object)
+{
+    return object < tree->objectHighWater && tree->objectLeaves[object] != kMJBVHNull;
+}
+
+#pragma mark - Incremental updates
+
+static inline BOOL MJBVHEqualBoxes(MJBoundingBox a, MJBoundingBox b)
+{
+    return memcmp(&a, &b, sizeof(MJBoundingBox)) == 0;
+}
+
+/**
+ * Recompute the bounds of a node and its ancestors. The walk stops at the
+ * first node whose bounds do not change, since the nodes above it only
+ * depend on it through its bounds.
+ */
+static void MJBVHRefitAncestors(MJBVHTree *tree, int32_t index)
+{
+    while (index != kMJBVHNull) {
+        MJBVHNode *node = &tree->nodes[index];
+        MJBoundingBox bounds = MJBVHUnion(tree->nodes[node->left].bounds, tree->nodes[node->right].bounds);
+        if (MJBVHEqualBoxes(bounds, node->bounds)) {
+            break;
+        }
+        node->bounds = bounds;
+        index = node->parent;
+    }
+}
+
+/**
+ * Insert a leaf next to the node that makes the tree grow the least, found
+ * by descending from the root with the cost of the new parent plus the
+ * growth it causes in the ancestors.
+ */
+static void MJBVHInsertLeaf(MJBVHTree *tree, int32_t leaf)
+{
+    if (tree->root == kMJBVHNull) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = kMJBVHNull;
+        return;
+    }
+    
+    MJBoundingBox leafBounds = tree->nodes[leaf].bounds;
+    int32_t index = tree->root;
+    while (tree->nodes[index].left != kMJBVHNull) {
+        const MJBVHNode *node = &tree->nodes[index];
+        float area = MJBVHArea(node->bounds);
+        float combinedArea = MJBVHArea(MJBVHUnion(node->bounds, leafBounds));
+        float cost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area);
+        
+        float childCosts[2];
+        int32_t children[2] = {node->left, node->right};
+        for (int i = 0; i < 2; i++) {
+            const MJBVHNode *child = &tree->nodes[children[i]];
+            float grownArea = MJBVHArea(MJBVHUnion(child->bounds, leafBounds));
+            if (child->left != kMJBVHNull) {
+                grownArea -= MJBVHArea(child->bounds);
+            }
+            childCosts[i] = grownArea + inheritedCost;
+        }
+        
+        if (cost < childCosts[0] && cost < childCosts[1]) {
+            break;
+        }
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+    
+    int32_t sibling = index;
+    int32_t oldParent = tree->nodes[sibling].parent;
+    int32_t newParent = MJBVHAllocateNode(tree);
+    MJBVHNode *parentNode = &tree->nodes[newParent];
+    parentNode->parent = oldParent;
+    parentNode->left = sibling;
+    parentNode->right = leaf;
+    parentNode->bounds = MJBVHUnion(tree->nodes[sibling].bounds, leafBounds);
+    tree->nodes[sibling].parent = newParent;
+    tree->nodes[leaf].parent = newParent;
+    
+    if (oldParent == kMJBVHNull) {
+        tree->root = newParent;
+    } else {
+        MJBVHNode *grandParent = &tree->nodes[oldParent];
+        if (grandParent->left == sibling) {
+            grandParent->left = newParent;
+        } else {
+            grandParent->right = newParent;
+        }
+        MJBVHRefitAncestors(tree, oldParent);
+    }
+}
+
+/** Unlink a leaf and replace its parent with its sibling. */
+static void MJBVHRemoveLeaf(MJBVHTree *tree, int32_t leaf)
+{
+    if (leaf == tree->root) {
+        tree->root = kMJBVHNull;
+        return;
+    }
+    
+    int32_t parent = tree->nodes[leaf].parent;
+    int32_t grandParent = tree->nodes[parent].parent;
+    int32_t sibling = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+    
+    if (grandParent == kMJBVHNull) {
+        tree->root = sibling;
+        tree->nodes[sibling].parent = kMJBVHNull;
+    } else {
+        MJBVHNode *grandParentNode = &tree->nodes[grandParent];
+        if (grandParentNode->left == parent) {
+            grandParentNode->left = sibling;
+        } else {
+            grandParentNode->right = sibling;
+        }
+        tree->nodes[sibling].parent = grandParent;
+        MJBVHRefitAncestors(tree, grandParent);
+    }
+    MJBVHFreeNode(tree, parent);
+}
+
+/**
+ * Recompute the bounds of all inner nodes. The nodes are listed breadth
+ * first and then visited in reverse, so that children come before parents.
+ */
+static void MJBVHRefit(MJBVHTree *tree)
+{
+    if (tree->root == kMJBVHNull) {
+        return;
+    }
+    
+    uint32_t *order = tree->stack;
+    uint32_t count = 0;
+    order[count++] = tree->root;
+    for (uint32_t i = 0; i < count; i++) {
+        const MJBVHNode *node = &tree->nodes[order[i]];
+        if (node->left != kMJBVHNull) {
+            order[count++] = node->left;
+            order[count++] = node->right;
+        }
+    }
+    
+    for (uint32_t i = count; i-- > 0;) {
+        MJBVHNode *node = &tree->nodes[order[i]];
+        if (node->left != kMJBVHNull) {
+            node->bounds = MJBVHUnion(tree->nodes[node->left].bounds, tree->nodes[node->right].bounds);
+        }
+    }
+}
+
+#pragma mark - Surface area heuristic build
+
+typedef struct MJBVHBuildTask {
+    int32_t node;
+    uint32_t begin;
+    uint32_t end;
+} MJBVHBuildTask;
+
+typedef struct MJBVHBin {
+    MJBoundingBox bounds;
+    uint32_t count;
+} MJBVHBin;
+
+/**
+ * Find where to split a range of objects, by binning their centroids along
+ * the axis where they are spread the most and picking the boundary between
+ * bins with the least surface area times object count on both sides. The
+ * objects are partitioned around the split.
+ */
+static uint32_t MJBVHSplit(const MJBVHTree *tree, uint32_t *objects, uint32_t begin, uint32_t end)
+{
+    MJBoundingBox centroids = MJBVHEmptyBox;
+    for (uint32_t i = begin; i < end; i++) {
+        MJBoundingBox box = tree->objectBounds[objects[i]];
+        GLKVector3 centroid = GLKVector3MultiplyScalar(GLKVector3Add(box.min, box.max), 0.5f);
+        centroids.min = GLKVector3Minimum(centroids.min, centroid);
+        centroids.max = GLKVector3Maximum(centroids.max, centroid);
+    }
+    
+    GLKVector3 extent = GLKVector3Subtract(centroids.max, centroids.min);
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    if (!(extent.v[axis] > 0.0f)) {
+        // All centroids coincide, so any split is as good as another.
+        return begin + (end - begin) / 2;
+    }
+    
+    MJBVHBin bins[kMJBVHBinCount];
+    for (int b = 0; b < kMJBVHBinCount; b++) {
+        bins[b].bounds = MJBVHEmptyBox;
+        bins[b].count = 0;
+    }
+    
+    float origin = centroids.min.v[axis];
+    float scale = kMJBVHBinCount / extent.v[axis];
+    for (uint32_t i = begin; i < end; i++) {
+        MJBoundingBox box = tree->objectBounds[objects[i]];
+        int b = MIN((int)((MJBVHCentroid(box, axis) - origin) * scale), kMJBVHBinCount - 1);
+        bins[b].bounds = MJBVHUnion(bins[b].bounds, box);
+        bins[b].count++;
+    }
+    
+    float rightCosts[kMJBVHBinCount];
+    MJBoundingBox right = MJBVHEmptyBox;
+    uint32_t rightCount = 0;
+    for (int b = kMJBVHBinCount - 1; b > 0; b--) {
+        right = MJBVHUnion(right, bins[b].bounds);
+        rightCount += bins[b].count;
+        rightCosts[b] = rightCount > 0 ? MJBVHArea(right) * rightCount : 0.0f;
+    }
+    
+    int bestSplit = 1;
+    float bestCost = INFINITY;
+    MJBoundingBox left = MJBVHEmptyBox;
+    uint32_t leftCount = 0;
+    for (int b = 1; b < kMJBVHBinCount; b++) {
+        left = MJBVHUnion(left, bins[b - 1].bounds);
+        leftCount += bins[b - 1].count;
+        float cost = (leftCount > 0 ? MJBVHArea(left) * leftCount : 0.0f) + rightCosts[b];
+        if (leftCount > 0 && leftCount < end - begin && cost < bestCost) {
+            bestCost = cost;
+            bestSplit = b;
+        }
+    }
+    
+    uint32_t i = begin;
+    uint32_t j = end;
+    while (i < j) {
+        int b = MIN((int)((MJBVHCentroid(tree->objectBounds[objects[i]], axis) - origin) * scale), kMJBVHBinCount - 1);
+        if (b < bestSplit) {
+            i++;
+        } else {
+            uint32_t object = objects[i];
+            objects[i] = objects[--j];
+            objects[j] = object;
+        }
+    }
+    return i;
+}
+
+static void MJBVHBuild(MJBVHTree *tree)
+{
+    tree->nodeCount = 0;
+    tree->freeNode = kMJBVHNull;
+    tree->root = kMJBVHNull;
+    
+    uint32_t count = tree->objectCount;
+    if (count == 0) {
+        return;
+    }
+    MJBVHReserveNodes(tree, (int32_t)(2 * count - 1));
+    
+    uint32_t *objects = malloc(count * sizeof(uint32_t));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < tree->objectHighWater; i++) {
+        if (tree->objectLeaves[i] != kMJBVHNull) {
+            objects[n++] = i;
+        }
+    }
+    
+    // Each task pops one range and pushes at most two, so the pending tasks
+    // never outnumber the objects.
+    MJBVHBuildTask *tasks = malloc(count * sizeof(MJBVHBuildTask));
+    uint32_t taskCount = 0;
+    tree->root = MJBVHAllocateNode(tree);
+    tasks[taskCount++] = (MJBVHBuildTask){tree->root, 0, count};
+    
+    while (taskCount > 0) {
+        MJBVHBuildTask task = tasks[--taskCount];
+        MJBVHNode *node = &tree->nodes[task.node];
+        
+        if (task.end - task.begin == 1) {
+            uint32_t object = objects[task.begin];
+            node->object = (int32_t)object;
+            node->bounds = MJBVHGrow(tree->objectBounds[object], tree->margin);
+            tree->objectLeaves[object] = task.node;
+            continue;
+        }
+        
+        uint32_t split = MJBVHSplit(tree, objects, task.begin, task.end);
+        int32_t left = MJBVHAllocateNode(tree);
+        int32_t right = MJBVHAllocateNode(tree);
+        node = &tree->nodes[task.node];
+        node->left = left;
+        node->right = right;
+        tree->nodes[left].parent = task.node;
+        tree->nodes[right].parent = task.node;
+        tasks[taskCount++] = (MJBVHBuildTask){left, task.begin, split};
+        tasks[taskCount++] = (MJBVHBuildTask){right, split, task.end};
+    }
+    
+    free(tasks);
+    free(objects);
+    
+    // The inner bounds are cheapest to fill in bottom up afterwards.
+    MJBVHRefit(tree);
+}
+
+#pragma mark - Queries
+
+static inline void MJBVHEmit(uint32_t *results, NSUInteger capacity, NSUInteger *count, int32_t object)
+{
+    if (*count < capacity) {
+        results[*count] = (uint32_t)object;
+    }
+    (*count)++;
+}
+
+/**
+ * Test a box against the planes of a frustum that are set in a mask, and
+ * clear the planes that the box is entirely inside.
+ *
+ * @return YES if the box is entirely outside one of the planes.
+ */
+static inline BOOL MJBVHOutsidePlanes(MJBoundingBox box, const MJFrustum *frustum, uint32_t *planes)
+{
+    GLKVector3 center = GLKVector3MultiplyScalar(GLKVector3Add(box.min, box.max), 0.5f);
+    GLKVector3 halfExtent = GLKVector3MultiplyScalar(GLKVector3Subtract(box.max, box.min), 0.5f);
+    for (int p = 0; p < MJFrustumPlaneCount; p++) {
+        if (!(*planes & (1 << p))) {
+            continue;
+        }
+        GLKVector4 plane = frustum->planes[p];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float extent = fabsf(plane.x) * halfExtent.x + fabsf(plane.y) * halfExtent.y + fabsf(plane.z) * halfExtent.z;
+        if (distance + extent < 0.0f) {
+            return YES;
+        }
+        if (distance - extent >= 0.0f) {
+            *planes &= ~(1 << p);
+        }
+    }
+    return NO;
+}
+
+/**
+ * Query a frustum. Each stack entry holds a node and, in its low bits, the
+ * planes the node still has to be tested against. Once a node is inside a
+ * plane so are its descendants, so the plane is dropped for the subtree.
+ * Leaves are grown by the margin, so the object itself is tested against
+ * the planes that are left.
+ */
+static NSUInteger MJBVHQueryFrustum(MJBVHTree *tree, const MJFrustum *frustum, uint32_t *results, NSUInteger capacity)
+{
+    NSUInteger count = 0;
+    if (tree->root == kMJBVHNull) {
+        return 0;
+    }
+    
+    const uint32_t allPlanes = (1 << MJFrustumPlaneCount) - 1;
+    uint32_t *stack = tree->stack;
+    uint32_t top = 0;
+    stack[top++] = ((uint32_t)tree->root << MJFrustumPlaneCount) | allPlanes;
+    
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        int32_t index = (int32_t)(entry >> MJFrustumPlaneCount);
+        uint32_t planes = entry & allPlanes;
+        const MJBVHNode *node = &tree->nodes[index];
+        
+        if (planes != 0 && MJBVHOutsidePlanes(node->bounds, frustum, &planes)) {
+            continue;
+        }
+        
+        if (node->left == kMJBVHNull) {
+            if (planes != 0 && MJBVHOutsidePlanes(tree->objectBounds[node->object], frustum, &planes)) {
+                continue;
+            }
+            MJBVHEmit(results, capacity, &count, node->object);
+        } else {
+            stack[top++] = ((uint32_t)node->right << MJFrustumPlaneCount) | planes;
+            stack[top++] = ((uint32_t)node->left << MJFrustumPlaneCount) | planes;
+        }
+    }
+    
+    return count;
+}
+
+/**
+ * Query a rectangle in the XY plane. The low bit of each stack entry is set
+ * when the node is known to be inside the rectangle.
+ */
+static inline BOOL MJBVHOverlapsRect(MJBoundingBox box, float minX, float minY, float maxX, float maxY)
+{
+    return !(box.max.x < minX || box.min.x > maxX || box.max.y < minY || box.min.y > maxY);
+}
+
+static NSUInteger MJBVHQueryRect(MJBVHTree *tree, CGRect rect, uint32_t *results, NSUInteger capacity)
+{
+    NSUInteger count = 0;
+    if (tree->root == kMJBVHNull) {
+        return 0;
+    }
+    
+    float minX = CGRectGetMinX(rect);
+    float minY = CGRectGetMinY(rect);
+    float maxX = CGRectGetMaxX(rect);
+    float maxY = CGRectGetMaxY(rect);
+    
+    uint32_t *stack = tree->stack;
+    uint32_t top = 0;
+    stack[top++] = (uint32_t)tree->root << 1;
+    
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        uint32_t inside = entry & 1;
+        const MJBVHNode *node = &tree->nodes[entry >> 1];
+        
+        if (!inside) {
+            MJBoundingBox box = node->bounds;
+            if (!MJBVHOverlapsRect(box, minX, minY, maxX, maxY)) {
+                continue;
+            }
+            inside = box.min.x >= minX && box.max.x <= maxX && box.min.y >= minY && box.max.y <= maxY;
+        }
+        
+        if (node->left == kMJBVHNull) {
+            if (!inside && !MJBVHOverlapsRect(tree->objectBounds[node->object], minX, minY, maxX, maxY)) {
+                continue;
+            }
+            MJBVHEmit(results, capacity, &count, node->object);
+        } else {
+            stack[top++] = ((uint32_t)node->right << 1) | inside;
+            stack[top++] = ((uint32_t)node->left << 1) | inside;
+        }
+    }
+    
+    return count;
+}
+
+/**
+ * Slab test, giving the distance along the ray to where it enters the box.
+ * A ray parallel to a slab never crosses its planes, so it hits the slab
+ * everywhere or nowhere depending on where the origin is. Testing that
+ * directly avoids 0 * infinity, which is NaN when the origin is exactly on
+ * one of the planes.
+ */
+static inline BOOL MJBVHRayHitsBox(MJBoundingBox box, GLKVector3 origin, GLKVector3 direction, GLKVector3 inverseDirection, float maxDistance, float *distance)
+{
+    float near = 0.0f;
+    float far = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction.v[axis] == 0.0f) {
+            if (origin.v[axis] < box.min.v[axis] || origin.v[axis] > box.max.v[axis]) {
+                return NO;
+            }
+            continue;
+        }
+        float t0 = (box.min.v[axis] - origin.v[axis]) * inverseDirection.v[axis];
+        float t1 = (box.max.v[axis] - origin.v[axis]) * inverseDirection.v[axis];
+        near = MAX(near, MIN(t0, t1));
+        far = MIN(far, MAX(t0, t1));
+    }
+    *distance = near;
+    return near <= far;
+}
+
+static NSUInteger MJBVHPick(MJBVHTree *tree, GLKVector3 origin, GLKVector3 direction, float maxDistance, float *hitDistance)
+{
+    if (tree->root == kMJBVHNull) {
+        return NSNotFound;
+    }
+    
+    GLKVector3 inverseDirection = GLKVector3Make(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    NSUInteger nearestObject = NSNotFound;
+    float nearestDistance = maxDistance;
+    
+    uint32_t *stack = tree->stack;
+    uint32_t top = 0;
+    stack[top++] = (uint32_t)tree->root;
+    
+    while (top > 0) {
+        const MJBVHNode *node = &tree->nodes[stack[--top]];
+        float distance;
+        if (!MJBVHRayHitsBox(node->bounds, origin, direction, inverseDirection, nearestDistance, &distance)) {
+            continue;
+        }
+        
+        if (node->left == kMJBVHNull) {
+            // The leaf is grown by the margin, so test the object itself.
+            if (!MJBVHRayHitsBox(tree->objectBounds[node->object], origin, direction, inverseDirection, nearestDistance, &distance)) {
+                continue;
+            }
+            nearestObject = (NSUInteger)node->object;
+            nearestDistance = distance;
+            continue;
+        }
+        
+        // Visit the nearer child first, so that it can shorten the ray
+        // before the other one is tested.
+        float leftDistance, rightDistance;
+        BOOL hitsLeft = MJBVHRayHitsBox(tree->nodes[node->left].bounds, origin, direction, inverseDirection, nearestDistance, &leftDistance);
+        BOOL hitsRight = MJBVHRayHitsBox(tree->nodes[node->right].bounds, origin, direction, inverseDirection, nearestDistance, &rightDistance);
+        if (hitsLeft && hitsRight) {
+            BOOL leftFirst = leftDistance <= rightDistance;
+            stack[top++] = (uint32_t)(leftFirst ? node->right : node->left);
+            stack[top++] = (uint32_t)(leftFirst ? node->left : node->right);
+        } else if (hitsLeft) {
+            stack[top++] = (uint32_t)node->left;
+        } else if (hitsRight) {
+            stack[top++] = (uint32_t)node->right;
+        }
+    }
+    
+    if (nearestObject != NSNotFound && hitDistance) {
+        *hitDistance = nearestDistance;
+    }
+    return nearestObject;
+}
+
+#pragma mark - Bounding volume hierarchy
+
+@implementation MJBoundingVolumeHierarchy {
+    MJBVHTree _tree;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        memset(&_tree, 0, sizeof(MJBVHTree));
+        _tree.root = kMJBVHNull;
+        _tree.freeNode = kMJBVHNull;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    MJBVHTreeFree(&_tree);
+}
+
+- (NSUInteger)objectCount
+{
+    return _tree.objectCount;
+}
+
+- (float)margin
+{
+    return _tree.margin;
+}
+
+- (void)setMargin:(float)margin
+{
+    _tree.margin = MAX(margin, 0.0f);
+}
+
+- (NSUInteger)addObjectWithBounds:(MJBoundingBox)bounds
+{
+    uint32_t object = MJBVHAllocateObject(&_tree);
+    int32_t leaf = MJBVHAllocateNode(&_tree);
+    _tree.nodes[leaf].object = (int32_t)object;
+    _tree.nodes[leaf].bounds = MJBVHGrow(bounds, _tree.margin);
+    _tree.objectBounds[object] = bounds;
+    _tree.objectLeaves[object] = leaf;
+    _tree.objectCount++;
+    
+    MJBVHInsertLeaf(&_tree, leaf);
+    return object;
+}
+
+- (void)setBounds:(MJBoundingBox)bounds forObject:(NSUInteger)object
+{
+    if (!MJBVHIsObject(&_tree, object)) {
+        NSLog(@"WARNING: No object %lu in the bounding volume hierarchy.", (unsigned long)object);
+        return;
+    }
+    _tree.objectBounds[object] = bounds;
+    
+    // Nothing above the leaf changes while the object stays inside it.
+    int32_t leaf = _tree.objectLeaves[object];
+    if (MJBVHContains(_tree.nodes[leaf].bounds, bounds)) {
+        return;
+    }
+    _tree.nodes[leaf].bounds = MJBVHGrow(bounds, _tree.margin);
+    MJBVHRefitAncestors(&_tree, _tree.nodes[leaf].parent);
+}
+
+- (MJBoundingBox)boundsForObject:(NSUInteger)object
+{
+    if (!MJBVHIsObject(&_tree, object)) {
+        return MJBVHEmptyBox;
+    }
+    return _tree.objectBounds[object];
+}
+
+- (void)removeObject:(NSUInteger)object
+{
+    if (!MJBVHIsObject(&_tree, object)) {
+        NSLog(@"WARNING: No object %lu in the bounding volume hierarchy.", (unsigned long)object);
+        return;
+    }
+    int32_t leaf = _tree.objectLeaves[object];
+    MJBVHRemoveLeaf(&_tree, leaf);
+    MJBVHFreeNode(&_tree, leaf);
+    
+    _tree.objectLeaves[object] = kMJBVHNull;
+    _tree.freeObjects[_tree.freeObjectCount++] = (uint32_t)object;
+    _tree.objectCount--;
+}
+
+- (void)removeAllObjects
+{
+    MJBVHTreeFree(&_tree);
+}
+
+- (void)rebuild
+{
+    MJBVHBuild(&_tree);
+}
+
+- (void)refit
+{
+    MJBVHRefit(&_tree);
+}
+
+- (NSUInteger)queryFrustum:(const MJFrustum *)frustum
+                   results:(uint32_t *)results
+                  capacity:(NSUInteger)capacity
+{
+    return MJBVHQueryFrustum(&_tree, frustum, results, capacity);
+}
+
+- (NSUInteger)queryCamera:(MJAbstract3DCamera *)camera
+                  results:(uint32_t *)results
+                 capacity:(NSUInteger)capacity
+{
+    MJFrustum frustum = camera.frustum;
+    return [self queryFrustum:&frustum results:results capacity:capacity];
+}
+
+- (NSUInteger)queryRect:(CGRect)rect
+                results:(uint32_t *)results
+               capacity:(NSUInteger)capacity
+{
+    return MJBVHQueryRect(&_tree, rect, results, capacity);
+}
+
+- (NSUInteger)pickWithRayOrigin:(GLKVector3)origin
+                      direction:(GLKVector3)direction
+                    maxDistance:(float)maxDistance
+                       distance:(float *)distance
+{
+    return MJBVHPick(&_tree, origin, direction, maxDistance, distance);
+}
+
+@end